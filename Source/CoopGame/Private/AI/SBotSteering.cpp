@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/SBotSteering.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// Define BOTSTEERING_SSE2 as 0 to build the scalar fallback on an SSE2 target
+#ifndef BOTSTEERING_SSE2
+	#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define BOTSTEERING_SSE2 1
+	#else
+		#define BOTSTEERING_SSE2 0
+	#endif
+#endif
+
+#if BOTSTEERING_SSE2
+	#include <emmintrin.h>
+#endif
+
+// Below this squared distance the direction is undefined and the bot isn't pushed
+static const float MinDirectionSq = 1.e-8f;
+
+void FBotSteeringBatch::Reset(int32_t InNumBots)
+{
+	NumBots = InNumBots > 0 ? InNumBots : 0;
+
+	// Padding bots sit on their target with no force
+	size_t Padded = (size_t)((NumBots + 3) & ~3);
+	for (std::vector<float>* Array : { &PositionX, &PositionY, &PositionZ, &TargetX, &TargetY, &TargetZ, &MovementForce, &ArriveDistanceSq, &ForceX, &ForceY, &ForceZ })
+	{
+		Array->assign(Padded, 0.0f);
+	}
+	Flags.assign(Padded, 0);
+}
+
+void FBotSteeringBatch::SetBot(int32_t Index, const float Position[3], const float Target[3], float InMovementForce, float ArriveDistance)
+{
+	PositionX[Index] = Position[0];
+	PositionY[Index] = Position[1];
+	PositionZ[Index] = Position[2];
+	TargetX[Index] = Target[0];
+	TargetY[Index] = Target[1];
+	TargetZ[Index] = Target[2];
+	MovementForce[Index] = InMovementForce;
+	ArriveDistanceSq[Index] = ArriveDistance * ArriveDistance;
+}
+
+// Shared by the single bot and scalar batch path
+static uint8_t ComputeBot(const float Position[3], const float Target[3], float InMovementForce, float ArriveDistanceSq, float OutForce[3])
+{
+	float DX = Target[0] - Position[0];
+	float DY = Target[1] - Position[1];
+	float DZ = Target[2] - Position[2];
+	float DistSq = DX * DX + DY * DY + DZ * DZ;
+
+	OutForce[0] = OutForce[1] = OutForce[2] = 0.0f;
+
+	if (DistSq <= ArriveDistanceSq)
+		return BOTSTEERING_Arrived;
+
+	if (DistSq > MinDirectionSq)
+	{
+		float Scale = InMovementForce / std::sqrt(DistSq);
+		OutForce[0] = DX * Scale;
+		OutForce[1] = DY * Scale;
+		OutForce[2] = DZ * Scale;
+	}
+
+	return DZ > 0.0f ? BOTSTEERING_WantsToJump : 0;
+}
+
+uint8_t FBotSteeringBatch::ComputeSingle(const float Position[3], const float Target[3], float InMovementForce, float ArriveDistance, float OutForce[3])
+{
+	return ComputeBot(Position, Target, InMovementForce, ArriveDistance * ArriveDistance, OutForce);
+}
+
+void FBotSteeringBatch::ComputeScalar()
+{
+	for (int32_t i = 0; i < NumBots; ++i)
+	{
+		float Position[3] = { PositionX[i], PositionY[i], PositionZ[i] };
+		float Target[3] = { TargetX[i], TargetY[i], TargetZ[i] };
+		float Force[3];
+
+		Flags[i] = ComputeBot(Position, Target, MovementForce[i], ArriveDistanceSq[i], Force);
+		ForceX[i] = Force[0];
+		ForceY[i] = Force[1];
+		ForceZ[i] = Force[2];
+	}
+}
+
+bool FBotSteeringBatch::IsVectorized()
+{
+	return BOTSTEERING_SSE2 != 0;
+}
+
+void FBotSteeringBatch::Compute()
+{
+#if BOTSTEERING_SSE2
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 MinDirection = _mm_set1_ps(MinDirectionSq);
+	const __m128i ArrivedBit = _mm_set1_epi32(BOTSTEERING_Arrived);
+	const __m128i JumpBit = _mm_set1_epi32(BOTSTEERING_WantsToJump);
+
+	int32_t Padded = (NumBots + 3) & ~3;
+	for (int32_t i = 0; i < Padded; i += 4)
+	{
+		__m128 DX = _mm_sub_ps(_mm_loadu_ps(&TargetX[i]), _mm_loadu_ps(&PositionX[i]));
+		__m128 DY = _mm_sub_ps(_mm_loadu_ps(&TargetY[i]), _mm_loadu_ps(&PositionY[i]));
+		__m128 DZ = _mm_sub_ps(_mm_loadu_ps(&TargetZ[i]), _mm_loadu_ps(&PositionZ[i]));
+		__m128 DistSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)), _mm_mul_ps(DZ, DZ));
+
+		__m128 Arrived = _mm_cmple_ps(DistSq, _mm_loadu_ps(&ArriveDistanceSq[i]));
+		__m128 Moving = _mm_andnot_ps(Arrived, _mm_cmpgt_ps(DistSq, MinDirection));
+		__m128 Jump = _mm_andnot_ps(Arrived, _mm_cmpgt_ps(DZ, Zero));
+
+		// Full precision sqrt and divide so the results match the scalar path
+		__m128 Length = _mm_sqrt_ps(_mm_max_ps(DistSq, MinDirection));
+		__m128 Scale = _mm_and_ps(Moving, _mm_div_ps(_mm_loadu_ps(&MovementForce[i]), Length));
+
+		_mm_storeu_ps(&ForceX[i], _mm_mul_ps(DX, Scale));
+		_mm_storeu_ps(&ForceY[i], _mm_mul_ps(DY, Scale));
+		_mm_storeu_ps(&ForceZ[i], _mm_mul_ps(DZ, Scale));
+
+		__m128i BotFlags = _mm_or_si128(_mm_and_si128(_mm_castps_si128(Arrived), ArrivedBit), _mm_and_si128(_mm_castps_si128(Jump), JumpBit));
+		alignas(16) int32_t FlagLanes[4];
+		_mm_store_si128((__m128i*)FlagLanes, BotFlags);
+		Flags[i] = (uint8_t)FlagLanes[0];
+		Flags[i + 1] = (uint8_t)FlagLanes[1];
+		Flags[i + 2] = (uint8_t)FlagLanes[2];
+		Flags[i + 3] = (uint8_t)FlagLanes[3];
+	}
+#else
+	ComputeScalar();
+
+	// Same padding lanes as the vectorized path
+	for (size_t i = (size_t)NumBots; i < Flags.size(); ++i)
+	{
+		ForceX[i] = ForceY[i] = ForceZ[i] = 0.0f;
+		Flags[i] = BOTSTEERING_Arrived;
+	}
+#endif
+}
+
+void FBotSteeringBatch::RunBenchmark(int32_t InNumBots, int32_t Iterations, double& OutScalarBotsPerUs, double& OutVectorBotsPerUs)
+{
+	int32_t NumBenchmarkBots = InNumBots > 0 ? InNumBots : 1;
+	Iterations = Iterations > 0 ? Iterations : 1;
+
+	std::mt19937 Random(1234);
+	std::uniform_real_distribution<float> Coordinate(-5000.0f, 5000.0f);
+
+	FBotSteeringBatch Batch;
+	Batch.Reset(NumBenchmarkBots);
+	for (int32_t i = 0; i < NumBenchmarkBots; ++i)
+	{
+		float Position[3] = { Coordinate(Random), Coordinate(Random), Coordinate(Random) * 0.05f };
+		float Target[3] = { Position[0] + Coordinate(Random) * 0.1f, Position[1] + Coordinate(Random) * 0.1f, Position[2] + Coordinate(Random) * 0.01f };
+		Batch.SetBot(i, Position, Target, 1000.0f, 100.0f);
+	}
+
+	using FClock = std::chrono::steady_clock;
+
+	FClock::time_point Start = FClock::now();
+	for (int32_t Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		Batch.ComputeScalar();
+	}
+	double ScalarUs = std::chrono::duration<double, std::micro>(FClock::now() - Start).count();
+
+	Start = FClock::now();
+	for (int32_t Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		Batch.Compute();
+	}
+	double VectorUs = std::chrono::duration<double, std::micro>(FClock::now() - Start).count();
+
+	double TotalBots = (double)NumBenchmarkBots * Iterations;
+	OutScalarBotsPerUs = ScalarUs > 0.0 ? TotalBots / ScalarUs : 0.0;
+	OutVectorBotsPerUs = VectorUs > 0.0 ? TotalBots / VectorUs : 0.0;
+}
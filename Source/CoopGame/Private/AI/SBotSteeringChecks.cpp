@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SBotSteeringChecks.h"
+#include "AI/SBotSteering.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Forces of the two paths may differ by rounding, flags never
+static const float ForceTolerance = 0.01f;
+
+namespace
+{
+	struct FCheckContext
+	{
+		std::vector<std::string>& Failures;
+
+		void Check(bool bPassed, const std::string& What)
+		{
+			if (!bPassed)
+				Failures.push_back(What);
+		}
+
+		void CheckForce(float Actual, float Expected, const std::string& What)
+		{
+			Check(std::fabs(Actual - Expected) <= ForceTolerance, What + ": " + std::to_string(Actual) + " != " + std::to_string(Expected));
+		}
+	};
+}
+
+// First five bots are hand placed, the rest random
+static void FillBatch(FBotSteeringBatch& Batch, int32_t NumBots, uint32_t Seed)
+{
+	Batch.Reset(NumBots);
+
+	std::mt19937 Random(Seed);
+	std::uniform_real_distribution<float> Coordinate(-5000.0f, 5000.0f);
+	std::uniform_real_distribution<float> Offset(-500.0f, 500.0f);
+	for (int32_t i = 0; i < NumBots; ++i)
+	{
+		float Position[3] = { Coordinate(Random), Coordinate(Random), Coordinate(Random) * 0.04f };
+		float Target[3] = { Position[0] + Offset(Random), Position[1] + Offset(Random), Position[2] + Offset(Random) * 0.1f };
+		Batch.SetBot(i, Position, Target, 1000.0f, 100.0f);
+	}
+
+	const float Origin[3] = { 0.0f, 0.0f, 0.0f };
+	const float Close[3] = { 50.0f, 0.0f, 20.0f };
+	const float Above[3] = { 1000.0f, 0.0f, 300.0f };
+	const float Below[3] = { 0.0f, 1000.0f, -300.0f };
+	const float Tiny[3] = { 0.0f, 0.0f, 1.e-5f };
+
+	// Within the arrive distance, target above
+	if (NumBots > 0)
+		Batch.SetBot(0, Origin, Close, 1000.0f, 100.0f);
+
+	// Far away and above
+	if (NumBots > 1)
+		Batch.SetBot(1, Origin, Above, 1000.0f, 100.0f);
+
+	// Far away and below
+	if (NumBots > 2)
+		Batch.SetBot(2, Origin, Below, 1000.0f, 100.0f);
+
+	// On the target without an arrive distance
+	if (NumBots > 3)
+		Batch.SetBot(3, Origin, Origin, 1000.0f, 0.0f);
+
+	// Too close for a direction, not arrived, slightly above
+	if (NumBots > 4)
+		Batch.SetBot(4, Origin, Tiny, 1000.0f, 0.0f);
+}
+
+static void CheckFlags(FCheckContext& Context)
+{
+	FBotSteeringBatch Batch;
+	FillBatch(Batch, 5, 1234);
+	Batch.ComputeScalar();
+
+	Context.Check(Batch.Flags[0] == BOTSTEERING_Arrived, "Within the arrive distance only arrives");
+	Context.Check(Batch.ForceX[0] == 0.0f && Batch.ForceY[0] == 0.0f && Batch.ForceZ[0] == 0.0f, "Arrived bots get no force");
+
+	Context.Check(Batch.Flags[1] == BOTSTEERING_WantsToJump, "Target above wants to jump");
+	float Length = std::sqrt(Batch.ForceX[1] * Batch.ForceX[1] + Batch.ForceY[1] * Batch.ForceY[1] + Batch.ForceZ[1] * Batch.ForceZ[1]);
+	Context.CheckForce(Length, 1000.0f, "Force length is the movement force");
+
+	Context.Check(Batch.Flags[2] == 0, "Target below doesn't jump");
+	Context.Check(Batch.ForceY[2] > 0.0f && Batch.ForceZ[2] < 0.0f, "Force points at the target");
+
+	Context.Check(Batch.Flags[3] == BOTSTEERING_Arrived, "On the target arrives");
+
+	Context.Check(Batch.ForceX[4] == 0.0f && Batch.ForceY[4] == 0.0f && Batch.ForceZ[4] == 0.0f, "No direction, no force");
+	Context.Check(Batch.Flags[4] == BOTSTEERING_WantsToJump, "No direction still jumps");
+}
+
+static void CheckPathsAgree(FCheckContext& Context, int32_t NumBots)
+{
+	std::string Prefix = std::to_string(NumBots) + " bots, bot ";
+
+	FBotSteeringBatch Scalar;
+	FillBatch(Scalar, NumBots, 1000 + NumBots);
+	Scalar.ComputeScalar();
+
+	// Garbage in the outputs must be overwritten, padding lanes included
+	FBotSteeringBatch Vector;
+	FillBatch(Vector, NumBots, 1000 + NumBots);
+	std::fill(Vector.ForceX.begin(), Vector.ForceX.end(), 12345.0f);
+	std::fill(Vector.ForceY.begin(), Vector.ForceY.end(), 12345.0f);
+	std::fill(Vector.ForceZ.begin(), Vector.ForceZ.end(), 12345.0f);
+	std::fill(Vector.Flags.begin(), Vector.Flags.end(), (uint8_t)0xFF);
+	Vector.Compute();
+
+	int32_t Padded = (NumBots + 3) & ~3;
+	Context.Check((int32_t)Vector.ForceX.size() == Padded && (int32_t)Vector.Flags.size() == Padded, std::to_string(NumBots) + " bots padded to a multiple of four");
+
+	for (int32_t i = 0; i < NumBots; ++i)
+	{
+		std::string Bot = Prefix + std::to_string(i);
+		Context.Check(Vector.Flags[i] == Scalar.Flags[i], Bot + " Compute flags match ComputeScalar");
+		Context.CheckForce(Vector.ForceX[i], Scalar.ForceX[i], Bot + " Compute force X");
+		Context.CheckForce(Vector.ForceY[i], Scalar.ForceY[i], Bot + " Compute force Y");
+		Context.CheckForce(Vector.ForceZ[i], Scalar.ForceZ[i], Bot + " Compute force Z");
+
+		// Bots outside a batch take the same path
+		const float Position[3] = { Scalar.PositionX[i], Scalar.PositionY[i], Scalar.PositionZ[i] };
+		const float Target[3] = { Scalar.TargetX[i], Scalar.TargetY[i], Scalar.TargetZ[i] };
+		float Force[3];
+		uint8_t Flags = FBotSteeringBatch::ComputeSingle(Position, Target, Scalar.MovementForce[i], std::sqrt(Scalar.ArriveDistanceSq[i]), Force);
+		Context.Check(Flags == Scalar.Flags[i], Bot + " ComputeSingle flags match ComputeScalar");
+		Context.CheckForce(Force[0], Scalar.ForceX[i], Bot + " ComputeSingle force X");
+		Context.CheckForce(Force[1], Scalar.ForceY[i], Bot + " ComputeSingle force Y");
+		Context.CheckForce(Force[2], Scalar.ForceZ[i], Bot + " ComputeSingle force Z");
+	}
+
+	// Padding bots sit on their target
+	for (int32_t i = NumBots; i < Padded; ++i)
+	{
+		std::string Lane = std::to_string(NumBots) + " bots, padding lane " + std::to_string(i);
+		Context.Check(Vector.ForceX[i] == 0.0f && Vector.ForceY[i] == 0.0f && Vector.ForceZ[i] == 0.0f, Lane + " has no force");
+		Context.Check(Vector.Flags[i] == BOTSTEERING_Arrived, Lane + " is arrived and doesn't jump");
+	}
+}
+
+bool FBotSteeringChecks::Run(std::vector<std::string>& OutFailures)
+{
+	OutFailures.clear();
+	FCheckContext Context{ OutFailures };
+
+	CheckFlags(Context);
+
+	// Every remainder of four, then a large batch
+	for (int32_t NumBots : { 0, 1, 2, 3, 4, 5, 6, 7, 8, 13, 1001 })
+	{
+		CheckPathsAgree(Context, NumBots);
+	}
+
+	return OutFailures.empty();
+}
@@ -0,0 +1,15 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// Plain C++ like SBotSteering.h, shared by the CoopGame.BotSteering automation tests and Tools/BotSteering
+#include <string>
+#include <vector>
+
+struct FBotSteeringChecks
+{
+	// Checks the arrive and jump flags on hand placed bots and that Compute, ComputeScalar and ComputeSingle
+	// agree on batches of every padding remainder, padding lanes included. Returns false and fills OutFailures
+	// with one line per failed check
+	static bool Run(std::vector<std::string>& OutFailures);
+};
@@ -6,15 +6,24 @@
 #include "Kismet\GameplayStatics.h"
 #include "GameFramework\Character.h"
 #include "NavigationSystem.h"
-#include "NavigationPath.h"
 #include "DrawDebugHelpers.h"
 #include "Components\SHealthComponent.h"
+#include "Components/SReplicationPolicyComponent.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "Components\SphereComponent.h"
 #include "PhysicsEngine/RadialForceComponent.h"
 #include "SCharacter.h"
 #include "Sound\SoundCue.h"
 #include "Net\UnrealNetwork.h"
+#include "Subsystems/SLagCompensationSubsystem.h"
+#include "Subsystems/SPathQuerySubsystem.h"
+#include "Subsystems/SFlowFieldSubsystem.h"
+#include "Subsystems/SExplosionSubsystem.h"
+#include "Subsystems/STrackerBotSubsystem.h"
+#include "Subsystems/SHealthRegistrySubsystem.h"
+#include "Subsystems/STrackerBotPoolSubsystem.h"
+#include "AI/SBotSteering.h"
+#include "SCosmetics.h"
 
 static int32 DebugTrackerBotDrawing = 0;
 FAutoConsoleVariableRef CVARDebugTrackerBotDrawing(
@@ -23,6 +32,13 @@ FAutoConsoleVariableRef CVARDebugTrackerBotDrawing(
 	TEXT("Draw Debug Lines for TrackerBot"),
 	ECVF_Cheat);
 
+static int32 TrackerBotNavMode = 0;
+FAutoConsoleVariableRef CVARTrackerBotNavMode(
+	TEXT("COOP.TrackerBotNavMode"),
+	TrackerBotNavMode,
+	TEXT("TrackerBot navigation: 0 = path per bot, 1 = shared flow field per target (falls back to paths where the field can't help)"),
+	ECVF_Default);
+
 // Sets default values
 ASTrackerBot::ASTrackerBot()
 {
@@ -54,12 +70,26 @@ ASTrackerBot::ASTrackerBot()
 	RadialForceComp->bAutoActivate = false;
 	RadialForceComp->bIgnoreOwningActor = true;
 
+	// Bots close to players get updated first, parked bots go dormant
+	ReplicationPolicyComp = CreateDefaultSubobject<USReplicationPolicyComponent>(TEXT("ReplicationPolicyComp"));
+	ReplicationPolicyComp->NearNetUpdateFrequency = 30.0f;
+	ReplicationPolicyComp->FarNetUpdateFrequency = 5.0f;
+	ReplicationPolicyComp->NearPriorityScale = 3.0f;
+	ReplicationPolicyComp->bDormantWhenIdle = true;
+	ReplicationPolicyComp->SetIdle(false);
+
 	bUseVelocityChange = false;
 	MovementForce = 1000.0f;
 	JumpForce = 10.0f;
 
 	RequiredDistanceToTarget = 100;
 
+	PathPointIndex = 0;
+	bPathRequestPending = false;
+	NextPathRetryTime = 0.0f;
+	RepathDistance = 300.0f;
+	RefreshPathInterval = 1.0f;
+
 	bStartedSelfDestruction = false;
 	bExploded = false;
 
@@ -69,6 +99,7 @@ ASTrackerBot::ASTrackerBot()
 	MaxPowerLevel = 5;
 	PowerLevel = 0;
 
+	BotSubsystemIndex = INDEX_NONE;
 	SetReplicates(true);
 }
 
@@ -77,36 +108,170 @@ void ASTrackerBot::BeginPlay()
 {
 	Super::BeginPlay();
 
-	if (MatInst == nullptr)
+	// Material pulses are cosmetic only
+	if (MatInst == nullptr && FSCosmetics::ShouldPlay(this))
 	{
 		MatInst = MeshComp->CreateAndSetMaterialInstanceDynamicFromMaterial(0, MeshComp->GetMaterial(0));
 	}
 
+	// Prewarmed bots wait in the pool until they are spawned
+	if (PoolState.bInPool)
+	{
+		ApplyPoolState();
+		return;
+	}
+
+	StartTracking();
+}
+
+void ASTrackerBot::StartTracking()
+{
 	if (GetLocalRole() == ROLE_Authority)
 	{
-		// Find initial point to move-to
-		NextPathPoint = GetNextPathPoint();
+		// Track hitbox for lag compensated shots
+		USLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USLagCompensationSubsystem>();
+		if (LagCompensation != nullptr)
+			LagCompensation->RegisterActor(this);
+
+		// Stand still until the first path arrives
+		NextPathPoint = GetActorLocation();
+		if (TrackerBotNavMode > 0)
+			PathTarget = FindBestTarget();
+		else
+			RequestPath();
+
+		// Steering, path refreshes and power level are updated with all other bots by the subsystem
+		USTrackerBotSubsystem* TrackerBots = GetWorld()->GetSubsystem<USTrackerBotSubsystem>();
+		if (TrackerBots != nullptr)
+			TrackerBots->RegisterBot(this);
 
-		// Check nearby TrackerBots every second
-		FTimerHandle TimerHandle_CheckPowerLevel;
-		GetWorldTimerManager().SetTimer(TimerHandle_CheckPowerLevel, this, &ASTrackerBot::OnCheckNearbyBots, 1.0f, true);
+		if (BotSubsystemIndex == INDEX_NONE)
+			GetWorldTimerManager().SetTimer(TimerHandle_RefreshPath, this, &ASTrackerBot::RefreshPath, RefreshPathInterval, true, FMath::FRandRange(0.0f, RefreshPathInterval));
 	}
+
+	// Clients only move replicated physics, the server ticks bots through the subsystem
+	SetActorTickEnabled(GetLocalRole() == ROLE_Authority && BotSubsystemIndex == INDEX_NONE);
+}
+
+void ASTrackerBot::StopTracking()
+{
+	USLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USLagCompensationSubsystem>();
+	if (LagCompensation != nullptr)
+		LagCompensation->UnregisterActor(this);
+
+	USTrackerBotSubsystem* TrackerBots = GetWorld()->GetSubsystem<USTrackerBotSubsystem>();
+	if (TrackerBots != nullptr)
+		TrackerBots->UnregisterBot(this);
+
+	GetWorldTimerManager().ClearAllTimersForObject(this);
+
+	SetActorTickEnabled(false);
+}
+
+void ASTrackerBot::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopTracking();
+
+	Super::EndPlay(EndPlayReason);
 }
 
-FVector ASTrackerBot::GetNextPathPoint()
+void ASTrackerBot::ActivateFromPool(const FTransform& Transform)
 {
+	SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+
+	PoolState.bInPool = false;
+	++PoolState.Activations;
+	PowerLevel = 0;
+	PathPoints.Reset();
+	PathPointIndex = 0;
+	PathTarget = nullptr;
+	bPathRequestPending = false;
+	NextPathRetryTime = 0.0f;
+
+	// Health first so the bot registers alive
+	HealthComp->ResetHealth();
+	ApplyPoolState();
+
+	StartTracking();
+}
+
+void ASTrackerBot::DeactivateToPool()
+{
+	StopTracking();
+
+	PoolState.bInPool = true;
+	ApplyPoolState();
+}
+
+void ASTrackerBot::ApplyPoolState()
+{
+	SetActorHiddenInGame(PoolState.bInPool);
+	SetActorEnableCollision(!PoolState.bInPool);
+
+	// Parked bots don't count as alive or as targets
+	HealthComp->SetRegistered(!PoolState.bInPool);
+
+	ReplicationPolicyComp->SetIdle(PoolState.bInPool);
+
+	if (PoolState.bInPool)
+	{
+		MeshComp->SetSimulatePhysics(false);
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	bExploded = false;
+	bStartedSelfDestruction = false;
+
+	// Undo SelfDestruct
+	const ASTrackerBot* DefaultBot = GetClass()->GetDefaultObject<ASTrackerBot>();
+	MeshComp->SetVisibility(true, true);
+	MeshComp->SetCollisionEnabled(DefaultBot->MeshComp->GetCollisionEnabled());
+	MeshComp->SetSimulatePhysics(true);
+	MeshComp->SetPhysicsLinearVelocity(FVector::ZeroVector);
+	MeshComp->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+
+	// Back to the material defaults, no damage pulse and no power level
+	if (MatInst != nullptr)
+		MatInst->ClearParameterValues();
+}
+
+void ASTrackerBot::ReturnToPool()
+{
+	USTrackerBotPoolSubsystem* BotPool = GetWorld()->GetSubsystem<USTrackerBotPoolSubsystem>();
+	if (BotPool != nullptr)
+		BotPool->ReleaseBot(this);
+	else
+		Destroy();
+}
+
+void ASTrackerBot::OnRep_PoolState()
+{
+	ApplyPoolState();
+}
+
+AActor* ASTrackerBot::FindBestTarget()
+{
+	// Picked on the worker threads with all other bots this frame
+	USTrackerBotSubsystem* TrackerBots = GetWorld()->GetSubsystem<USTrackerBotSubsystem>();
+	AActor* SelectedTarget = nullptr;
+	if (TrackerBots != nullptr && TrackerBots->GetBestTarget(this, SelectedTarget))
+		return SelectedTarget;
+
 	// Get nearest player location
 	AActor* BestTarget = nullptr;
 	float NearestTargetDistance = FLT_MAX;
 
-	for (FConstPawnIterator It = GetWorld()->GetPawnIterator(); It; ++It)
+	USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+	int32 MyHandle = HealthComp->GetRegistryHandle();
+
+	for (int32 Handle = 0; Handle < Registry->GetNum(); ++Handle)
 	{
-		APawn* TestPawn = It->Get();
-		if (TestPawn == nullptr || USHealthComponent::IsFriendly(TestPawn, this))
+		if (MyHandle == INDEX_NONE || !Registry->IsAlive(Handle) || Registry->IsFriendly(Handle, MyHandle))
 			continue;
 
-		USHealthComponent* TestPawnHealthComp = Cast<USHealthComponent>(TestPawn->GetComponentByClass(USHealthComponent::StaticClass()));
-		if (TestPawnHealthComp != nullptr && TestPawnHealthComp->GetHealth() > 0.0f)
+		APawn* TestPawn = Cast<APawn>(Registry->GetOwner(Handle));
+		if (TestPawn != nullptr)
 		{
 			float Distance = (TestPawn->GetActorLocation() - GetActorLocation()).Size();
 			if (Distance < NearestTargetDistance)
@@ -117,28 +282,101 @@ FVector ASTrackerBot::GetNextPathPoint()
 		}
 	}
 
-	// Get path to target
-	if (BestTarget != nullptr)
+	return BestTarget;
+}
+
+void ASTrackerBot::RequestPath()
+{
+	if (bPathRequestPending || GetWorld()->TimeSeconds < NextPathRetryTime)
+		return;
+
+	AActor* BestTarget = FindBestTarget();
+	USPathQuerySubsystem* PathQueries = GetWorld()->GetSubsystem<USPathQuerySubsystem>();
+	if (BestTarget == nullptr || PathQueries == nullptr)
 	{
-		UNavigationPath* NavPath = UNavigationSystemV1::FindPathToActorSynchronously(this, GetActorLocation(), BestTarget);
+		PathTarget = nullptr;
+		return;
+	}
 
-		GetWorldTimerManager().ClearTimer(TimerHandle_RefreshPath);
-		GetWorldTimerManager().SetTimer(TimerHandle_RefreshPath, this, &ASTrackerBot::RefreshPath, 5.0f, false);
+	PathTarget = BestTarget;
+	PathTargetLocation = BestTarget->GetActorLocation();
+	bPathRequestPending = true;
 
-		if (NavPath != nullptr && NavPath->PathPoints.Num() > 1)
-		{
-			// Return next point in the path
-			return NavPath->PathPoints[1];
-		}
+	PathQueries->RequestPath(GetActorLocation(), BestTarget, FSPathQueryDelegate::CreateUObject(this, &ASTrackerBot::OnPathFound, PoolState.Activations));
+}
+
+void ASTrackerBot::OnPathFound(bool bSuccess, const TArray<FVector>& NewPathPoints, uint8 RequestActivations)
+{
+	// Requested before the bot went back to the pool, its current request is still pending
+	if (RequestActivations != PoolState.Activations || PoolState.bInPool)
+		return;
+
+	bPathRequestPending = false;
+
+	if (!bSuccess)
+	{
+		// Failed to find path, try again later
+		NextPathRetryTime = GetWorld()->TimeSeconds + RefreshPathInterval;
+		PathPoints.Reset();
+		NextPathPoint = GetActorLocation();
+		return;
 	}
 
-	// Failed to find path
-	return GetActorLocation();
+	PathPoints = NewPathPoints;
+
+	// First point is where the query started
+	PathPointIndex = 1;
+	NextPathPoint = PathPoints[PathPointIndex];
 }
 
 void ASTrackerBot::RefreshPath()
 {
-	NextPathPoint = GetNextPathPoint();
+	if (bExploded)
+		return;
+
+	AActor* BestTarget = FindBestTarget();
+
+	// Flow fields only need to know who to chase
+	if (TrackerBotNavMode > 0 && !bPathRequestPending)
+	{
+		PathTarget = BestTarget;
+		return;
+	}
+
+	if (BestTarget != PathTarget.Get() || PathPoints.Num() == 0
+		|| (BestTarget != nullptr && FVector::DistSquared(BestTarget->GetActorLocation(), PathTargetLocation) > FMath::Square(RepathDistance)))
+	{
+		RequestPath();
+	}
+}
+
+void ASTrackerBot::AdvancePath()
+{
+	if (PathPointIndex + 1 < PathPoints.Num())
+	{
+		++PathPointIndex;
+		NextPathPoint = PathPoints[PathPointIndex];
+	}
+	else
+	{
+		RequestPath();
+	}
+}
+
+bool ASTrackerBot::FollowFlowField()
+{
+	USFlowFieldSubsystem* FlowField = GetWorld()->GetSubsystem<USFlowFieldSubsystem>();
+	if (FlowField == nullptr || !PathTarget.IsValid())
+		return false;
+
+	FVector FlowPoint;
+	if (!FlowField->SampleNextPoint(PathTarget.Get(), GetActorLocation(), FlowPoint))
+		return false;
+
+	// Drop the fallback path, it is stale by the time the field stops working
+	PathPoints.Reset();
+	NextPathPoint = FlowPoint;
+	return true;
 }
 
 void ASTrackerBot::SelfDestruct()
@@ -147,31 +385,51 @@ void ASTrackerBot::SelfDestruct()
 
 	bExploded = true;
 
-	UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, GetActorLocation());
-
-	UGameplayStatics::PlaySoundAtLocation(this, ExplodeSound, GetActorLocation());
+	if (FSCosmetics::ShouldPlay(this))
+	{
+		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, GetActorLocation());
 
-	// Add radial force
-	RadialForceComp->FireImpulse();
+		UGameplayStatics::PlaySoundAtLocation(this, ExplodeSound, GetActorLocation());
+	}
 
 	MeshComp->SetVisibility(false, true);
 	MeshComp->SetSimulatePhysics(false);
 	MeshComp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 
-	if (GetLocalRole() == ROLE_Authority)
+	// Add radial force and damage near actors, damage only with authority
+	float ActualDamage = ExplosionDamage + ExplosionDamage * PowerLevel;
+	USExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<USExplosionSubsystem>();
+	if (Explosions != nullptr)
+	{
+		Explosions->Detonate(this, ActualDamage, ExplosionRadius, RadialForceComp);
+	}
+	else
 	{
-		TArray<AActor*> IgnoredActors;
-		IgnoredActors.Add(this);
+		RadialForceComp->FireImpulse();
 
-		// Damage near actors
-		float ActualDamage = ExplosionDamage + ExplosionDamage * PowerLevel;
-		UGameplayStatics::ApplyRadialDamage(this, ActualDamage, GetActorLocation(), ExplosionRadius, nullptr, IgnoredActors, this, GetInstigatorController(), true);
+		if (GetLocalRole() == ROLE_Authority)
+		{
+			TArray<AActor*> IgnoredActors;
+			IgnoredActors.Add(this);
+			UGameplayStatics::ApplyRadialDamage(this, ActualDamage, GetActorLocation(), ExplosionRadius, nullptr, IgnoredActors, this, GetInstigatorController(), true);
+		}
+	}
+
+	if (GetLocalRole() == ROLE_Authority)
+	{
+		// Exploded bots don't power up their neighbours
+		USTrackerBotSubsystem* TrackerBots = GetWorld()->GetSubsystem<USTrackerBotSubsystem>();
+		if (TrackerBots != nullptr)
+			TrackerBots->UnregisterBot(this);
 
 		if(DebugTrackerBotDrawing)
 			DrawDebugSphere(GetWorld(), GetActorLocation(), ExplosionRadius, 12, FColor::Red, false, 2.0f, 0, 1.0f);
 
-		// Destroy Actor Immediately
-		SetLifeSpan(2.0f);
+		// Give the explosion time to replicate, then park the bot or destroy it
+		if (USTrackerBotPoolSubsystem::IsPoolingEnabled())
+			GetWorldTimerManager().SetTimer(TimerHandle_ReturnToPool, this, &ASTrackerBot::ReturnToPool, 2.0f);
+		else
+			SetLifeSpan(2.0f);
 	}
 }
 
@@ -180,35 +438,16 @@ void ASTrackerBot::DamageSelf()
 	UGameplayStatics::ApplyDamage(this, 20, GetInstigatorController(), this, nullptr);
 }
 
-void ASTrackerBot::OnCheckNearbyBots()
+void ASTrackerBot::SetNearbyBots(int32 NumOfBots)
 {
-	// Create collider
-	FCollisionShape CollShape;
-	CollShape.SetSphere(DistanceToCheckNearbyBots);
-
-	FCollisionObjectQueryParams QueryParams;
-	QueryParams.AddObjectTypesToQuery(ECC_WorldDynamic);
-	QueryParams.AddObjectTypesToQuery(ECC_Pawn);
-
-	TArray<FOverlapResult> Overlaps;
-	GetWorld()->OverlapMultiByObjectType(Overlaps, GetActorLocation(), FQuat::Identity, QueryParams, CollShape);
-
 	if (DebugTrackerBotDrawing)
 		DrawDebugSphere(GetWorld(), GetActorLocation(), DistanceToCheckNearbyBots, 12, FColor::White, false, 1.0f);
 
-	// Calculate Power Level based on number of nearby bots
-	int32 NumOfBots = 0;
-	for (FOverlapResult Result : Overlaps)
-	{
-		// Look for TrackerBots
-		ASTrackerBot* OtherTrackerBot = Cast<ASTrackerBot>(Result.GetActor());
-		if (OtherTrackerBot != nullptr && OtherTrackerBot != this)
-		{
-			++NumOfBots;	
-		}
-	}
+	int32 NewPowerLevel = FMath::Clamp(NumOfBots, 0, MaxPowerLevel);
+	if (NewPowerLevel == PowerLevel)
+		return;
 
-	PowerLevel = FMath::Clamp(NumOfBots, 0, MaxPowerLevel);
+	PowerLevel = NewPowerLevel;
 
 	// Update material "PowerLevelAlpha" variable
 	if (MatInst != nullptr)
@@ -222,44 +461,56 @@ void ASTrackerBot::OnCheckNearbyBots()
 		DrawDebugString(GetWorld(), FVector(0, 0, 0), FString::FromInt(PowerLevel), this, FColor::White, 1.0f, true);
 }
 
-// Called every frame
-void ASTrackerBot::Tick(float DeltaTime)
+void ASTrackerBot::UpdateSteering()
 {
-	Super::Tick(DeltaTime);
+	bool bFollowingFlowField = TrackerBotNavMode > 0 && FollowFlowField();
 
-	if (GetLocalRole() == ROLE_Authority && !bExploded)
+	float DistanceToTarget = (GetActorLocation() - NextPathPoint).Size();
+
+	if (DistanceToTarget <= RequiredDistanceToTarget)
 	{
+		if (!bFollowingFlowField)
+			AdvancePath();
 
-		float DistanceToTarget = (GetActorLocation() - NextPathPoint).Size();
+		//DrawDebugString(GetWorld(), GetActorLocation(), "Target reached");
+	}
 
-		if (DistanceToTarget <= RequiredDistanceToTarget)
-		{
-			NextPathPoint = GetNextPathPoint();
+	if (DebugTrackerBotDrawing)
+		DrawDebugSphere(GetWorld(), NextPathPoint, 20, 12, FColor::Yellow, false, 0.0f, 1.0f);
+}
 
-			//DrawDebugString(GetWorld(), GetActorLocation(), "Target reached");
-		}
-		else
-		{
-			if (NextPathPoint.Z > GetActorLocation().Z)
-			{
-				// Jump
-				MeshComp->AddImpulse(FVector::UpVector * JumpForce, NAME_None, true);
-			}
+void ASTrackerBot::ApplySteering(const FVector& Force, bool bJump)
+{
+	if (Force.IsZero())
+		return;
 
-			// Keep moving towards next target
-			FVector ForceDirection = NextPathPoint - GetActorLocation();
-			ForceDirection.Normalize();
+	if (bJump)
+	{
+		// Jump
+		MeshComp->AddImpulse(FVector::UpVector * JumpForce, NAME_None, true);
+	}
 
-			ForceDirection *= MovementForce;
+	// Keep moving towards next target
+	MeshComp->AddForce(Force, NAME_None, bUseVelocityChange);
+
+	if (DebugTrackerBotDrawing)
+		DrawDebugDirectionalArrow(GetWorld(), GetActorLocation(), GetActorLocation() + Force, 32, FColor::Yellow, false, 0.0f, 1.0f);
+}
 
-			MeshComp->AddForce(ForceDirection, NAME_None, bUseVelocityChange);
+// Called every frame
+void ASTrackerBot::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
 
-			if (DebugTrackerBotDrawing)
-				DrawDebugDirectionalArrow(GetWorld(), GetActorLocation(), GetActorLocation() + ForceDirection, 32, FColor::Yellow, false, 0.0f, 1.0f);
-		}
+	// Only runs for bots the subsystem doesn't update
+	if (GetLocalRole() == ROLE_Authority && !bExploded)
+	{
+		UpdateSteering();
 
-		if (DebugTrackerBotDrawing)
-			DrawDebugSphere(GetWorld(), NextPathPoint, 20, 12, FColor::Yellow, false, 0.0f, 1.0f);
+		FVector Location = GetActorLocation();
+		FVector Force;
+		uint8 Flags = FBotSteeringBatch::ComputeSingle(&Location.X, &NextPathPoint.X, MovementForce, RequiredDistanceToTarget, &Force.X);
+		ApplySteering(Force, (Flags & BOTSTEERING_WantsToJump) != 0);
 	}
 }
 
@@ -292,7 +543,8 @@ void ASTrackerBot::NotifyActorBeginOverlap(AActor* OtherActor)
 			}
 			bStartedSelfDestruction = true;
 
-			UGameplayStatics::SpawnSoundAttached(SelfDestructSound, RootComponent);
+			if (FSCosmetics::ShouldPlay(this))
+				UGameplayStatics::SpawnSoundAttached(SelfDestructSound, RootComponent);
 		}
 	}
 }
@@ -312,4 +564,5 @@ void ASTrackerBot::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLife
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME_CONDITION(ASTrackerBot, PowerLevel, COND_SkipOwner);
+	DOREPLIFETIME(ASTrackerBot, PoolState);
 }
\ No newline at end of file
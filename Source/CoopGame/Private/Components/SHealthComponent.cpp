@@ -4,6 +4,7 @@
 #include "../../Public/Components/SHealthComponent.h"
 #include "Net\UnrealNetwork.h"
 #include "SGameMode.h"
+#include "Subsystems/SHealthRegistrySubsystem.h"
 
 // Sets default values for this component's properties
 USHealthComponent::USHealthComponent()
@@ -14,6 +15,8 @@ USHealthComponent::USHealthComponent()
 
 	//SetIsReplicated(true);
 	bIsDead = false;
+
+	RegistryHandle = INDEX_NONE;
 }
 
 
@@ -33,10 +36,43 @@ void USHealthComponent::BeginPlay()
 	}
 
 	Health = DefaultHealth;
+
+	SetRegistered(true);
+}
+
+void USHealthComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetRegistered(false);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void USHealthComponent::SetRegistered(bool bRegistered)
+{
+	USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+	if (Registry == nullptr) return;
+
+	if (bRegistered)
+		Registry->Register(this);
+	else
+		Registry->Unregister(this);
+}
+
+void USHealthComponent::UpdateRegistry()
+{
+	if (RegistryHandle == INDEX_NONE) return;
+
+	USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+	if (Registry != nullptr)
+	{
+		Registry->UpdateAlive(this);
+	}
 }
 
 void USHealthComponent::OnRep_Health(float OldHealth)
 {
+	UpdateRegistry();
+
 	float Damage = Health - OldHealth;
 	OnHealthChanged.Broadcast(this, Health, Damage, nullptr, nullptr, nullptr);
 }
@@ -57,19 +93,40 @@ void USHealthComponent::Heal(float HealAmount)
 
 	UE_LOG(LogTemp, Log, TEXT("Health Changed: %s (+%s)"), *FString::SanitizeFloat(Health), *FString::SanitizeFloat(HealAmount));
 
+	UpdateRegistry();
+
 	OnHealthChanged.Broadcast(this, Health, -HealAmount, nullptr, nullptr, nullptr);
 }
 
+void USHealthComponent::ResetHealth()
+{
+	Health = DefaultHealth;
+	bIsDead = false;
+
+	UpdateRegistry();
+}
+
 bool USHealthComponent::IsFriendly(AActor* ActorA, AActor* ActorB)
 {
 	if (ActorA == nullptr || ActorB == nullptr) return true;			// Assume friendly
 
-	USHealthComponent* HealthCompA = Cast<USHealthComponent>(ActorA->GetComponentByClass(USHealthComponent::StaticClass()));
-	USHealthComponent* HealthCompB = Cast<USHealthComponent>(ActorB->GetComponentByClass(USHealthComponent::StaticClass()));
+	USHealthRegistrySubsystem* Registry = ActorA->GetWorld() != nullptr ? ActorA->GetWorld()->GetSubsystem<USHealthRegistrySubsystem>() : nullptr;
+	if (Registry == nullptr)
+	{
+		USHealthComponent* HealthCompA = Cast<USHealthComponent>(ActorA->GetComponentByClass(USHealthComponent::StaticClass()));
+		USHealthComponent* HealthCompB = Cast<USHealthComponent>(ActorB->GetComponentByClass(USHealthComponent::StaticClass()));
+
+		if (HealthCompA == nullptr || HealthCompB == nullptr) return true; // Assume friendly
 
-	if (HealthCompA == nullptr || HealthCompB == nullptr) return true; // Assume friendly
+		return HealthCompA->TeamNum == HealthCompB->TeamNum;
+	}
 
-	return HealthCompA->TeamNum == HealthCompB->TeamNum;
+	int32 HandleA = Registry->FindHandle(ActorA);
+	int32 HandleB = Registry->FindHandle(ActorB);
+
+	if (HandleA == INDEX_NONE || HandleB == INDEX_NONE) return true; // Assume friendly
+
+	return Registry->IsFriendly(HandleA, HandleB);
 }
 
 void USHealthComponent::HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser)
@@ -89,6 +146,8 @@ void USHealthComponent::HandleTakeAnyDamage(AActor* DamagedActor, float Damage,
 
 	bIsDead = Health <= 0.0f;
 
+	UpdateRegistry();
+
 	OnHealthChanged.Broadcast(this, Health, Damage, DamageType, InstigatedBy, DamageCauser);
 
 	if (bIsDead)
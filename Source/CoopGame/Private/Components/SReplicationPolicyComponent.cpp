@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Components/SReplicationPolicyComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Subsystems/SReplicationPolicySubsystem.h"
+#include "SReplicationGraph.h"
+
+// Sets default values for this component's properties
+USReplicationPolicyComponent::USReplicationPolicyComponent()
+{
+	NearDistance = 2000.0f;
+	FarDistance = 8000.0f;
+	NearNetUpdateFrequency = 30.0f;
+	FarNetUpdateFrequency = 5.0f;
+	NearPriorityScale = 1.0f;
+
+	bDormantWhenIdle = false;
+	IdleDelay = 2.0f;
+
+	bIdle = true;
+	bDormant = false;
+	IdleSince = -1.0f;
+
+	DefaultNetUpdateFrequency = 0.0f;
+	DefaultMinNetUpdateFrequency = 0.0f;
+	DefaultNetPriority = 1.0f;
+
+	PolicyIndex = INDEX_NONE;
+}
+
+void USReplicationPolicyComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Only a server replicates
+	AActor* MyOwner = GetOwner();
+	if (MyOwner == nullptr || GetOwnerRole() != ROLE_Authority || GetWorld()->GetNetMode() == NM_Standalone)
+		return;
+
+	DefaultNetUpdateFrequency = MyOwner->NetUpdateFrequency;
+	DefaultMinNetUpdateFrequency = MyOwner->MinNetUpdateFrequency;
+	DefaultNetPriority = MyOwner->NetPriority;
+
+	USReplicationPolicySubsystem* Policies = GetWorld()->GetSubsystem<USReplicationPolicySubsystem>();
+	if (Policies != nullptr)
+		Policies->Register(this);
+}
+
+void USReplicationPolicyComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	USReplicationPolicySubsystem* Policies = GetWorld()->GetSubsystem<USReplicationPolicySubsystem>();
+	if (Policies != nullptr)
+		Policies->Unregister(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void USReplicationPolicyComponent::SetIdle(bool bInIdle)
+{
+	bIdle = bInIdle;
+
+	if (!bIdle && PolicyIndex != INDEX_NONE)
+	{
+		IdleSince = -1.0f;
+		SetDormant(false);
+	}
+}
+
+bool USReplicationPolicyComponent::IsIdle() const
+{
+	if (!bIdle)
+		return false;
+
+	// Physics replicates movement until the body comes to rest
+	const UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent());
+	return Root == nullptr || !Root->IsSimulatingPhysics() || !Root->RigidBodyIsAwake();
+}
+
+void USReplicationPolicyComponent::UpdatePolicy(float PlayerDistance, float Now, USReplicationGraph* Graph)
+{
+	AActor* MyOwner = GetOwner();
+
+	float Alpha = FMath::Clamp((PlayerDistance - NearDistance) / FMath::Max(FarDistance - NearDistance, 1.0f), 0.0f, 1.0f);
+	float PriorityScale = FMath::Lerp(NearPriorityScale, 1.0f, Alpha);
+	MyOwner->NetUpdateFrequency = FMath::Lerp(NearNetUpdateFrequency, FarNetUpdateFrequency, Alpha);
+	MyOwner->MinNetUpdateFrequency = FMath::Min(DefaultMinNetUpdateFrequency, MyOwner->NetUpdateFrequency);
+	MyOwner->NetPriority = DefaultNetPriority * PriorityScale;
+
+	// The graph reads its own per actor settings, not the actor's
+	if (Graph != nullptr)
+		Graph->SetActorReplicationRate(MyOwner, MyOwner->NetUpdateFrequency, PriorityScale);
+
+	if (!bDormantWhenIdle || !IsIdle())
+	{
+		IdleSince = -1.0f;
+		SetDormant(false);
+		return;
+	}
+
+	if (IdleSince < 0.0f)
+		IdleSince = Now;
+
+	if (Now - IdleSince >= IdleDelay)
+		SetDormant(true);
+}
+
+void USReplicationPolicyComponent::RestoreDefaults(USReplicationGraph* Graph)
+{
+	AActor* MyOwner = GetOwner();
+	MyOwner->NetUpdateFrequency = DefaultNetUpdateFrequency;
+	MyOwner->MinNetUpdateFrequency = DefaultMinNetUpdateFrequency;
+	MyOwner->NetPriority = DefaultNetPriority;
+
+	if (Graph != nullptr)
+		Graph->SetActorReplicationRate(MyOwner, DefaultNetUpdateFrequency, 1.0f);
+
+	IdleSince = -1.0f;
+	SetDormant(false);
+}
+
+void USReplicationPolicyComponent::SetDormant(bool bInDormant)
+{
+	if (bDormant == bInDormant)
+		return;
+
+	bDormant = bInDormant;
+	GetOwner()->SetNetDormancy(bDormant ? DORM_DormantAll : DORM_Awake);
+}
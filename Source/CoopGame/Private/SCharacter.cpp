@@ -17,6 +17,146 @@
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/PlayerController.h"
 #include "GameFramework/SpectatorPawn.h"
+#include "Subsystems/SLagCompensationSubsystem.h"
+#include "Subsystems/SReplicationPolicySubsystem.h"
+#include "EngineUtils.h"
+#include "Engine/NetDriver.h"
+
+static float DebugCycleWeapons = 0.0f;
+FAutoConsoleVariableRef CVARDebugCycleWeapons(
+	TEXT("COOP.DebugCycleWeapons"),
+	DebugCycleWeapons,
+	TEXT("Seconds between weapon switches the server makes for every character with more than one weapon, 0 is off"),
+	ECVF_Default);
+
+// Weapon switches made on the server, read by COOP.WeaponCycleBenchmark
+static uint32 NumWeaponSwitches = 0;
+
+// Phase 1 measures without switches, phase 2 with every character cycling weapons
+static void RunWeaponCycleBenchmarkPhase(UWorld* World, int32 Phase, float Seconds, float Interval, double IdleBytesPerSecond)
+{
+	UNetDriver* NetDriver = World->GetNetDriver();
+	uint64 StartBytes = NetDriver->OutTotalBytes;
+	uint32 StartSwitches = NumWeaponSwitches;
+	double StartTime = FPlatformTime::Seconds();
+
+	DebugCycleWeapons = Phase == 1 ? 0.0f : Interval;
+
+	TWeakObjectPtr<UWorld> WeakWorld = World;
+	FTimerHandle TimerHandle;
+	World->GetTimerManager().SetTimer(TimerHandle, FTimerDelegate::CreateLambda([=]()
+	{
+		UWorld* BenchmarkWorld = WeakWorld.Get();
+		UNetDriver* BenchmarkNetDriver = BenchmarkWorld != nullptr ? BenchmarkWorld->GetNetDriver() : nullptr;
+		if (BenchmarkNetDriver == nullptr)
+			return;
+
+		double Elapsed = FMath::Max(FPlatformTime::Seconds() - StartTime, 0.001);
+		double BytesPerSecond = (BenchmarkNetDriver->OutTotalBytes - StartBytes) / Elapsed;
+		int32 NumConnections = FMath::Max(BenchmarkNetDriver->ClientConnections.Num(), 1);
+
+		if (Phase == 1)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Weapon cycle benchmark, no switches: %.1f KB/s per connection"),
+				BytesPerSecond / 1024.0 / NumConnections);
+
+			RunWeaponCycleBenchmarkPhase(BenchmarkWorld, 2, Seconds, Interval, BytesPerSecond);
+			return;
+		}
+
+		DebugCycleWeapons = 0.0f;
+
+		uint32 Switches = NumWeaponSwitches - StartSwitches;
+		UE_LOG(LogTemp, Log, TEXT("Weapon cycle benchmark, switching every %.2f s: %.1f KB/s per connection, %u switches, %.0f extra bytes sent per switch per connection"),
+			Interval, BytesPerSecond / 1024.0 / NumConnections, Switches,
+			(BytesPerSecond - IdleBytesPerSecond) * Elapsed / FMath::Max(Switches, 1u) / NumConnections);
+	}), Seconds, false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs WeaponCycleBenchmarkCmd(
+	TEXT("COOP.WeaponCycleBenchmark"),
+	TEXT("Logs bytes sent per connection without weapon switches and then with the server cycling the weapons of every character, and the extra bytes per switch. ")
+	TEXT("Run it on the server with the clients connected. Usage: COOP.WeaponCycleBenchmark [SecondsPerPhase=10] [Interval=0.5]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr || World->GetNetDriver() == nullptr || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Weapon cycle benchmark: run it on a server"));
+			return;
+		}
+
+		float Seconds = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f;
+		float Interval = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.5f;
+		RunWeaponCycleBenchmarkPhase(World, 1, FMath::Max(Seconds, 1.0f), FMath::Max(Interval, 0.05f), 0.0);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs WeaponNetBenchmarkCmd(
+	TEXT("COOP.WeaponNetBenchmark"),
+	TEXT("Gives every player NumWeapons weapons and runs COOP.NetPolicyBenchmark, holstered weapons stay awake with the policies off and go dormant with them on. ")
+	TEXT("Run it on the server with the clients connected. Usage: COOP.WeaponNetBenchmark [NumWeapons=8] [SecondsPerPhase=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USReplicationPolicySubsystem* Policies = World != nullptr ? World->GetSubsystem<USReplicationPolicySubsystem>() : nullptr;
+		if (Policies == nullptr || World->GetNetMode() == NM_Client)
+			return;
+
+		int32 NumWeapons = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 8;
+		NumWeapons = FMath::Clamp(NumWeapons, 1, (int32)FSInventoryAmmo::MaxWeapons);
+
+		int32 NumPlayers = 0;
+		for (TActorIterator<ASCharacter> It(World); It; ++It)
+		{
+			if (It->IsPlayerControlled())
+			{
+				It->FillWeapons(NumWeapons);
+				++NumPlayers;
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Weapon net benchmark: %d players with %d weapons each"), NumPlayers, NumWeapons);
+
+		float Seconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+		Policies->RunBenchmark(FMath::Max(Seconds, 1.0f));
+	}));
+
+void FSWeaponInventory::Add(ASWeapon* Weapon)
+{
+	FSInventorySlot& NewSlot = Slots.AddDefaulted_GetRef();
+	NewSlot.Weapon = Weapon;
+	NewSlot.Slot = Slots.Num() - 1;
+	MarkItemDirty(NewSlot);
+}
+
+ASWeapon* FSWeaponInventory::GetWeapon(int32 Slot) const
+{
+	// Slot order on clients follows arrival
+	if (Slots.IsValidIndex(Slot) && Slots[Slot].Slot == Slot)
+		return Slots[Slot].Weapon;
+
+	for (const FSInventorySlot& InventorySlot : Slots)
+	{
+		if (InventorySlot.Slot == Slot)
+			return InventorySlot.Weapon;
+	}
+	return nullptr;
+}
+
+bool FSInventoryAmmo::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 NumWeapons = FMath::Min(Ammo.Num(), (int32)MaxWeapons);
+	Ar.SerializeInt(NumWeapons, MaxWeapons + 1);
+
+	if (Ar.IsLoading())
+		Ammo.SetNumZeroed(NumWeapons);
+
+	for (uint32 i = 0; i < NumWeapons; ++i)
+	{
+		Ar << Ammo[i];
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
 
 // Sets default values
 ASCharacter::ASCharacter()
@@ -41,6 +181,9 @@ ASCharacter::ASCharacter()
 	WeaponAttachSocketName = "WeaponSocket";
 
 	WeaponChangeTime = 1.0f;
+	LastChangeTime = 0.0f;
+
+	EquippedSlot = 0;
 
 	bDied = false; 
 	bIsChangingWeapon = false;
@@ -61,34 +204,30 @@ void ASCharacter::BeginPlay()
 
 	if (GetLocalRole() == ROLE_Authority)
 	{
-		// Spawn a default weapon
-		FActorSpawnParameters SpawnParams;
-		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		// Track hitbox for lag compensated shots
+		USLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USLagCompensationSubsystem>();
+		if (LagCompensation != nullptr)
+			LagCompensation->RegisterActor(this);
 
+		// Spawn the starter weapons
 		for (TSubclassOf<ASWeapon> WeaponClass : StarterWeaponClasses)
 		{
-			ASWeapon* Weapon = GetWorld()->SpawnActor<ASWeapon>(WeaponClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
-			if (Weapon != nullptr)
-			{
-				Weapon->SetOwner(this);
-				Weapon->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, WeaponAttachSocketName);
-				Weapon->SetActorHiddenInGame(true);
-				PlayerWeapons.Add(Weapon);
-			}
-		}
-
-		// Set current weapon
-		if (PlayerWeapons[0] != nullptr)
-		{
-			CurrentWeapon.Index = 0;
-			CurrentWeapon.Weapon = PlayerWeapons[0];
-			CurrentWeapon.Weapon->SetActorHiddenInGame(false);
+			AddWeapon(WeaponClass);
 		}
 	}
 
 	OnCharacterStart();
 }
 
+void ASCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	USLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USLagCompensationSubsystem>();
+	if (LagCompensation != nullptr)
+		LagCompensation->UnregisterActor(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void ASCharacter::MoveForward(float Value)
 {
 	AddMovementInput(GetActorForwardVector() * Value);
@@ -112,40 +251,46 @@ void ASCharacter::EndCrouch()
 void ASCharacter::BeginZoom()
 {
 	TargetFOV = ZoomedFOV;
-	if (CurrentWeapon.Weapon != nullptr)
-		CurrentWeapon.Weapon->bInAimingMode = true;
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
+		Weapon->bInAimingMode = true;
 }
 
 void ASCharacter::EndZoom()
 {
 	TargetFOV = DefaultFOV;
-	if (CurrentWeapon.Weapon != nullptr)
-		CurrentWeapon.Weapon->bInAimingMode = false;
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
+		Weapon->bInAimingMode = false;
 }
 
 void ASCharacter::StartFire()
 {
-	if (CurrentWeapon.Weapon != nullptr && !bIsChangingWeapon)
-		CurrentWeapon.Weapon->StartFire();
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr && !bIsChangingWeapon && Weapon->IsNetReady())
+		Weapon->StartFire();
 }
 
 void ASCharacter::StopFire()
 {
-	if (CurrentWeapon.Weapon != nullptr)
-		CurrentWeapon.Weapon->StopFire();
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
+		Weapon->StopFire();
 }
 
 void ASCharacter::Reload()
 {
-	if (CurrentWeapon.Weapon != nullptr && !CurrentWeapon.Weapon->bIsReloading)
-		CurrentWeapon.Weapon->StartReload();
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr && !Weapon->bIsReloading && Weapon->IsNetReady())
+		Weapon->StartReload();
 }
 
 void ASCharacter::ToggleFireType()
 {
-	if (CurrentWeapon.Weapon != nullptr)
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
 	{
-		CurrentWeapon.Weapon->ToggleFireType();
+		Weapon->ToggleFireType();
 		OnToggleFireType();	// Blueprint implemented
 	}
 }
@@ -159,15 +304,10 @@ void ASCharacter::StartNextWeapon()
 
 void ASCharacter::NextWeapon()
 {
-	CurrentWeapon.Weapon->SetActorHiddenInGame(true);
-
-	if (CurrentWeapon.Index < PlayerWeapons.Num() - 1)
-		++CurrentWeapon.Index;
+	if (EquippedSlot < Inventory.Num() - 1)
+		SetCurrentWeapon(EquippedSlot + 1);
 	else
-		CurrentWeapon.Index = 0;
-
-	CurrentWeapon.Weapon = PlayerWeapons[CurrentWeapon.Index];
-	CurrentWeapon.Weapon->SetActorHiddenInGame(false);
+		SetCurrentWeapon(0);
 
 	LastChangeTime = GetWorld()->TimeSeconds;
 
@@ -183,15 +323,10 @@ void ASCharacter::StartPreviousWeapon()
 
 void ASCharacter::PreviousWeapon()
 {
-	CurrentWeapon.Weapon->SetActorHiddenInGame(true);
-
-	if (CurrentWeapon.Index > 0)
-		--CurrentWeapon.Index;
+	if (EquippedSlot > 0)
+		SetCurrentWeapon(EquippedSlot - 1);
 	else
-		CurrentWeapon.Index = PlayerWeapons.Num() - 1;
-
-	CurrentWeapon.Weapon = PlayerWeapons[CurrentWeapon.Index];
-	CurrentWeapon.Weapon->SetActorHiddenInGame(false);
+		SetCurrentWeapon(Inventory.Num() - 1);
 
 	LastChangeTime = GetWorld()->TimeSeconds;
 
@@ -208,17 +343,10 @@ void ASCharacter::StartEquipWeapon(uint8 WeaponIndex)
 
 void ASCharacter::EquipWeapon(uint8 WeaponIndex)
 {
-	if (WeaponIndex < PlayerWeapons.Num())
+	if (WeaponIndex != EquippedSlot && Inventory.GetWeapon(WeaponIndex) != nullptr)
 	{
-		ASWeapon* NewWeapon = PlayerWeapons[WeaponIndex];
-		if (NewWeapon != nullptr && NewWeapon != CurrentWeapon.Weapon)
-		{
-			CurrentWeapon.Weapon->SetActorHiddenInGame(true);
-			CurrentWeapon.Index = WeaponIndex;
-			CurrentWeapon.Weapon = NewWeapon;
-			LastChangeTime = GetWorld()->TimeSeconds;
-			CurrentWeapon.Weapon->SetActorHiddenInGame(false);
-		}
+		SetCurrentWeapon(WeaponIndex);
+		LastChangeTime = GetWorld()->TimeSeconds;
 	}
 	EndEquipWeapon();
 }
@@ -230,6 +358,73 @@ void ASCharacter::EndEquipWeapon()
 	bIsChangingWeapon = false;
 }
 
+void ASCharacter::SetCurrentWeapon(uint8 Slot)
+{
+	ASWeapon* NewWeapon = Inventory.GetWeapon(Slot);
+	if (NewWeapon == nullptr || Slot == EquippedSlot)
+		return;
+
+	ASWeapon* OldWeapon = GetCurrentWeapon();
+	if (OldWeapon != nullptr)
+		OldWeapon->SetHolstered(true);
+
+	EquippedSlot = Slot;
+
+	if (GetLocalRole() < ROLE_Authority)
+	{
+		// The weapon's own ammo is stale while it was dormant
+		if (InventoryAmmo.Ammo.IsValidIndex(Slot))
+			NewWeapon->SetCurrentAmmo(InventoryAmmo.Ammo[Slot]);
+
+		ServerSetCurrentWeapon(Slot);
+	}
+	else
+	{
+		++NumWeaponSwitches;
+	}
+
+	NewWeapon->SetHolstered(false);
+}
+
+void ASCharacter::ServerSetCurrentWeapon_Implementation(uint8 Slot)
+{
+	SetCurrentWeapon(Slot);
+}
+
+bool ASCharacter::ServerSetCurrentWeapon_Validate(uint8 Slot)
+{
+	return true;
+}
+
+ASWeapon* ASCharacter::AddWeapon(TSubclassOf<ASWeapon> WeaponClass)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	ASWeapon* Weapon = GetWorld()->SpawnActor<ASWeapon>(WeaponClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+	if (Weapon != nullptr)
+	{
+		Weapon->SetOwner(this);
+		Weapon->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, WeaponAttachSocketName);
+		Weapon->SetHolstered(Inventory.Num() != EquippedSlot);
+		Inventory.Add(Weapon);
+	}
+	return Weapon;
+}
+
+void ASCharacter::FillWeapons(int32 NumWeapons)
+{
+	if (GetLocalRole() < ROLE_Authority || StarterWeaponClasses.Num() == 0)
+		return;
+
+	NumWeapons = FMath::Min(NumWeapons, (int32)FSInventoryAmmo::MaxWeapons);
+	for (int32 i = Inventory.Num(); i < NumWeapons; ++i)
+	{
+		if (AddWeapon(StarterWeaponClasses[i % StarterWeaponClasses.Num()]) == nullptr)
+			break;
+	}
+}
+
 void ASCharacter::OnHealthChanged(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType,
 	class AController* InstigatedBy, AActor* DamageCauser)
 {
@@ -271,7 +466,9 @@ void ASCharacter::OnHealthChanged(USHealthComponent* OwningHealthComp, float Hea
 		}
 
 		SetLifeSpan(10.0f);
-		CurrentWeapon.Weapon->SetLifeSpan(10.0f);
+		ASWeapon* Weapon = GetCurrentWeapon();
+		if (Weapon != nullptr)
+			Weapon->SetLifeSpan(10.0f);
 		OnClientDeath();
 	}
 }
@@ -309,17 +506,30 @@ void ASCharacter::Death()
 
 ASWeapon* ASCharacter::GetCurrentWeapon()
 {
-	return CurrentWeapon.Weapon;
+	return Inventory.GetWeapon(EquippedSlot);
 }
 
 bool ASCharacter::GetIsReloading()
 {
-	if (CurrentWeapon.Weapon != nullptr)
-		return CurrentWeapon.Weapon->bIsReloading;
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
+		return Weapon->bIsReloading;
 
 	return false;
 }
 
+int32 ASCharacter::GetWeaponAmmo(int32 Slot) const
+{
+	ASWeapon* Weapon = Inventory.GetWeapon(Slot);
+	if (Weapon == nullptr)
+		return 0;
+
+	if (Slot == EquippedSlot)
+		return Weapon->GetCurrentAmmo();
+
+	return InventoryAmmo.Ammo.IsValidIndex(Slot) ? InventoryAmmo.Ammo[Slot] : 0;
+}
+
 void ASCharacter::ChangeMaxWalkSpeed(float NewSpeed)
 {
 	GetCharacterMovement()->MaxWalkSpeed = NewSpeed;
@@ -338,8 +548,9 @@ bool ASCharacter::ClientChangeMaxWalkSpeed_Validate(float NewSpeed)
 
 void ASCharacter::SetExplosiveBullets(bool bExplosive)
 {
-	if (CurrentWeapon.Weapon != nullptr)
-		CurrentWeapon.Weapon->bExplosiveBullets = bExplosive;
+	ASWeapon* Weapon = GetCurrentWeapon();
+	if (Weapon != nullptr)
+		Weapon->bExplosiveBullets = bExplosive;
 }
 
 // Called every frame
@@ -352,6 +563,12 @@ void ASCharacter::Tick(float DeltaTime)
 		float newFOV = FMath::FInterpTo(CameraComp->FieldOfView, TargetFOV, DeltaTime, ZoomInterpSpeed);
 		CameraComp->SetFieldOfView(newFOV);
 	}
+
+	if (DebugCycleWeapons > 0.0f && GetLocalRole() == ROLE_Authority && Inventory.Num() > 1
+		&& GetWorld()->TimeSeconds - LastChangeTime >= DebugCycleWeapons)
+	{
+		NextWeapon();
+	}
 }
 
 // Called to bind functionality to input
@@ -410,12 +627,28 @@ FVector ASCharacter::GetPawnViewLocation() const
 	return Super::GetPawnViewLocation();
 }
 
+void ASCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	// Holstered weapons can still finish a reload while they are dormant
+	int32 NumWeapons = FMath::Min(Inventory.Num(), (int32)FSInventoryAmmo::MaxWeapons);
+	InventoryAmmo.Ammo.SetNumZeroed(NumWeapons);
+	for (int32 Slot = 0; Slot < NumWeapons; ++Slot)
+	{
+		ASWeapon* Weapon = Inventory.GetWeapon(Slot);
+		if (Weapon != nullptr && Slot != EquippedSlot)
+			InventoryAmmo.Ammo[Slot] = Weapon->GetCurrentAmmo();
+	}
+}
+
 void ASCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(ASCharacter, CurrentWeapon);
-	DOREPLIFETIME(ASCharacter, PlayerWeapons);
+	DOREPLIFETIME(ASCharacter, Inventory);
+	DOREPLIFETIME(ASCharacter, EquippedSlot);
+	DOREPLIFETIME_CONDITION(ASCharacter, InventoryAmmo, COND_OwnerOnly);
 	DOREPLIFETIME(ASCharacter, bDied);
 	DOREPLIFETIME(ASCharacter, bIsChangingWeapon);
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SCosmetics.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "TimerManager.h"
+#include "Containers/Ticker.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+#include "AI/STrackerBot.h"
+#include "SExplosiveBarrel.h"
+#include "Subsystems/STrackerBotPoolSubsystem.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopCosmetics"), STATGROUP_CoopCosmetics, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cosmetics Played"), STAT_CosmeticsPlayed, STATGROUP_CoopCosmetics);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cosmetics Skipped"), STAT_CosmeticsSkipped, STATGROUP_CoopCosmetics);
+
+static int32 ForceServerCosmetics = 0;
+FAutoConsoleVariableRef CVARForceServerCosmetics(
+	TEXT("COOP.ForceServerCosmetics"),
+	ForceServerCosmetics,
+	TEXT("1 runs cosmetics on dedicated servers too, -1 skips them everywhere, to compare server tick time with and without them"),
+	ECVF_Cheat);
+
+// Server frames seen by the current COOP.CosmeticsBenchmark phase
+struct FCosmeticsBenchmarkFrames
+{
+	int32 Frames = 0;
+	double Seconds = 0.0;
+	double WorstSeconds = 0.0;
+};
+
+// Phase 1 runs with cosmetics forced off, phase 2 forced on. Half way through everything spawned is blown up
+static void RunCosmeticsBenchmarkPhase(UWorld* World, int32 Phase, int32 NumBots, int32 NumBarrels, float Seconds, int32 OldForce)
+{
+	ForceServerCosmetics = Phase == 1 ? -1 : 1;
+
+	// Around the first player so bots have somebody to chase, bots of the level's class if it has any
+	FVector Center = FVector::ZeroVector;
+	APlayerController* PC = World->GetFirstPlayerController();
+	if (PC != nullptr && PC->GetPawn() != nullptr)
+		Center = PC->GetPawn()->GetActorLocation();
+
+	TSubclassOf<ASTrackerBot> BotClass = ASTrackerBot::StaticClass();
+	TActorIterator<ASTrackerBot> BotIt(World);
+	if (BotIt)
+		BotClass = BotIt->GetClass();
+
+	TSubclassOf<ASExplosiveBarrel> BarrelClass = ASExplosiveBarrel::StaticClass();
+	TActorIterator<ASExplosiveBarrel> BarrelIt(World);
+	if (BarrelIt)
+		BarrelClass = BarrelIt->GetClass();
+
+	TArray<TWeakObjectPtr<AActor>> Spawned;
+	USTrackerBotPoolSubsystem* BotPool = World->GetSubsystem<USTrackerBotPoolSubsystem>();
+	for (int32 i = 0; i < NumBots; ++i)
+	{
+		FVector Offset = FRotator(0.0f, 360.0f * i / NumBots, 0.0f).Vector() * 1500.0f;
+		Spawned.Add(BotPool->SpawnBotAt(BotClass, FTransform(Center + Offset + FVector(0.0f, 0.0f, 100.0f))));
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	for (int32 i = 0; i < NumBarrels; ++i)
+	{
+		FVector Offset = FRotator(0.0f, 360.0f * i / NumBarrels, 0.0f).Vector() * 800.0f;
+		Spawned.Add(World->SpawnActor<ASExplosiveBarrel>(BarrelClass, Center + Offset, FRotator::ZeroRotator, SpawnParams));
+	}
+
+	TSharedRef<FCosmeticsBenchmarkFrames> Frames = MakeShared<FCosmeticsBenchmarkFrames>();
+	FDelegateHandle TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Frames](float DeltaTime)
+	{
+		++Frames->Frames;
+		Frames->Seconds += DeltaTime;
+		Frames->WorstSeconds = FMath::Max(Frames->WorstSeconds, (double)DeltaTime);
+		return true;
+	}));
+
+	TWeakObjectPtr<UWorld> WeakWorld = World;
+	FTimerHandle ExplodeTimerHandle;
+	World->GetTimerManager().SetTimer(ExplodeTimerHandle, FTimerDelegate::CreateLambda([Spawned]()
+	{
+		for (const TWeakObjectPtr<AActor>& Actor : Spawned)
+		{
+			if (Actor.IsValid())
+				UGameplayStatics::ApplyDamage(Actor.Get(), 1000.0f, nullptr, Actor.Get(), UDamageType::StaticClass());
+		}
+	}), Seconds * 0.5f, false);
+
+	FTimerHandle TimerHandle;
+	World->GetTimerManager().SetTimer(TimerHandle, FTimerDelegate::CreateLambda([=]()
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+
+		// Exploded barrels stay around, bots went back to their pool
+		for (const TWeakObjectPtr<AActor>& Actor : Spawned)
+		{
+			if (Actor.IsValid() && Actor->IsA<ASExplosiveBarrel>())
+				Actor->Destroy();
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Cosmetics benchmark, cosmetics %s: %d bots and %d barrels, %d frames, %.2f ms avg / %.2f ms worst frame"),
+			Phase == 1 ? TEXT("off") : TEXT("on"), NumBots, NumBarrels, Frames->Frames,
+			Frames->Frames > 0 ? Frames->Seconds * 1000.0 / Frames->Frames : 0.0, Frames->WorstSeconds * 1000.0);
+
+		UWorld* BenchmarkWorld = WeakWorld.Get();
+		if (Phase == 1 && BenchmarkWorld != nullptr)
+		{
+			RunCosmeticsBenchmarkPhase(BenchmarkWorld, 2, NumBots, NumBarrels, Seconds, OldForce);
+			return;
+		}
+
+		ForceServerCosmetics = OldForce;
+	}), Seconds, false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CosmeticsBenchmarkCmd(
+	TEXT("COOP.CosmeticsBenchmark"),
+	TEXT("Spawns bots and explosive barrels around the first player, blows them up half way through and logs server frame times, first with cosmetics forced off and then forced on. ")
+	TEXT("Run it on the server. Usage: COOP.CosmeticsBenchmark [NumBots=100] [NumBarrels=50] [SecondsPerPhase=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cosmetics benchmark: run it on a server"));
+			return;
+		}
+
+#if !WITH_COOP_COSMETICS
+		UE_LOG(LogTemp, Warning, TEXT("Cosmetics benchmark: cosmetics are compiled out of this build, both phases run without them"));
+#endif
+
+		int32 NumBots = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		int32 NumBarrels = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 50;
+		float Seconds = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 10.0f;
+		RunCosmeticsBenchmarkPhase(World, 1, FMath::Max(NumBots, 1), FMath::Max(NumBarrels, 1), FMath::Max(Seconds, 1.0f), ForceServerCosmetics);
+	}));
+
+bool FSCosmetics::ShouldPlay(const UObject* WorldContextObject)
+{
+#if WITH_COOP_COSMETICS
+	UWorld* World = GEngine != nullptr ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr;
+	if (World != nullptr && ForceServerCosmetics >= 0 && (ForceServerCosmetics > 0 || World->GetNetMode() != NM_DedicatedServer))
+	{
+		INC_DWORD_STAT(STAT_CosmeticsPlayed);
+		return true;
+	}
+#endif
+
+	INC_DWORD_STAT(STAT_CosmeticsSkipped);
+	return false;
+}
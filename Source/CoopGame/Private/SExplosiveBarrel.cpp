@@ -2,6 +2,7 @@
 
 #include "../Public/SExplosiveBarrel.h"
 #include "../Public/Components/SHealthComponent.h"
+#include "Components/SReplicationPolicyComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "Materials/Material.h"
 #include "Kismet/GameplayStatics.h"
@@ -9,6 +10,15 @@
 #include "Net\UnrealNetwork.h"
 #include "DrawDebugHelpers.h"
 #include "Sound\SoundCue.h"
+#include "SCosmetics.h"
+#include "Subsystems/SExplosionSubsystem.h"
+
+static int32 DebugExplosiveBarrelDrawing = 0;
+FAutoConsoleVariableRef CVARDebugExplosiveBarrelDrawing(
+	TEXT("COOP.DebugExplosiveBarrel"),
+	DebugExplosiveBarrelDrawing,
+	TEXT("Draw Debug Spheres for Explosive Barrels"),
+	ECVF_Cheat);
 
 // Sets default values
 ASExplosiveBarrel::ASExplosiveBarrel()
@@ -35,12 +45,21 @@ ASExplosiveBarrel::ASExplosiveBarrel()
 
 	JumpImpulse = 500;
 
+	// Settled barrels go dormant until something moves them
+	ReplicationPolicyComp = CreateDefaultSubobject<USReplicationPolicyComponent>(TEXT("ReplicationPolicyComp"));
+	ReplicationPolicyComp->NearNetUpdateFrequency = 20.0f;
+	ReplicationPolicyComp->FarNetUpdateFrequency = 2.0f;
+	ReplicationPolicyComp->bDormantWhenIdle = true;
+
 	SetReplicates(true);
 	SetReplicateMovement(true);
 }
 
 void ASExplosiveBarrel::ExplodeEffects()
 {
+	if (!FSCosmetics::ShouldPlay(this))
+		return;
+
 	// Change material
 	MeshComp->SetMaterial(0, ExplodedMaterial);
 
@@ -57,26 +76,35 @@ void ASExplosiveBarrel::OnHealthChanged(USHealthComponent* OwningHealthComp, flo
 	if (Health <= 0.0f && !bExploded)
 	{
 		// Explode
+		ReplicationPolicyComp->SetIdle(false);
 		bExploded = true;
 		OnRep_Exploded();
-		ExplodeEffects();
 
 		// Add force to barrel
 		MeshComp->AddImpulse(FVector::UpVector * JumpImpulse, NAME_None, true);
 
-		// Add radial force
-		RadialForceComp->FireImpulse();
+		// Add radial force and damage near actors, damage only with authority
+		USExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<USExplosionSubsystem>();
+		if (Explosions != nullptr)
+		{
+			Explosions->Detonate(this, ExplosionDamage, ExplosionRadius, RadialForceComp);
+		}
+		else
+		{
+			RadialForceComp->FireImpulse();
+
+			if (GetLocalRole() == ROLE_Authority)
+			{
+				TArray<AActor*> IgnoredActors;
+				IgnoredActors.Add(this);
+				UGameplayStatics::ApplyRadialDamage(this, ExplosionDamage, GetActorLocation(), ExplosionRadius, nullptr, IgnoredActors, this, GetInstigatorController(), true);
+			}
+		}
 
-		// Add damage
 		if (GetLocalRole() == ROLE_Authority)
 		{
-			TArray<AActor*> IgnoredActors;
-			IgnoredActors.Add(this);
-
-			// Damage near actors
-			UGameplayStatics::ApplyRadialDamage(this, ExplosionDamage, GetActorLocation(), ExplosionRadius, nullptr, IgnoredActors, this, GetInstigatorController(), true);
-
-			DrawDebugSphere(GetWorld(), GetActorLocation(), ExplosionRadius, 12, FColor::Red, false, 2.0f, 0, 1.0f);
+			if (DebugExplosiveBarrelDrawing > 0)
+				DrawDebugSphere(GetWorld(), GetActorLocation(), ExplosionRadius, 12, FColor::Red, false, 2.0f, 0, 1.0f);
 
 			// Destroy Actor Immediately
 			SetLifeSpan(2.0f);
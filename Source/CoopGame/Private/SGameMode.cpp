@@ -3,48 +3,118 @@
 
 #include "SGameMode.h"
 #include "TimerManager.h"
-#include "Components/SHealthComponent.h"
 #include "EngineUtils.h"
 #include "SGameState.h"
 #include "SPlayerState.h"
+#include "Subsystems/SHealthRegistrySubsystem.h"
+#include "Subsystems/SWaveDirectorSubsystem.h"
+#include "AI/STrackerBot.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopGameMode"), STATGROUP_CoopGameMode, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Alive Players"), STAT_GameModeAlivePlayers, STATGROUP_CoopGameMode);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Alive Bots"), STAT_GameModeAliveBots, STATGROUP_CoopGameMode);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Alive Changes"), STAT_GameModeAliveChanges, STATGROUP_CoopGameMode);
 
 ASGameMode::ASGameMode()
 {
 	WaveCount = 0;
 	TimeBetweenWaves = 2.0f;
 
-	PrimaryActorTick.bCanEverTick = true;
-	PrimaryActorTick.TickInterval = 1.0f;
-
 	GameStateClass = ASGameState::StaticClass();
 	PlayerStateClass = ASPlayerState::StaticClass();
 }
 
 void ASGameMode::StartPlay()
 {
+	// Before actors begin play so every health component is seen registering
+	USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+	Registry->OnAliveChanged.AddUObject(this, &ASGameMode::OnAliveChanged);
+
+	USWaveDirectorSubsystem* Director = GetWorld()->GetSubsystem<USWaveDirectorSubsystem>();
+	Director->OnDeployFinished.AddUObject(this, &ASGameMode::OnWaveDeployed);
+
 	Super::StartPlay();
 
 	PrepareForNextWave();
 }
 
-void ASGameMode::Tick(float DeltaSeconds)
+void ASGameMode::FinishRestartPlayer(AController* NewPlayer, const FRotator& StartRotation)
 {
-	Super::Tick(DeltaSeconds);
+	Super::FinishRestartPlayer(NewPlayer, StartRotation);
 
-	ASGameState* GS = GetGameState<ASGameState>();
-	if (ensureAlways(GS != nullptr) && GS->GetWaveState() != EWaveState::GameOver)
+	// The pawn registered alive before it was possessed, so it was counted as a bot
+	APawn* NewPawn = NewPlayer != nullptr ? NewPlayer->GetPawn() : nullptr;
+	if (NewPawn != nullptr)
+	{
+		USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+		int32 Handle = Registry->FindHandle(NewPawn);
+		UpdateAliveActor(NewPawn, Handle != INDEX_NONE && Registry->IsAlive(Handle));
+	}
+}
+
+void ASGameMode::OnAliveChanged(USHealthComponent* HealthComp, bool bAlive)
+{
+	UpdateAliveActor(HealthComp->GetOwner(), bAlive);
+}
+
+void ASGameMode::UpdateAliveActor(AActor* Actor, bool bAlive)
+{
+	INC_DWORD_STAT(STAT_GameModeAliveChanges);
+
+	bool bWasPlayer = AlivePlayers.Remove(Actor) > 0;
+	bool bWasBot = AliveBots.Remove(Actor) > 0;
+
+	APawn* Pawn = Cast<APawn>(Actor);
+	if (bAlive && Pawn != nullptr)
 	{
+		if (Pawn->IsPlayerControlled())
+			AlivePlayers.Add(Pawn);
+		else
+			AliveBots.Add(Pawn);
+	}
+
+	SET_DWORD_STAT(STAT_GameModeAlivePlayers, AlivePlayers.Num());
+	SET_DWORD_STAT(STAT_GameModeAliveBots, AliveBots.Num());
+
+	if (bWasBot)
 		CheckWaveState();
+
+	if (bWasPlayer)
 		CheckAnyPlayerAlive();
-	}
+}
+
+bool ASGameMode::IsGameOver()
+{
+	ASGameState* GS = GetGameState<ASGameState>();
+	return GS == nullptr || GS->GetWaveState() == EWaveState::GameOver;
+}
+
+const USWaveDefinition* ASGameMode::GetWaveDefinition(int32 Wave) const
+{
+	if (WaveDefinitions.Num() == 0 || Wave <= 0)
+		return nullptr;
+
+	// Waves past the end repeat the last definition
+	return WaveDefinitions[FMath::Min(Wave, WaveDefinitions.Num()) - 1];
+}
+
+int32 ASGameMode::GetNrOfBotsInWave(int32 Wave) const
+{
+	const USWaveDefinition* WaveDefinition = GetWaveDefinition(Wave);
+	return WaveDefinition != nullptr ? WaveDefinition->GetTotalBots() : 2 * Wave;
 }
 
 void ASGameMode::StartWave()
 {
 	++WaveCount;
-	NrOfBotsToSpawn = 2 * WaveCount;
+	NrOfBotsToSpawn = GetNrOfBotsInWave(WaveCount);
 
-	GetWorldTimerManager().SetTimer(TimerHandle_BotSpawner, this, &ASGameMode::SpawnBotTimerElapsed, 1.0f, true, 0.0f);
+	// Without a definition or spawn points the blueprint spawns one bot per second
+	USWaveDirectorSubsystem* Director = GetWorld()->GetSubsystem<USWaveDirectorSubsystem>();
+	if (!Director->StartDeploy(GetWaveDefinition(WaveCount)))
+	{
+		GetWorldTimerManager().SetTimer(TimerHandle_BotSpawner, this, &ASGameMode::SpawnBotTimerElapsed, 1.0f, true, 0.0f);
+	}
 
 	SetWaveState(EWaveState::WaveInProgress);
 }
@@ -52,14 +122,29 @@ void ASGameMode::StartWave()
 void ASGameMode::EndWave()
 {
 	GetWorldTimerManager().ClearTimer(TimerHandle_BotSpawner);
+	GetWorld()->GetSubsystem<USWaveDirectorSubsystem>()->StopDeploy();
 	SetWaveState(EWaveState::WaitingToComplete);
 }
 
+void ASGameMode::OnWaveDeployed()
+{
+	NrOfBotsToSpawn = 0;
+	EndWave();
+
+	// Bots may all be dead already
+	CheckWaveState();
+}
+
 void ASGameMode::PrepareForNextWave()
 {
 	GetWorldTimerManager().SetTimer(TimerHandle_NextWaveStart, this, &ASGameMode::StartWave, TimeBetweenWaves, false);
 	SetWaveState(EWaveState::WaitingToStart);
 	RestartDeadPlayers();
+
+	// Spawn the next wave's bots now so wave start doesn't pay for them
+	const USWaveDefinition* NextWave = GetWaveDefinition(WaveCount + 1);
+	USWaveDirectorSubsystem* Director = GetWorld()->GetSubsystem<USWaveDirectorSubsystem>();
+	Director->Prewarm(NextWave != nullptr ? NextWave->BotClass : PooledBotClass, GetNrOfBotsInWave(WaveCount + 1));
 }
 
 void ASGameMode::SpawnBotTimerElapsed()
@@ -70,32 +155,19 @@ void ASGameMode::SpawnBotTimerElapsed()
 	if (NrOfBotsToSpawn <= 0)
 	{
 		EndWave();
+
+		// Bots may all be dead already
+		CheckWaveState();
 	}
 }
 
 void ASGameMode::CheckWaveState()
 {
 	bool bIsPreparingForWave = GetWorldTimerManager().IsTimerActive(TimerHandle_NextWaveStart);
-	if (NrOfBotsToSpawn > 0 || bIsPreparingForWave)
+	if (NrOfBotsToSpawn > 0 || bIsPreparingForWave || IsGameOver())
 		return;
 
-	bool bIsAnyBotAlive = false;
-
-	for (FConstPawnIterator It = GetWorld()->GetPawnIterator(); It; ++It)
-	{
-		APawn* TestPawn = It->Get();
-		if (TestPawn == nullptr || TestPawn->IsPlayerControlled())
-			continue;
-
-		USHealthComponent* HealthComp = Cast<USHealthComponent>(TestPawn->GetComponentByClass(USHealthComponent::StaticClass()));
-		if (HealthComp != nullptr && HealthComp->GetHealth() > 0.0f)
-		{
-			bIsAnyBotAlive = true;
-			break;
-		}
-	}
-
-	if (!bIsAnyBotAlive)
+	if (AliveBots.Num() == 0)
 	{
 		SetWaveState(EWaveState::WaveComplete);
 		PrepareForNextWave();
@@ -105,22 +177,10 @@ void ASGameMode::CheckWaveState()
 
 void ASGameMode::CheckAnyPlayerAlive()
 {
-	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	if (AlivePlayers.Num() > 0 || IsGameOver())
 	{
-		APlayerController* PC = It->Get();
-		if (PC != nullptr)
-		{
-			APawn* MyPawn = PC->GetPawn();
-			if (MyPawn != nullptr)
-			{
-				USHealthComponent* HealthComp = Cast<USHealthComponent>(MyPawn->GetComponentByClass(USHealthComponent::StaticClass()));
-				if (HealthComp && HealthComp->GetHealth() > 0.0f)
-				{
-					// A player is still alive
-					return;
-				}
-			}
-		}
+		// A player is still alive
+		return;
 	}
 	// No player alive
 	GameOver();
@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SGrenadeDefinition.h"
+
+USGrenadeDefinition::USGrenadeDefinition()
+{
+	LaunchSpeed = 2000.0f;
+	GravityScale = 1.0f;
+	CollisionRadius = 8.0f;
+	FuseTime = 2.0f;
+	bExplodeOnImpact = false;
+	bSticky = false;
+	MaxBounces = 3;
+	Restitution = 0.4f;
+	Friction = 0.3f;
+
+	ExplosionDamage = 60.0f;
+	ExplosionRadius = 300.0f;
+	ImpulseStrength = 800.0f;
+
+	SubmunitionDefinition = nullptr;
+	NumSubmunitions = 0;
+	SubmunitionSpeed = 600.0f;
+
+	Mesh = nullptr;
+	MeshScale = 1.0f;
+	ExplosionEffect = nullptr;
+	ExplosionSound = nullptr;
+}
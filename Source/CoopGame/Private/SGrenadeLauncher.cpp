@@ -1,10 +1,244 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "..\Public\SGrenadeLauncher.h"
+#include "SGrenadeDefinition.h"
+#include "Subsystems/SProjectileSubsystem.h"
+#include "GameFramework/GameStateBase.h"
+#include "Engine/NetDriver.h"
+#include "EngineUtils.h"
+#include "TimerManager.h"
 
-ASGrenadeLauncher::ASGrenadeLauncher()
+static float GrenadeMaxOriginError = 200.0f;
+FAutoConsoleVariableRef CVARGrenadeMaxOriginError(
+	TEXT("COOP.GrenadeMaxOriginError"),
+	GrenadeMaxOriginError,
+	TEXT("Distance in cm a client grenade may start from the server muzzle before the server launches it from its own muzzle"),
+	ECVF_Default);
+
+static float GrenadeMaxFastForward = 0.5f;
+FAutoConsoleVariableRef CVARGrenadeMaxFastForward(
+	TEXT("COOP.GrenadeMaxFastForward"),
+	GrenadeMaxFastForward,
+	TEXT("Most seconds a replicated grenade is stepped ahead to catch up with the server"),
+	ECVF_Default);
+
+static float GrenadeFireRateTolerance = 0.1f;
+FAutoConsoleVariableRef CVARGrenadeFireRateTolerance(
+	TEXT("COOP.GrenadeFireRateTolerance"),
+	GrenadeFireRateTolerance,
+	TEXT("Seconds a client grenade may arrive ahead of the fire rate, covers latency jitter bunching two launches"),
+	ECVF_Default);
+
+// Predictions the server never confirmed are dropped after this many seconds
+static const double PredictedGrenadeTimeout = 2.0;
+
+// Grenade launch arrival totals since the last COOP.GrenadeNetReport
+static uint64 GrenadeNetConfirms = 0;
+static double GrenadeNetConfirmSeconds = 0.0;
+static double GrenadeNetWorstConfirmSeconds = 0.0;
+static uint64 GrenadeNetCorrections = 0;
+static double GrenadeNetCorrectionError = 0.0;
+static uint64 GrenadeNetRejectedLaunches = 0;
+static uint64 GrenadeNetRemoteLaunches = 0;
+static double GrenadeNetRemoteAgeSeconds = 0.0;
+static double GrenadeNetWorstRemoteAgeSeconds = 0.0;
+
+static FAutoConsoleCommand GrenadeNetReportCmd(
+	TEXT("COOP.GrenadeNetReport"),
+	TEXT("Logs how long grenade launches took to arrive since the last report, then resets the counters. ")
+	TEXT("Run with Net PktLag=150, COOP.GrenadeNetBenchmark measures the bytes sent"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		// Without prediction the firing client would see its grenade only after the confirm round trip
+		UE_LOG(LogTemp, Log, TEXT("Grenade net: %llu own launches confirmed after %.1f ms avg / %.1f ms worst, shown at once by prediction. %llu corrected, %.1f cm avg origin error"),
+			GrenadeNetConfirms, GrenadeNetConfirms > 0 ? GrenadeNetConfirmSeconds * 1000.0 / GrenadeNetConfirms : 0.0, GrenadeNetWorstConfirmSeconds * 1000.0,
+			GrenadeNetCorrections, GrenadeNetCorrections > 0 ? GrenadeNetCorrectionError / GrenadeNetCorrections : 0.0);
+
+		UE_LOG(LogTemp, Log, TEXT("Grenade net: %llu client launches rejected by the server for ammo, fire rate or fire type"), GrenadeNetRejectedLaunches);
+
+		UE_LOG(LogTemp, Log, TEXT("Grenade net: %llu remote launches arrived %.1f ms avg / %.1f ms worst after the server launch and were stepped ahead"),
+			GrenadeNetRemoteLaunches, GrenadeNetRemoteLaunches > 0 ? GrenadeNetRemoteAgeSeconds * 1000.0 / GrenadeNetRemoteLaunches : 0.0,
+			GrenadeNetWorstRemoteAgeSeconds * 1000.0);
+
+		GrenadeNetConfirms = 0;
+		GrenadeNetConfirmSeconds = 0.0;
+		GrenadeNetWorstConfirmSeconds = 0.0;
+		GrenadeNetCorrections = 0;
+		GrenadeNetCorrectionError = 0.0;
+		GrenadeNetRejectedLaunches = 0;
+		GrenadeNetRemoteLaunches = 0;
+		GrenadeNetRemoteAgeSeconds = 0.0;
+		GrenadeNetWorstRemoteAgeSeconds = 0.0;
+	}));
+
+// Phase 0 idles, phase 1 fires projectile actors and phase 2 simulated grenades, all from the same launcher
+static void RunGrenadeNetBenchmarkPhase(UWorld* World, TWeakObjectPtr<ASGrenadeLauncher> Launcher, int32 Phase, int32 NumGrenades, float Seconds,
+	double IdleBytesPerSecond, double ActorBytesPerGrenade, int32 OldSimulation)
+{
+	IConsoleVariable* SimulationVar = IConsoleManager::Get().FindConsoleVariable(TEXT("COOP.GrenadeSimulation"));
+	if (Phase > 0)
+		SimulationVar->Set(Phase == 2 ? 1 : 0);
+
+	UNetDriver* NetDriver = World->GetNetDriver();
+	uint64 StartBytes = NetDriver->OutTotalBytes;
+	double StartTime = FPlatformTime::Seconds();
+
+	TWeakObjectPtr<UWorld> WeakWorld = World;
+	FTimerHandle TimerHandle;
+
+	// Fire the burst in the first half so every grenade lands within the phase
+	if (Phase > 0)
+	{
+		TSharedRef<FTimerHandle> FireTimerHandle = MakeShared<FTimerHandle>();
+		int32 NumFired = 0;
+		World->GetTimerManager().SetTimer(*FireTimerHandle, FTimerDelegate::CreateLambda([=]() mutable
+		{
+			UWorld* BenchmarkWorld = WeakWorld.Get();
+			if (BenchmarkWorld == nullptr)
+				return;
+
+			if (Launcher.IsValid() && NumFired < NumGrenades)
+				Launcher->FireBenchmarkGrenade();
+
+			if (!Launcher.IsValid() || ++NumFired >= NumGrenades)
+				BenchmarkWorld->GetTimerManager().ClearTimer(*FireTimerHandle);
+		}), Seconds * 0.5f / NumGrenades, true, 0.0f);
+	}
+
+	World->GetTimerManager().SetTimer(TimerHandle, FTimerDelegate::CreateLambda([=]()
+	{
+		UWorld* BenchmarkWorld = WeakWorld.Get();
+		UNetDriver* BenchmarkNetDriver = BenchmarkWorld != nullptr ? BenchmarkWorld->GetNetDriver() : nullptr;
+		if (BenchmarkNetDriver == nullptr)
+		{
+			SimulationVar->Set(OldSimulation);
+			return;
+		}
+
+		double Elapsed = FMath::Max(FPlatformTime::Seconds() - StartTime, 0.001);
+		double BytesPerSecond = (BenchmarkNetDriver->OutTotalBytes - StartBytes) / Elapsed;
+		int32 NumConnections = FMath::Max(BenchmarkNetDriver->ClientConnections.Num(), 1);
+
+		// Bytes the burst added over idling, per grenade and connection
+		double BytesPerGrenade = (BytesPerSecond - IdleBytesPerSecond) * Elapsed / NumGrenades / NumConnections;
+
+		if (Phase == 0)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Grenade net benchmark, idle: %.1f KB/s per connection"), BytesPerSecond / 1024.0 / NumConnections);
+			RunGrenadeNetBenchmarkPhase(BenchmarkWorld, Launcher, 1, NumGrenades, Seconds, BytesPerSecond, 0.0, OldSimulation);
+			return;
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Grenade net benchmark, COOP.GrenadeSimulation %d: %d grenades, %.1f KB/s per connection, %.0f extra bytes per grenade per connection"),
+			Phase == 2 ? 1 : 0, NumGrenades, BytesPerSecond / 1024.0 / NumConnections, BytesPerGrenade);
+
+		if (Phase == 1)
+		{
+			RunGrenadeNetBenchmarkPhase(BenchmarkWorld, Launcher, 2, NumGrenades, Seconds, IdleBytesPerSecond, BytesPerGrenade, OldSimulation);
+			return;
+		}
+
+		SimulationVar->Set(OldSimulation);
+
+		UE_LOG(LogTemp, Log, TEXT("Grenade net benchmark: simulated grenades send %.0f bytes per grenade per connection against %.0f for projectile actors"),
+			BytesPerGrenade, ActorBytesPerGrenade);
+	}), Seconds, false);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GrenadeNetBenchmarkCmd(
+	TEXT("COOP.GrenadeNetBenchmark"),
+	TEXT("Logs bytes sent per connection while idle, then while the first grenade launcher held by a player fires a burst with COOP.GrenadeSimulation 0 and 1, and the extra bytes per grenade. ")
+	TEXT("Run it on the server with the clients connected. Usage: COOP.GrenadeNetBenchmark [NumGrenades=20] [SecondsPerPhase=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr || World->GetNetDriver() == nullptr || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Grenade net benchmark: run it on a server"));
+			return;
+		}
+
+		ASGrenadeLauncher* Launcher = nullptr;
+		for (TActorIterator<ASGrenadeLauncher> It(World); It; ++It)
+		{
+			if (It->GetOwner() != nullptr)
+			{
+				Launcher = *It;
+				break;
+			}
+		}
+		if (Launcher == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Grenade net benchmark: nobody holds a grenade launcher"));
+			return;
+		}
+
+		int32 NumGrenades = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20;
+		float Seconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+		int32 OldSimulation = USProjectileSubsystem::IsSimulationEnabled() ? 1 : 0;
+		RunGrenadeNetBenchmarkPhase(World, Launcher, 0, FMath::Max(NumGrenades, 1), FMath::Max(Seconds, 1.0f), 0.0, 0.0, OldSimulation);
+	}));
+
+// Origins are sent in cm with 21 bits per axis
+static const int32 GrenadeOriginMax = (1 << 20) - 1;
+
+// Fire types are sent with 3 bits
+static const uint32 GrenadeFireTypeMax = 8;
+
+void FSGrenadeLaunch::SetOrigin(const FVector& Location)
+{
+	OriginX = FMath::Clamp(FMath::RoundToInt(Location.X), -GrenadeOriginMax, GrenadeOriginMax);
+	OriginY = FMath::Clamp(FMath::RoundToInt(Location.Y), -GrenadeOriginMax, GrenadeOriginMax);
+	OriginZ = FMath::Clamp(FMath::RoundToInt(Location.Z), -GrenadeOriginMax, GrenadeOriginMax);
+}
+
+void FSGrenadeLaunch::SetVelocity(const FVector& Velocity)
 {
+	FRotator Rotation = Velocity.Rotation();
+	Pitch = FRotator::CompressAxisToShort(Rotation.Pitch);
+	Yaw = FRotator::CompressAxisToShort(Rotation.Yaw);
+	Speed = (uint16)FMath::Clamp(FMath::RoundToInt(Velocity.Size()), 0, (int32)MAX_uint16);
+}
+
+FVector FSGrenadeLaunch::GetVelocity() const
+{
+	FRotator Rotation(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), 0.0f);
+	return Rotation.Vector() * Speed;
+}
+
+bool FSGrenadeLaunch::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar << ShotId;
+
+	uint32 Type = FireType;
+	Ar.SerializeInt(Type, GrenadeFireTypeMax);
+
+	uint32 X = OriginX + GrenadeOriginMax + 1;
+	uint32 Y = OriginY + GrenadeOriginMax + 1;
+	uint32 Z = OriginZ + GrenadeOriginMax + 1;
+	Ar.SerializeInt(X, (GrenadeOriginMax + 1) * 2);
+	Ar.SerializeInt(Y, (GrenadeOriginMax + 1) * 2);
+	Ar.SerializeInt(Z, (GrenadeOriginMax + 1) * 2);
+
+	Ar << Pitch;
+	Ar << Yaw;
+	Ar << Speed;
+	Ar << ServerTime;
+
+	if (Ar.IsLoading())
+	{
+		FireType = (uint8)Type;
+		OriginX = (int32)X - GrenadeOriginMax - 1;
+		OriginY = (int32)Y - GrenadeOriginMax - 1;
+		OriginZ = (int32)Z - GrenadeOriginMax - 1;
+	}
 
+	bOutSuccess = true;
+	return true;
+}
+
+ASGrenadeLauncher::ASGrenadeLauncher()
+{
+	NextShotId = 1;
 }
 
 void ASGrenadeLauncher::BeginPlay()
@@ -14,7 +248,7 @@ void ASGrenadeLauncher::BeginPlay()
 	RateOfFire = 100;
 	TimeBetweenShots = 60 / RateOfFire;
 
-	MaxFireTypes = ProjectileClasses.Num() - 1;
+	MaxFireTypes = FMath::Max(ProjectileClasses.Num(), GrenadeDefinitions.Num()) - 1;
 	FireType = 0;
 
 	MaxAmmo = 5;
@@ -28,30 +262,97 @@ void ASGrenadeLauncher::StartFire()
 		Fire();
 }
 
+void ASGrenadeLauncher::FireBenchmarkGrenade()
+{
+	if (GetLocalRole() < ROLE_Authority)
+		return;
+
+	CurrentAmmo = MaxAmmo;
+	Fire();
+}
+
 void ASGrenadeLauncher::ToggleFireType()
 {
 	CurrentAmmo = 0;
 	Super::ToggleFireType();
+
+	if (GetLocalRole() < ROLE_Authority)
+		ServerSetFireType(FireType);
+}
+
+void ASGrenadeLauncher::ServerSetFireType_Implementation(uint8 NewFireType)
+{
+	CurrentAmmo = 0;
+	FireType = NewFireType;
+}
+
+bool ASGrenadeLauncher::ServerSetFireType_Validate(uint8 NewFireType)
+{
+	return NewFireType <= MaxFireTypes;
 }
 
 void ASGrenadeLauncher::Fire()
 {
 	if (CurrentAmmo <= 0) return;
 
-	// Networking
-	if (Role < ROLE_Authority)
-	{
-		ServerFire();
-	}
-
 	// Stop reload
 	if (bIsReloading)
 		StopReload();
 
 	AActor* MyOwner = GetOwner();
-	TSubclassOf<AActor> ProjectileClass = ProjectileClasses[FireType];
-	if (MyOwner != nullptr && ProjectileClass != nullptr)
+	const USGrenadeDefinition* GrenadeDefinition = USProjectileSubsystem::IsSimulationEnabled() ? GetGrenadeDefinition(FireType) : nullptr;
+	TSubclassOf<AActor> ProjectileClass = ProjectileClasses.IsValidIndex(FireType) ? ProjectileClasses[FireType] : nullptr;
+	if (MyOwner != nullptr && GrenadeDefinition != nullptr)
+	{
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+
+		FSGrenadeLaunch Launch;
+		Launch.ShotId = NextShotId;
+		Launch.FireType = (uint8)FireType;
+		Launch.SetOrigin(MeshComp->GetSocketLocation(MuzzleSocketName));
+		Launch.SetVelocity(EyeRotation.Vector() * GrenadeDefinition->LaunchSpeed);
+		Launch.ServerTime = GetServerWorldTime();
+
+		NextShotId = NextShotId == MAX_uint16 ? 1 : NextShotId + 1;
+
+		// Launched from the quantized record so every machine starts the grenade the same way
+		LaunchGrenade(Launch, 0.0f);
+
+		// Networking
+		if (GetLocalRole() < ROLE_Authority)
+		{
+			double Now = FPlatformTime::Seconds();
+			for (auto It = PredictedGrenades.CreateIterator(); It; ++It)
+			{
+				if (Now - It.Value().FireTime > PredictedGrenadeTimeout)
+					It.RemoveCurrent();
+			}
+
+			FSPredictedGrenade& Predicted = PredictedGrenades.Add(Launch.ShotId);
+			Predicted.Launch = Launch;
+			Predicted.FireTime = Now;
+
+			ServerFireGrenade(Launch);
+		}
+		else
+		{
+			MulticastGrenadeLaunched(Launch);
+		}
+
+		LastFireTime = GetWorld()->TimeSeconds;
+
+		--CurrentAmmo;
+	}
+	else if (MyOwner != nullptr && ProjectileClass != nullptr)
 	{
+		// Networking
+		if (GetLocalRole() < ROLE_Authority)
+		{
+			ServerFireProjectile();
+		}
+
 		FVector EyeLocation;
 		FRotator EyeRotation;
 		MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
@@ -72,6 +373,119 @@ void ASGrenadeLauncher::Fire()
 	}
 }
 
+void ASGrenadeLauncher::ServerFireProjectile_Implementation()
+{
+	Fire();
+}
+
+bool ASGrenadeLauncher::ServerFireProjectile_Validate()
+{
+	return true;
+}
+
+void ASGrenadeLauncher::ServerFireGrenade_Implementation(FSGrenadeLaunch Launch)
+{
+	// The server's fire type and simulation setting pick the grenade, the client's prediction expires if they disagree
+	const USGrenadeDefinition* GrenadeDefinition = USProjectileSubsystem::IsSimulationEnabled() ? GetGrenadeDefinition(FireType) : nullptr;
+	if (CurrentAmmo <= 0 || GrenadeDefinition == nullptr || Launch.FireType != FireType)
+	{
+		++GrenadeNetRejectedLaunches;
+		return;
+	}
+
+	if (GetWorld()->TimeSeconds < LastFireTime + TimeBetweenShots - GrenadeFireRateTolerance)
+	{
+		++GrenadeNetRejectedLaunches;
+		return;
+	}
+
+	if (bIsReloading)
+		StopReload();
+
+	// The client picks the direction, the server its muzzle and the grenade speed
+	FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+	if (FVector::DistSquared(Launch.GetOrigin(), MuzzleLocation) > FMath::Square(GrenadeMaxOriginError))
+		Launch.SetOrigin(MuzzleLocation);
+
+	Launch.SetVelocity(Launch.GetVelocity().GetSafeNormal() * GrenadeDefinition->LaunchSpeed);
+	Launch.ServerTime = GetServerWorldTime();
+
+	LaunchGrenade(Launch, 0.0f);
+	MulticastGrenadeLaunched(Launch);
+
+	LastFireTime = GetWorld()->TimeSeconds;
+
+	--CurrentAmmo;
+}
+
+bool ASGrenadeLauncher::ServerFireGrenade_Validate(FSGrenadeLaunch Launch)
+{
+	return Launch.ShotId != 0;
+}
+
+void ASGrenadeLauncher::MulticastGrenadeLaunched_Implementation(FSGrenadeLaunch Launch)
+{
+	if (GetLocalRole() == ROLE_Authority)
+		return;
+
+	// The client that fired predicted it already
+	APawn* MyPawn = Cast<APawn>(GetOwner());
+	if (MyPawn != nullptr && MyPawn->IsLocallyControlled())
+	{
+		ReconcileGrenade(Launch);
+		return;
+	}
+
+	// Catch up on the flight since the server launched it
+	double Age = FMath::Max(GetServerWorldTime() - Launch.ServerTime, 0.0f);
+	++GrenadeNetRemoteLaunches;
+	GrenadeNetRemoteAgeSeconds += Age;
+	GrenadeNetWorstRemoteAgeSeconds = FMath::Max(GrenadeNetWorstRemoteAgeSeconds, Age);
+
+	LaunchGrenade(Launch, FMath::Min((float)Age, GrenadeMaxFastForward));
+}
+
+void ASGrenadeLauncher::LaunchGrenade(const FSGrenadeLaunch& Launch, float FastForwardSeconds)
+{
+	// Plain data instead of an actor, the server's grenade deals the damage
+	GetWorld()->GetSubsystem<USProjectileSubsystem>()->Launch(GetGrenadeDefinition(Launch.FireType), this, Launch.GetOrigin(), Launch.GetVelocity(),
+		Launch.ShotId, FastForwardSeconds);
+}
+
+void ASGrenadeLauncher::ReconcileGrenade(const FSGrenadeLaunch& Launch)
+{
+	FSPredictedGrenade Predicted;
+	if (!PredictedGrenades.RemoveAndCopyValue(Launch.ShotId, Predicted))
+		return;
+
+	double Age = FPlatformTime::Seconds() - Predicted.FireTime;
+	++GrenadeNetConfirms;
+	GrenadeNetConfirmSeconds += Age;
+	GrenadeNetWorstConfirmSeconds = FMath::Max(GrenadeNetWorstConfirmSeconds, Age);
+
+	const FSGrenadeLaunch& Sent = Predicted.Launch;
+	if (Sent.GetOrigin() == Launch.GetOrigin() && Sent.Pitch == Launch.Pitch && Sent.Yaw == Launch.Yaw && Sent.Speed == Launch.Speed)
+		return;
+
+	// Restart the prediction from the server's launch, as far along as the predicted grenade was
+	++GrenadeNetCorrections;
+	GrenadeNetCorrectionError += FVector::Dist(Sent.GetOrigin(), Launch.GetOrigin());
+
+	GetWorld()->GetSubsystem<USProjectileSubsystem>()->CorrectLaunch(this, Launch.ShotId, GetGrenadeDefinition(Launch.FireType), Launch.GetOrigin(),
+		Launch.GetVelocity(), (float)Age);
+}
+
+float ASGrenadeLauncher::GetServerWorldTime() const
+{
+	AGameStateBase* GS = GetWorld()->GetGameState();
+	return GS != nullptr ? GS->GetServerWorldTimeSeconds() : GetWorld()->TimeSeconds;
+}
+
+const USGrenadeDefinition* ASGrenadeLauncher::GetGrenadeDefinition(int32 InFireType) const
+{
+	return GrenadeDefinitions.IsValidIndex(InFireType) ? GrenadeDefinitions[InFireType] : nullptr;
+}
+
 FText ASGrenadeLauncher::GetCurrentFireTypeName()
 {
 	switch (FireType)
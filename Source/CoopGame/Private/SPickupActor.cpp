@@ -8,6 +8,7 @@
 #include "SPowerupActor.h"
 #include "TimerManager.h"
 #include "SCharacter.h"
+#include "Components/SReplicationPolicyComponent.h"
 
 // Sets default values
 ASPickupActor::ASPickupActor()
@@ -21,6 +22,12 @@ ASPickupActor::ASPickupActor()
 	DecalComp->DecalSize = FVector(64.0f, 75.0f, 75.0f);
 	DecalComp->SetupAttachment(RootComponent);
 
+	// Nothing replicates after spawning, the pickup goes dormant
+	ReplicationPolicyComp = CreateDefaultSubobject<USReplicationPolicyComponent>(TEXT("ReplicationPolicyComp"));
+	ReplicationPolicyComp->NearNetUpdateFrequency = 10.0f;
+	ReplicationPolicyComp->FarNetUpdateFrequency = 1.0f;
+	ReplicationPolicyComp->bDormantWhenIdle = true;
+
 	CooldownDuration = 10.0f;
 
 	SetReplicates(true);
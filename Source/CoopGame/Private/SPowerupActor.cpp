@@ -3,6 +3,7 @@
 
 #include "SPowerupActor.h"
 #include "Net\UnrealNetwork.h"
+#include "Components/SReplicationPolicyComponent.h"
 
 // Sets default values
 ASPowerupActor::ASPowerupActor()
@@ -12,6 +13,12 @@ ASPowerupActor::ASPowerupActor()
 
 	SetReplicates(true);
 
+	// Dormant while waiting to be picked up and after it expired
+	ReplicationPolicyComp = CreateDefaultSubobject<USReplicationPolicyComponent>(TEXT("ReplicationPolicyComp"));
+	ReplicationPolicyComp->NearNetUpdateFrequency = 10.0f;
+	ReplicationPolicyComp->FarNetUpdateFrequency = 2.0f;
+	ReplicationPolicyComp->bDormantWhenIdle = true;
+
 	bIsPowerupActive = false;
 }
 
@@ -29,6 +36,8 @@ void ASPowerupActor::OnTickPowerup()
 		bIsPowerupActive = false;
 		OnRep_PowerupActive();
 
+		ReplicationPolicyComp->SetIdle(true);
+
 		//Delete timer
 		GetWorldTimerManager().ClearTimer(TimerHandle_PowerupTick);
 	}
@@ -41,6 +50,8 @@ void ASPowerupActor::OnRep_PowerupActive()
 
 void ASPowerupActor::ActivatePowerup(AActor* OtherActor)
 {
+	ReplicationPolicyComp->SetIdle(false);
+
 	OnActivated(OtherActor);
 
 	bIsPowerupActive = true;
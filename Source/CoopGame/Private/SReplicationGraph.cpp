@@ -0,0 +1,375 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SReplicationGraph.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/SimulatedClientNetConnection.h"
+#include "EngineUtils.h"
+#include "UObject/UObjectIterator.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/PlayerController.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "SExplosiveBarrel.h"
+#include "SPickupActor.h"
+#include "SPowerupActor.h"
+#include "AI/STrackerBot.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopRepGraph"), STATGROUP_CoopRepGraph, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Replicate Actors"), STAT_RepGraphReplicate, STATGROUP_CoopRepGraph);
+
+static float RepGraphCellSize = 10000.0f;
+FAutoConsoleVariableRef CVARRepGraphCellSize(
+	TEXT("COOP.RepGraphCellSize"),
+	RepGraphCellSize,
+	TEXT("Size in cm of the replication grid cells, read when the net driver starts"),
+	ECVF_Default);
+
+static float RepGraphSpatialBias = -150000.0f;
+FAutoConsoleVariableRef CVARRepGraphSpatialBias(
+	TEXT("COOP.RepGraphSpatialBias"),
+	RepGraphSpatialBias,
+	TEXT("Lower X and Y corner of the replication grid, read when the net driver starts"),
+	ECVF_Default);
+
+// Replication time during the first second of a phase is not measured, new connections receive every actor
+static const double RepGraphBenchmarkWarmup = 1.0;
+
+static FAutoConsoleCommandWithWorldAndArgs RepGraphBenchmarkCmd(
+	TEXT("COOP.RepGraphBenchmark"),
+	TEXT("Times replication with 4, 16 and 32 simulated client connections, run on a server with the bots deployed, e.g. -ExecCmds on a dedicated server. ")
+	TEXT("Usage: COOP.RepGraphBenchmark [SecondsPerPhase=5] [NumConnections...]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+		USReplicationGraph* Graph = NetDriver != nullptr ? Cast<USReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+		if (Graph == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Rep graph benchmark: run it on a server using the replication graph"));
+			return;
+		}
+
+		float SecondsPerPhase = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 5.0f;
+
+		TArray<int32> NumConnections;
+		for (int32 i = 1; i < Args.Num(); ++i)
+		{
+			NumConnections.Add(FMath::Max(FCString::Atoi(*Args[i]), 1));
+		}
+		if (NumConnections.Num() == 0)
+			NumConnections = { 4, 16, 32 };
+
+		Graph->RunBenchmark(NumConnections, FMath::Max(SecondsPerPhase, 1.0f));
+	}));
+
+void USReplicationGraphNode_Player::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	ReplicationActorList.Reset();
+
+	UNetConnection* Connection = Params.ConnectionManager.NetConnection;
+	APlayerController* PC = Connection != nullptr ? Connection->PlayerController : nullptr;
+	if (PC != nullptr)
+	{
+		ReplicationActorList.ConditionalAdd(PC);
+		ReplicationActorList.ConditionalAdd(Connection->ViewTarget);
+
+		APawn* Pawn = PC->GetPawn();
+		ReplicationActorList.ConditionalAdd(Pawn);
+
+		// Holstered weapons are hidden at the pawn, the owner needs them relevant to switch
+		ASCharacter* Character = Cast<ASCharacter>(Pawn);
+		if (Character != nullptr)
+		{
+			for (const FSInventorySlot& Slot : Character->GetInventory().Slots)
+			{
+				ReplicationActorList.ConditionalAdd(Slot.Weapon);
+			}
+		}
+	}
+
+	Params.OutGatheredReplicationLists.AddReplicationActorList(ReplicationActorList);
+}
+
+void USReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// Native classes of this game, blueprints and engine classes are mapped from their parents and properties
+	ClassRepNodePolicies.Add(AGameStateBase::StaticClass(), ESClassRepNodeMapping::RelevantAllConnections);
+	ClassRepNodePolicies.Add(APlayerState::StaticClass(), ESClassRepNodeMapping::RelevantAllConnections);
+	ClassRepNodePolicies.Add(APlayerController::StaticClass(), ESClassRepNodeMapping::NotRouted);
+	ClassRepNodePolicies.Add(ASCharacter::StaticClass(), ESClassRepNodeMapping::Spatialize_Dynamic);
+	ClassRepNodePolicies.Add(ASWeapon::StaticClass(), ESClassRepNodeMapping::Spatialize_Dynamic);
+	ClassRepNodePolicies.Add(ASTrackerBot::StaticClass(), ESClassRepNodeMapping::Spatialize_Dynamic);
+	ClassRepNodePolicies.Add(ASExplosiveBarrel::StaticClass(), ESClassRepNodeMapping::Spatialize_Dormancy);
+	ClassRepNodePolicies.Add(ASPowerupActor::StaticClass(), ESClassRepNodeMapping::Spatialize_Dormancy);
+	ClassRepNodePolicies.Add(ASPickupActor::StaticClass(), ESClassRepNodeMapping::Spatialize_Static);
+
+	// Replication rate and cull distance of every replicated class come from its defaults
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+		if (ActorCDO == nullptr || !ActorCDO->GetIsReplicated())
+			continue;
+
+		// Leftovers of blueprint compiles
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+			continue;
+
+		ESClassRepNodeMapping Mapping = GetMappingPolicy(Class);
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrame(ActorCDO->NetUpdateFrequency);
+		if (Mapping != ESClassRepNodeMapping::NotRouted && Mapping != ESClassRepNodeMapping::RelevantAllConnections)
+			ClassInfo.CullDistanceSquared = ActorCDO->NetCullDistanceSquared;
+
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void USReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = RepGraphCellSize;
+	GridNode->SpatialBias = FVector2D(RepGraphSpatialBias, RepGraphSpatialBias);
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void USReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	USReplicationGraphNode_Player* PlayerNode = CreateNewNode<USReplicationGraphNode_Player>();
+	AddConnectionGraphNode(PlayerNode, RepGraphConnection);
+}
+
+void USReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case ESClassRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Static:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+void USReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case ESClassRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Static:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	case ESClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+ESClassRepNodeMapping USReplicationGraph::GetMappingPolicy(UClass* Class)
+{
+	const ESClassRepNodeMapping* Found = ClassRepNodePolicies.Find(Class);
+	if (Found != nullptr)
+		return *Found;
+
+	// Closest parent with a mapping of its own
+	ESClassRepNodeMapping Mapping;
+	UClass* Parent = Class->GetSuperClass();
+	while (Parent != nullptr && !ClassRepNodePolicies.Contains(Parent))
+	{
+		Parent = Parent->GetSuperClass();
+	}
+
+	const AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+	if (Parent != nullptr)
+	{
+		Mapping = ClassRepNodePolicies[Parent];
+	}
+	else if (ActorCDO == nullptr || ActorCDO->bOnlyRelevantToOwner)
+	{
+		Mapping = ESClassRepNodeMapping::NotRouted;
+	}
+	else if (ActorCDO->bAlwaysRelevant)
+	{
+		Mapping = ESClassRepNodeMapping::RelevantAllConnections;
+	}
+	else
+	{
+		Mapping = ActorCDO->IsReplicatingMovement() ? ESClassRepNodeMapping::Spatialize_Dynamic : ESClassRepNodeMapping::Spatialize_Static;
+	}
+
+	ClassRepNodePolicies.Add(Class, Mapping);
+	return Mapping;
+}
+
+uint32 USReplicationGraph::GetReplicationPeriodFrame(float NetUpdateFrequency) const
+{
+	return FMath::Max<uint32>(FMath::RoundToInt(NetDriver->NetServerMaxTickRate / FMath::Max(NetUpdateFrequency, 1.0f)), 1);
+}
+
+void USReplicationGraph::SetActorReplicationRate(AActor* Actor, float NetUpdateFrequency, float PriorityScale)
+{
+	FGlobalActorReplicationInfo* GlobalInfo = GlobalActorReplicationInfoMap.Find(Actor);
+	if (GlobalInfo == nullptr)
+		return;
+
+	// Lower accumulated priority replicates first
+	uint32 PeriodFrame = GetReplicationPeriodFrame(NetUpdateFrequency);
+	float DistancePriorityScale = GlobalActorReplicationInfoMap.GetClassInfo(Actor->GetClass()).DistancePriorityScale / FMath::Max(PriorityScale, 1.0f);
+	if (GlobalInfo->Settings.ReplicationPeriodFrame == PeriodFrame && GlobalInfo->Settings.DistancePriorityScale == DistancePriorityScale)
+		return;
+
+	GlobalInfo->Settings.ReplicationPeriodFrame = PeriodFrame;
+	GlobalInfo->Settings.DistancePriorityScale = DistancePriorityScale;
+
+	// Connections copied the period when they first saw the actor
+	for (UNetReplicationGraphConnection* Connection : Connections)
+	{
+		FConnectionReplicationActorInfo* ConnectionInfo = Connection->ActorInfoMap.Find(Actor);
+		if (ConnectionInfo != nullptr)
+			ConnectionInfo->ReplicationPeriodFrame = PeriodFrame;
+	}
+}
+
+int32 USReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	double StartTime = FPlatformTime::Seconds();
+
+	int32 NumReplicated;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_RepGraphReplicate);
+		NumReplicated = Super::ServerReplicateActors(DeltaSeconds);
+	}
+
+	double Now = FPlatformTime::Seconds();
+	double Seconds = Now - StartTime;
+	TotalReplicateSeconds += Seconds;
+
+	if (BenchmarkPhase == INDEX_NONE || Now - BenchmarkPhaseStartTime < RepGraphBenchmarkWarmup)
+		return NumReplicated;
+
+	++BenchmarkFrames;
+	BenchmarkSeconds += Seconds;
+	BenchmarkWorstSeconds = FMath::Max(BenchmarkWorstSeconds, Seconds);
+
+	if (Now - BenchmarkPhaseStartTime < RepGraphBenchmarkWarmup + BenchmarkPhaseSeconds)
+		return NumReplicated;
+
+	int32 NumSimulated = SimulatedConnections.Num();
+	int32 Frames = FMath::Max(BenchmarkFrames, 1);
+	UE_LOG(LogTemp, Log, TEXT("Rep graph benchmark: %d simulated + %d real connections, %d frames, replication %.3f ms avg / %.3f ms worst, %.4f ms per connection"),
+		NumSimulated, NetDriver->ClientConnections.Num() - NumSimulated, BenchmarkFrames, BenchmarkSeconds * 1000.0 / Frames,
+		BenchmarkWorstSeconds * 1000.0, BenchmarkSeconds * 1000.0 / Frames / FMath::Max(NetDriver->ClientConnections.Num(), 1));
+
+	if (BenchmarkPhase + 1 < BenchmarkConnectionCounts.Num())
+	{
+		StartBenchmarkPhase(BenchmarkPhase + 1);
+	}
+	else
+	{
+		BenchmarkPhase = INDEX_NONE;
+		SetNumSimulatedConnections(0);
+	}
+
+	return NumReplicated;
+}
+
+void USReplicationGraph::RunBenchmark(const TArray<int32>& NumConnections, float SecondsPerPhase)
+{
+	if (BenchmarkPhase != INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Rep graph benchmark: still running"));
+		return;
+	}
+
+	int32 NumActors = 0;
+	for (FActorIterator It(GetWorld()); It; ++It)
+	{
+		NumActors += It->GetIsReplicated() ? 1 : 0;
+	}
+	UE_LOG(LogTemp, Log, TEXT("Rep graph benchmark: %d replicated actors, %.0f s per phase"), NumActors, SecondsPerPhase);
+
+	BenchmarkConnectionCounts = NumConnections;
+	BenchmarkPhaseSeconds = SecondsPerPhase;
+	StartBenchmarkPhase(0);
+}
+
+void USReplicationGraph::StartBenchmarkPhase(int32 Phase)
+{
+	BenchmarkPhase = Phase;
+	BenchmarkPhaseStartTime = FPlatformTime::Seconds();
+	BenchmarkFrames = 0;
+	BenchmarkSeconds = 0.0;
+	BenchmarkWorstSeconds = 0.0;
+
+	SetNumSimulatedConnections(BenchmarkConnectionCounts[Phase]);
+}
+
+void USReplicationGraph::SetNumSimulatedConnections(int32 NumConnections)
+{
+	UWorld* World = GetWorld();
+
+	while (SimulatedConnections.Num() > NumConnections)
+	{
+		// Destroys the player controller and removes the connection from the net driver
+		UNetConnection* Connection = SimulatedConnections.Pop();
+		if (Connection != nullptr)
+			Connection->CleanUp();
+	}
+
+	if (SimulatedConnections.Num() >= NumConnections)
+		return;
+
+	// Viewers are spread over the bots and barrels, like players fighting all over the level
+	TArray<FVector> ViewLocations;
+	for (TActorIterator<ASTrackerBot> It(World); It; ++It)
+	{
+		ViewLocations.Add(It->GetActorLocation());
+	}
+	for (TActorIterator<ASExplosiveBarrel> It(World); It; ++It)
+	{
+		ViewLocations.Add(It->GetActorLocation());
+	}
+	if (ViewLocations.Num() == 0)
+		ViewLocations.Add(FVector::ZeroVector);
+
+	FRandomStream Stream(SimulatedConnections.Num());
+	while (SimulatedConnections.Num() < NumConnections)
+	{
+		USimulatedClientNetConnection* Connection = NewObject<USimulatedClientNetConnection>();
+		Connection->InitConnection(NetDriver, USOCK_Open, World->URL, 1000000);
+		Connection->InitSendBuffer();
+		NetDriver->AddClientConnection(Connection);
+
+		FVector ViewLocation = ViewLocations[Stream.RandHelper(ViewLocations.Num())] + FVector(0.0f, 0.0f, 200.0f);
+		APlayerController* PC = World->SpawnActor<APlayerController>(ViewLocation, FRotator::ZeroRotator);
+		PC->SetPlayer(Connection);
+
+		SimulatedConnections.Add(Connection);
+	}
+}
@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SWaveDefinition.h"
+#include "Curves/CurveFloat.h"
+#include "AI/STrackerBot.h"
+
+USWaveDefinition::USWaveDefinition()
+{
+	NumBots = 10;
+	SpawnRate = 1.0f;
+	SpawnRateCurve = nullptr;
+	SpawnRadius = 200.0f;
+}
+
+int32 USWaveDefinition::GetTotalBots() const
+{
+	int32 TotalBots = FMath::Max(NumBots, 0);
+	for (const FSWaveBurst& Burst : Bursts)
+	{
+		TotalBots += FMath::Max(Burst.NumBots, 0);
+	}
+	return TotalBots;
+}
+
+float USWaveDefinition::GetSpawnRate(float WaveTime) const
+{
+	float Multiplier = SpawnRateCurve != nullptr ? SpawnRateCurve->GetFloatValue(WaveTime) : 1.0f;
+	return FMath::Max(SpawnRate * Multiplier, 0.0f);
+}
@@ -14,6 +14,15 @@
 #include "TimerManager.h"
 #include "Net\UnrealNetwork.h"
 #include "Sound\SoundCue.h"
+#include "Subsystems/SHitScanSubsystem.h"
+#include "Subsystems/SLagCompensationSubsystem.h"
+#include "GameFramework/GameStateBase.h"
+#include "Subsystems/SFXPoolSubsystem.h"
+#include "Subsystems/SAudioPoolSubsystem.h"
+#include "SCosmetics.h"
+#include "Components/SReplicationPolicyComponent.h"
+#include "Engine/NetConnection.h"
+#include "Serialization/BitWriter.h"
 
 static int32 DebugWeaponDrawing = 0;
 FAutoConsoleVariableRef CVARDebugWeaponDrawing(
@@ -22,12 +31,156 @@ FAutoConsoleVariableRef CVARDebugWeaponDrawing(
 	TEXT("Draw Debug Lines for Weapons"),
 	ECVF_Cheat);
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Burst Bits Sent"), STAT_HitScanBurstBitsSent, STATGROUP_CoopHitScan);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Burst Shots Sent"), STAT_HitScanBurstShotsSent, STATGROUP_CoopHitScan);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Burst Shots Lost"), STAT_HitScanBurstShotsLost, STATGROUP_CoopHitScan);
+
+// Hitscan replication totals since the last COOP.HitScanNetReport
+static uint64 HitScanNetBitsSent = 0;
+static uint64 HitScanNetShotsSent = 0;
+static uint64 HitScanNetUpdatesSent = 0;
+static uint64 HitScanNetShotsFired = 0;
+static uint64 HitScanNetLegacyBits = 0;
+static double HitScanNetReportStartTime = 0.0;
+
+// Bits the replaced FHitScanTrace (FVector_NetQuantize TraceTo and a surface byte) needed for the same shot
+static int64 GetLegacyHitScanTraceBits(const FVector& TraceTo)
+{
+	FBitWriter Writer(0, true);
+	FVector_NetQuantize LegacyTraceTo(TraceTo);
+	bool bSuccess;
+	LegacyTraceTo.NetSerialize(Writer, nullptr, bSuccess);
+
+	uint8 SurfaceType = 0;
+	Writer << SurfaceType;
+	return Writer.GetNumBits();
+}
+
+static FAutoConsoleCommand HitScanNetReportCmd(
+	TEXT("COOP.HitScanNetReport"),
+	TEXT("Logs the bits spent replicating hitscan shots since the last report and resets the counters"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		double Now = FPlatformTime::Seconds();
+		double Elapsed = HitScanNetReportStartTime > 0.0 ? Now - HitScanNetReportStartTime : 0.0;
+
+		// Per fired shot, the resent window included. The old struct went out once per shot, when it wasn't dropped
+		double BitsPerShot = HitScanNetShotsFired > 0 ? (double)HitScanNetBitsSent / HitScanNetShotsFired : 0.0;
+		double LegacyBitsPerShot = HitScanNetShotsFired > 0 ? (double)HitScanNetLegacyBits / HitScanNetShotsFired : 0.0;
+		UE_LOG(LogTemp, Log, TEXT("HitScan net: %llu shots fired, %llu bits in %llu updates carrying %llu shots over %.1f s (%.1f bits/s)"),
+			HitScanNetShotsFired, HitScanNetBitsSent, HitScanNetUpdatesSent, HitScanNetShotsSent, Elapsed, Elapsed > 0.0 ? HitScanNetBitsSent / Elapsed : 0.0);
+		UE_LOG(LogTemp, Log, TEXT("HitScan net at 600 RPM per weapon: burst %.1f bits per shot, %.0f bits/s, old FHitScanTrace %.1f bits per shot, %.0f bits/s"),
+			BitsPerShot, BitsPerShot * 10.0, LegacyBitsPerShot, LegacyBitsPerShot * 10.0);
+
+		HitScanNetBitsSent = 0;
+		HitScanNetShotsSent = 0;
+		HitScanNetUpdatesSent = 0;
+		HitScanNetShotsFired = 0;
+		HitScanNetLegacyBits = 0;
+		HitScanNetReportStartTime = Now;
+	}));
+
+// Offsets are sent in cm with 15 bits per axis
+static const int32 HitScanOffsetMax = 16383;
+
+void FHitScanTrace::SetTraceTo(const FVector& MuzzleLocation, const FVector& TraceTo)
+{
+	FVector Offset = TraceTo - MuzzleLocation;
+	OffsetX = (int16)FMath::Clamp(FMath::RoundToInt(Offset.X), -HitScanOffsetMax, HitScanOffsetMax);
+	OffsetY = (int16)FMath::Clamp(FMath::RoundToInt(Offset.Y), -HitScanOffsetMax, HitScanOffsetMax);
+	OffsetZ = (int16)FMath::Clamp(FMath::RoundToInt(Offset.Z), -HitScanOffsetMax, HitScanOffsetMax);
+}
+
+FVector FHitScanTrace::GetTraceTo(const FVector& MuzzleLocation) const
+{
+	return MuzzleLocation + FVector(OffsetX, OffsetY, OffsetZ);
+}
+
+void FHitScanTraceBurst::AddShot(const FVector& MuzzleLocation, const FVector& TraceTo, EPhysicalSurface SurfaceType, bool bBlockingHit)
+{
+	FHitScanTrace& Shot = Shots[ShotCounter % MaxShots];
+	Shot.SetTraceTo(MuzzleLocation, TraceTo);
+	Shot.SurfaceType = SurfaceType;
+	Shot.bBlockingHit = bBlockingHit;
+
+	++ShotCounter;
+
+	++HitScanNetShotsFired;
+	HitScanNetLegacyBits += GetLegacyHitScanTraceBits(TraceTo);
+}
+
+void FHitScanTraceBurst::BeginNetUpdate()
+{
+	uint16 OldestCounter = NetUpdateCounters[NextNetUpdate];
+	NetUpdateCounters[NextNetUpdate] = ShotCounter;
+	NextNetUpdate = (NextNetUpdate + 1) % NetUpdateWindow;
+
+	NumShots = (uint8)FMath::Min<int32>((uint16)(ShotCounter - OldestCounter), MaxShots);
+}
+
+bool FHitScanTraceBurst::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar << ShotCounter;
+
+	uint32 Count = NumShots;
+	Ar.SerializeInt(Count, MaxShots + 1);
+	NumShots = (uint8)FMath::Min<uint32>(Count, MaxShots);
+
+	for (int32 Age = 0; Age < NumShots; ++Age)
+	{
+		FHitScanTrace& Shot = Shots[(uint16)(ShotCounter - 1 - Age) % MaxShots];
+
+		uint32 X = Shot.OffsetX + HitScanOffsetMax + 1;
+		uint32 Y = Shot.OffsetY + HitScanOffsetMax + 1;
+		uint32 Z = Shot.OffsetZ + HitScanOffsetMax + 1;
+		uint32 Surface = Shot.SurfaceType;
+		uint8 bHit = Shot.bBlockingHit ? 1 : 0;
+
+		Ar.SerializeInt(X, (HitScanOffsetMax + 1) * 2);
+		Ar.SerializeInt(Y, (HitScanOffsetMax + 1) * 2);
+		Ar.SerializeInt(Z, (HitScanOffsetMax + 1) * 2);
+		Ar.SerializeInt(Surface, SurfaceType_Max + 1);
+		Ar.SerializeBits(&bHit, 1);
+
+		if (Ar.IsLoading())
+		{
+			Shot.OffsetX = (int16)((int32)X - HitScanOffsetMax - 1);
+			Shot.OffsetY = (int16)((int32)Y - HitScanOffsetMax - 1);
+			Shot.OffsetZ = (int16)((int32)Z - HitScanOffsetMax - 1);
+			Shot.SurfaceType = (uint8)Surface;
+			Shot.bBlockingHit = bHit != 0;
+		}
+	}
+
+	if (Ar.IsSaving())
+	{
+		// 16 bit counter, 4 bit count, 3x15 bit offset, 6 bit surface and hit flag per shot
+		uint32 Bits = 20 + NumShots * 52;
+		HitScanNetBitsSent += Bits;
+		HitScanNetShotsSent += NumShots;
+		++HitScanNetUpdatesSent;
+
+		INC_DWORD_STAT_BY(STAT_HitScanBurstBitsSent, Bits);
+		INC_DWORD_STAT_BY(STAT_HitScanBurstShotsSent, NumShots);
+	}
+
+	bOutSuccess = true;
+	return true;
+}
+
 // Sets default values
 ASWeapon::ASWeapon()
 {
 	MeshComp = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("MeshComp"));
 	RootComponent = MeshComp;
 
+	// Holstered weapons go dormant, a drawn weapon keeps its rate at any distance
+	ReplicationPolicyComp = CreateDefaultSubobject<USReplicationPolicyComponent>(TEXT("ReplicationPolicyComp"));
+	ReplicationPolicyComp->NearNetUpdateFrequency = 66.0f;
+	ReplicationPolicyComp->FarNetUpdateFrequency = 66.0f;
+	ReplicationPolicyComp->bDormantWhenIdle = true;
+	ReplicationPolicyComp->IdleDelay = 1.0f;
+
 	MuzzleSocketName = "MuzzleSocket";
 	TracerTargetName = "Target";
 
@@ -61,6 +214,13 @@ ASWeapon::ASWeapon()
 	bExplosiveBullets = false;
 	bInAimingMode = false;
 
+	MaxShotOriginError = 200.0f;
+
+	FXPoolPrewarmCount = 4;
+
+	LastReplayedShotCounter = 0;
+	bReplayedHitScanTrace = false;
+
 	// Set this pawn to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 }
@@ -70,6 +230,25 @@ void ASWeapon::BeginPlay()
 	Super::BeginPlay();
 
 	TimeBetweenShots = 60 / RateOfFire;
+
+	// Allocate the effect components up front instead of during sustained fire
+	USFXPoolSubsystem* FXPool = GetWorld()->GetSubsystem<USFXPoolSubsystem>();
+	if (FXPool != nullptr)
+	{
+		FXPool->Prewarm(MuzzleEffect, FXPoolPrewarmCount);
+		FXPool->Prewarm(TracerEffect, FXPoolPrewarmCount);
+		FXPool->Prewarm(DefaultImpactEffect, FXPoolPrewarmCount);
+		FXPool->Prewarm(FleshImpactEffect, FXPoolPrewarmCount);
+		FXPool->Prewarm(ExplosionEffect, FXPoolPrewarmCount);
+	}
+}
+
+void ASWeapon::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Pooled sounds outlive the weapon, don't leave the fire loop playing
+	FireAC.Stop();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ASWeapon::StartFire()
@@ -87,7 +266,7 @@ void ASWeapon::StartFire()
 		GetWorldTimerManager().SetTimer(TimerHandle_TimeBetweenShots, this, &ASWeapon::Fire, TimeBetweenShots, true, FirstDelay);
 
 		// Play looped fire sound
-		if (FireAC == NULL && CurrentAmmo > 0)
+		if (!FireAC.IsPlaying() && CurrentAmmo > 0)
 		{
 			FireAC = PlayWeaponSound(LoopedFireSound);
 		}
@@ -106,13 +285,13 @@ void ASWeapon::StopFire()
 {
 	GetWorldTimerManager().ClearTimer(TimerHandle_TimeBetweenShots);
 
-	if (FireAC != nullptr)
+	if (FireAC.IsPlaying())
 	{
-		FireAC->FadeOut(0.1f, 0.0f);
-		FireAC = nullptr;
+		FireAC.FadeOut(0.1f);
 
 		PlayWeaponSound(FireFinishSound);
 	}
+	FireAC.Reset();
 }
 
 void ASWeapon::StartReload()
@@ -173,12 +352,6 @@ void ASWeapon::Fire()
 	if (bIsReloading)
 		StopReload();
 
-	// Networking
-	if (GetLocalRole() < ROLE_Authority)
-	{
-		ServerFire();
-	}
-
 	// Trace the world. from pawn eyes to crosshair location
 	AActor* MyOwner = GetOwner();
 
@@ -201,74 +374,149 @@ void ASWeapon::Fire()
 		}
 		++ShotNumber;
 
-		FVector TraceEnd = EyeLocation + (ShotDirection * 10000);
+		// Networking
+		if (GetLocalRole() < ROLE_Authority)
+		{
+			// Send the shot as the client fired it, the server rewinds the world to the client fire time
+			AGameStateBase* GS = GetWorld()->GetGameState();
+			ServerFire(EyeLocation, ShotDirection, GS != nullptr ? GS->GetServerWorldTimeSeconds() : GetWorld()->TimeSeconds);
+		}
+
+		FireShot(EyeLocation, ShotDirection, -1.0f);
+
+		LastFireTime = GetWorld()->TimeSeconds;
 
-		FCollisionQueryParams QueryParams;
-		QueryParams.AddIgnoredActor(MyOwner);
-		QueryParams.AddIgnoredActor(this);
-		QueryParams.bTraceComplex = true;
-		QueryParams.bReturnPhysicalMaterial = true;
+		--CurrentAmmo;
+	}
+}
 
-		// Smoke particle "Target" parameter
-		FVector TracerEndPoint = TraceEnd;
+void ASWeapon::FireShot(const FVector& TraceStart, const FVector& ShotDirection, float RewindTime)
+{
+	FVector TraceEnd = TraceStart + (ShotDirection * 10000);
 
-		EPhysicalSurface SurfaceType = SurfaceType_Default;
+	FCollisionQueryParams QueryParams = GetShotQueryParams();
 
+	// Server shots are resolved together with every other shot of the frame
+	USHitScanSubsystem* HitScan = GetWorld()->GetSubsystem<USHitScanSubsystem>();
+	if (GetLocalRole() == ROLE_Authority && HitScan != nullptr && USHitScanSubsystem::IsBatchingEnabled())
+	{
+		FHitScanRequest Request;
+		Request.Weapon = this;
+		Request.TraceStart = TraceStart;
+		Request.TraceEnd = TraceEnd;
+		Request.ShotDirection = ShotDirection;
+		Request.RewindTime = RewindTime;
+		Request.QueryParams = QueryParams;
+		HitScan->QueueShot(Request);
+	}
+	else
+	{
 		FHitResult Hit;
-		if (GetWorld()->LineTraceSingleByChannel(Hit, EyeLocation, TraceEnd, COLLISION_WEAPON, QueryParams))
+		bool bHit = GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, COLLISION_WEAPON, QueryParams);
+		ProcessHitScan(TraceStart, TraceEnd, ShotDirection, bHit ? &Hit : nullptr, RewindTime);
+	}
+}
+
+FCollisionQueryParams ASWeapon::GetShotQueryParams() const
+{
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(GetOwner());
+	QueryParams.AddIgnoredActor(this);
+	QueryParams.bTraceComplex = true;
+	QueryParams.bReturnPhysicalMaterial = true;
+	return QueryParams;
+}
+
+void ASWeapon::ProcessHitScan(const FVector& TraceStart, const FVector& TraceEnd, const FVector& ShotDirection, const FHitResult* Hit, float RewindTime)
+{
+	AActor* MyOwner = GetOwner();
+	if (MyOwner == nullptr)
+		return;
+
+	// Lag compensation, check the shot against the hitboxes as the client saw them
+	FHitResult CompensatedHit;
+	USLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USLagCompensationSubsystem>();
+	if (RewindTime >= 0.0f && GetLocalRole() == ROLE_Authority && LagCompensation != nullptr)
+	{
+		if (Hit != nullptr)
+			CompensatedHit = *Hit;
+
+		bool bBlockingHit = LagCompensation->RewindHitScan(TraceStart, TraceEnd, RewindTime, MyOwner, GetShotQueryParams(), CompensatedHit, Hit != nullptr);
+		Hit = bBlockingHit ? &CompensatedHit : nullptr;
+	}
+
+	// Smoke particle "Target" parameter
+	FVector TracerEndPoint = TraceEnd;
+
+	EPhysicalSurface SurfaceType = SurfaceType_Default;
+
+	if (Hit != nullptr)
+	{
+		// Blocking hit! Process damage
+		AActor* HitActor = Hit->GetActor();
+
+		SurfaceType = UPhysicalMaterial::DetermineSurfaceType(Hit->PhysMaterial.Get());
+
+		float ActualDamage = BaseDamage;
+		if (SurfaceType == SURFACE_FLESHVULNERABLE)
 		{
-			// Blocking hit! Process damage
-			AActor* HitActor = Hit.GetActor();
-
-			SurfaceType = UPhysicalMaterial::DetermineSurfaceType(Hit.PhysMaterial.Get());
-
-			float ActualDamage = BaseDamage;
-			if (SurfaceType == SURFACE_FLESHVULNERABLE)
-			{
-				ActualDamage *= VulnerableDamageMul;
-				UGameplayStatics::PlaySoundAtLocation(GetWorld(), CriticalHitSound, Hit.Location);
-			}
-			else
-			{
-				UGameplayStatics::PlaySoundAtLocation(GetWorld(), NormalHitSound, Hit.Location);
-			}
-			
-			if (bExplosiveBullets)
-				ActualDamage *= 2.0f;
-
-			UGameplayStatics::ApplyPointDamage(HitActor, ActualDamage, ShotDirection, Hit, MyOwner->GetInstigatorController(), MyOwner, DamageType);
-			PlayImpactEffects(SurfaceType, Hit.ImpactPoint);
-			TracerEndPoint = Hit.ImpactPoint;
+			ActualDamage *= VulnerableDamageMul;
+			USAudioPoolSubsystem::PlaySoundAtLocation(GetWorld(), CriticalHitSound, Hit->Location);
 		}
-
-		if (DebugWeaponDrawing > 0)
+		else
 		{
-			DrawDebugLine(GetWorld(), EyeLocation, TraceEnd, FColor::White, false, 1.0f, 0, 1.0f);
-			DrawDebugPoint(GetWorld(), TracerEndPoint, 5.0f, FColor::Red, false, 10.0, 5.0f);
+			USAudioPoolSubsystem::PlaySoundAtLocation(GetWorld(), NormalHitSound, Hit->Location);
 		}
 
-		PlayFireEffects(TracerEndPoint);
+		if (bExplosiveBullets)
+			ActualDamage *= 2.0f;
 
-		if (GetLocalRole() == ROLE_Authority)
-		{
-			HitScanTrace.TraceTo = TracerEndPoint;
-			HitScanTrace.SurfaceType = SurfaceType;
-		}
+		UGameplayStatics::ApplyPointDamage(HitActor, ActualDamage, ShotDirection, *Hit, MyOwner->GetInstigatorController(), MyOwner, DamageType);
+		PlayImpactEffects(SurfaceType, Hit->ImpactPoint);
+		TracerEndPoint = Hit->ImpactPoint;
+	}
 
-		LastFireTime = GetWorld()->TimeSeconds;
+	if (DebugWeaponDrawing > 0)
+	{
+		DrawDebugLine(GetWorld(), TraceStart, TraceEnd, FColor::White, false, 1.0f, 0, 1.0f);
+		DrawDebugPoint(GetWorld(), TracerEndPoint, 5.0f, FColor::Red, false, 10.0, 5.0f);
+	}
 
-		--CurrentAmmo;
+	PlayFireEffects(TracerEndPoint);
+
+	if (GetLocalRole() == ROLE_Authority)
+	{
+		HitScanTrace.AddShot(MeshComp->GetSocketLocation(MuzzleSocketName), TracerEndPoint, SurfaceType, Hit != nullptr);
 	}
 }
 
-void ASWeapon::ServerFire_Implementation()
+void ASWeapon::ServerFire_Implementation(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal ShotDirection, float ClientFireTime)
 {
-	Fire();
+	AActor* MyOwner = GetOwner();
+	if (CurrentAmmo <= 0 || MyOwner == nullptr)
+		return;
+
+	// Stop reload
+	if (bIsReloading)
+		StopReload();
+
+	// Don't trust a shot origin far away from where the server sees the shooter
+	FVector EyeLocation;
+	FRotator EyeRotation;
+	MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+
+	FVector ShotStart = FVector::DistSquared(TraceStart, EyeLocation) <= FMath::Square(MaxShotOriginError) ? (FVector)TraceStart : EyeLocation;
+
+	FireShot(ShotStart, ShotDirection.GetSafeNormal(), ClientFireTime);
+
+	LastFireTime = GetWorld()->TimeSeconds;
+
+	--CurrentAmmo;
 }
 
-bool ASWeapon::ServerFire_Validate()
+bool ASWeapon::ServerFire_Validate(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal ShotDirection, float ClientFireTime)
 {
-	return true;
+	return !TraceStart.ContainsNaN() && !ShotDirection.ContainsNaN() && !ShotDirection.IsNearlyZero();
 }
 
 void ASWeapon::Reload()
@@ -295,15 +543,18 @@ bool ASWeapon::ServerStartReload_Validate()
 
 void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 {
+	if (!FSCosmetics::ShouldPlay(this))
+		return;
+
 	// Spawn shot light particle effect
 	if (MuzzleEffect != nullptr)
-		UGameplayStatics::SpawnEmitterAttached(MuzzleEffect, MeshComp, MuzzleSocketName);
+		USFXPoolSubsystem::SpawnEmitterAttached(GetWorld(), MuzzleEffect, MeshComp, MuzzleSocketName);
 
 	// Spawn smoke particle effect
 	if (TracerEffect != nullptr)
 	{
 		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
-		UParticleSystemComponent* TracerComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TracerEffect, MuzzleLocation);
+		UParticleSystemComponent* TracerComp = USFXPoolSubsystem::SpawnEmitterAtLocation(GetWorld(), TracerEffect, MuzzleLocation);
 
 		if (TracerComp != nullptr)
 			TracerComp->SetVectorParameter(TracerTargetName, TracerEndPoint);
@@ -314,7 +565,8 @@ void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 	{
 		APlayerController* PC = Cast<APlayerController>(MyOwner->GetController());
 
-		if (PC != nullptr)
+		// Only the local controller shakes, the server would send an extra shake RPC to the shooter
+		if (PC != nullptr && PC->IsLocalController())
 		{
 			PC->ClientPlayCameraShake(FireCamShake);
 		}
@@ -323,6 +575,9 @@ void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 
 void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoint)
 {
+	if (!FSCosmetics::ShouldPlay(this))
+		return;
+
 	UParticleSystem* SelectedEffect = nullptr;
 
 	switch (SurfaceType)
@@ -342,42 +597,90 @@ void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoi
 		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
 		FVector ShotDirection = ImpactPoint - MuzzleLocation;
 		ShotDirection.Normalize();
-		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), SelectedEffect, ImpactPoint, ShotDirection.Rotation());
+		USFXPoolSubsystem::SpawnEmitterAtLocation(GetWorld(), SelectedEffect, ImpactPoint, ShotDirection.Rotation());
 
 		if (bExplosiveBullets && ExplosionEffect != nullptr)
 		{
-			UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, ImpactPoint, ShotDirection.Rotation());
-			UGameplayStatics::PlaySoundAtLocation(this, ExplosionSound, GetActorLocation());
+			USFXPoolSubsystem::SpawnEmitterAtLocation(GetWorld(), ExplosionEffect, ImpactPoint, ShotDirection.Rotation());
+			USAudioPoolSubsystem::PlaySoundAtLocation(GetWorld(), ExplosionSound, GetActorLocation());
 		}
 	}
 
 }
 
-UAudioComponent* ASWeapon::PlayWeaponSound(USoundCue* Sound)
+FSAudioHandle ASWeapon::PlayWeaponSound(USoundCue* Sound)
 {
-	UAudioComponent* AC = NULL;
+	FSAudioHandle Handle;
 	AActor* MyOwner = GetOwner();
 	if (Sound != nullptr && MyOwner != nullptr)
 	{
-		AC = UGameplayStatics::SpawnSoundAttached(Sound, MyOwner->GetRootComponent());
+		Handle = USAudioPoolSubsystem::PlaySoundAttached(GetWorld(), Sound, MyOwner->GetRootComponent());
 	}
 
-	return AC;
+	return Handle;
 }
 
 void ASWeapon::OnRep_HitScanTrace()
 {
-	// Play cosmetic FX
-	PlayFireEffects(HitScanTrace.TraceTo);
+	// Replay every shot fired since the last update, only the newest one when we just became relevant
+	int32 NewShots = (uint16)(HitScanTrace.ShotCounter - LastReplayedShotCounter);
+	int32 NumToReplay = FMath::Min<int32>(bReplayedHitScanTrace ? NewShots : 1, HitScanTrace.NumShots);
+
+	// This connection missed more updates than the burst resends
+	if (bReplayedHitScanTrace && NewShots > NumToReplay)
+		INC_DWORD_STAT_BY(STAT_HitScanBurstShotsLost, NewShots - NumToReplay);
+
+	LastReplayedShotCounter = HitScanTrace.ShotCounter;
+	bReplayedHitScanTrace = true;
+
+	FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+	for (int32 Age = NumToReplay - 1; Age >= 0; --Age)
+	{
+		const FHitScanTrace& Shot = HitScanTrace.GetShot(Age);
+		FVector TraceTo = Shot.GetTraceTo(MuzzleLocation);
+
+		// Play cosmetic FX
+		PlayFireEffects(TraceTo);
 
-	PlayImpactEffects(HitScanTrace.SurfaceType, HitScanTrace.TraceTo);
+		if (Shot.bBlockingHit)
+			PlayImpactEffects((EPhysicalSurface)Shot.SurfaceType, TraceTo);
+	}
 
-	if (FireAC == NULL && CurrentAmmo > 0)
+	if (!FireAC.IsPlaying() && CurrentAmmo > 0)
 	{
 		FireAC = PlayWeaponSound(LoopedFireSound);
 	}
 }
 
+void ASWeapon::SetHolstered(bool bHolstered)
+{
+	// Wake before the weapon shows, a holstered weapon goes dormant after the hidden state replicated
+	if (!bHolstered)
+		ReplicationPolicyComp->SetIdle(false);
+
+	SetActorHiddenInGame(bHolstered);
+
+	if (bHolstered)
+		ReplicationPolicyComp->SetIdle(true);
+}
+
+bool ASWeapon::IsNetReady()
+{
+	if (GetLocalRole() == ROLE_Authority)
+		return true;
+
+	// Dormancy closes the actor channel on the client
+	UNetConnection* Connection = GetNetConnection();
+	return Connection != nullptr && Connection->FindActorChannelRef(this) != nullptr;
+}
+
+void ASWeapon::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	HitScanTrace.BeginNetUpdate();
+}
+
 void ASWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
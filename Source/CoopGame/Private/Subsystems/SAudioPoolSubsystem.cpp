@@ -0,0 +1,266 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SAudioPoolSubsystem.h"
+#include "Engine/World.h"
+#include "Components/AudioComponent.h"
+#include "Sound/SoundBase.h"
+#include "Misc/App.h"
+#include "SCosmetics.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopAudioPool"), STATGROUP_CoopAudioPool, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sounds Requested"), STAT_AudioPoolRequested, STATGROUP_CoopAudioPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sounds Played"), STAT_AudioPoolPlayed, STATGROUP_CoopAudioPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped (No Audio)"), STAT_AudioPoolSkippedNoAudio, STATGROUP_CoopAudioPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped (Duplicate)"), STAT_AudioPoolSkippedDuplicate, STATGROUP_CoopAudioPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped (Voice Budget)"), STAT_AudioPoolSkippedBudget, STATGROUP_CoopAudioPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Components"), STAT_AudioPoolComponents, STATGROUP_CoopAudioPool);
+
+static int32 AudioPoolSize = 32;
+FAutoConsoleVariableRef CVARAudioPoolSize(
+	TEXT("COOP.AudioPoolSize"),
+	AudioPoolSize,
+	TEXT("Max audio components used by weapon sounds, sounds past this are dropped"),
+	ECVF_Default);
+
+static int32 AudioMaxVoicesPerCue = 4;
+FAutoConsoleVariableRef CVARAudioMaxVoicesPerCue(
+	TEXT("COOP.AudioMaxVoicesPerCue"),
+	AudioMaxVoicesPerCue,
+	TEXT("Max voices playing the same cue at once"),
+	ECVF_Default);
+
+static float AudioDedupDistance = 50.0f;
+FAutoConsoleVariableRef CVARAudioDedupDistance(
+	TEXT("COOP.AudioDedupDistance"),
+	AudioDedupDistance,
+	TEXT("Same cue played closer than this within a frame is only played once"),
+	ECVF_Default);
+
+// Totals since the last COOP.AudioPoolReport
+static uint64 AudioRequested = 0;
+static uint64 AudioPlayed = 0;
+static uint64 AudioAllocated = 0;
+static double AudioReportStartTime = 0.0;
+
+static FAutoConsoleCommand AudioPoolReportCmd(
+	TEXT("COOP.AudioPoolReport"),
+	TEXT("Logs weapon sounds requested and avoided per second since the last report and resets the counters"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		double Now = FPlatformTime::Seconds();
+		double Elapsed = AudioReportStartTime > 0.0 ? FMath::Max(Now - AudioReportStartTime, 0.001) : 0.0;
+		uint64 Avoided = AudioRequested - AudioPlayed;
+
+		UE_LOG(LogTemp, Log, TEXT("Audio pool: %llu requested, %llu played, %llu avoided, %llu components allocated over %.1f s (%.1f avoided spawns/s)"),
+			AudioRequested, AudioPlayed, Avoided, AudioAllocated, Elapsed, Elapsed > 0.0 ? Avoided / Elapsed : 0.0);
+
+		AudioRequested = 0;
+		AudioPlayed = 0;
+		AudioAllocated = 0;
+		AudioReportStartTime = Now;
+	}));
+
+UAudioComponent* FSAudioHandle::Get() const
+{
+	UAudioComponent* AC = Component.Get();
+	UWorld* World = AC != nullptr ? AC->GetWorld() : nullptr;
+	USAudioPoolSubsystem* AudioPool = World != nullptr ? World->GetSubsystem<USAudioPoolSubsystem>() : nullptr;
+	if (AudioPool == nullptr)
+		return nullptr;
+
+	const uint32* ActivePlayId = AudioPool->PlayIds.Find(AC);
+	return ActivePlayId != nullptr && *ActivePlayId == PlayId ? AC : nullptr;
+}
+
+void FSAudioHandle::Stop()
+{
+	if (UAudioComponent* AC = Get())
+		AC->Stop();
+
+	Reset();
+}
+
+void FSAudioHandle::FadeOut(float FadeOutDuration)
+{
+	if (UAudioComponent* AC = Get())
+		AC->FadeOut(FadeOutDuration, 0.0f);
+
+	Reset();
+}
+
+void FSAudioHandle::Reset()
+{
+	Component.Reset();
+	PlayId = 0;
+}
+
+void USAudioPoolSubsystem::Deinitialize()
+{
+	for (UAudioComponent* AC : ActiveComponents)
+	{
+		if (AC != nullptr)
+			AC->DestroyComponent();
+	}
+	for (UAudioComponent* AC : FreeComponents)
+	{
+		if (AC != nullptr)
+			AC->DestroyComponent();
+	}
+
+	DEC_DWORD_STAT_BY(STAT_AudioPoolComponents, ActiveComponents.Num() + FreeComponents.Num());
+
+	ActiveComponents.Empty();
+	FreeComponents.Empty();
+	PlayIds.Empty();
+	ActiveVoices.Empty();
+
+	Super::Deinitialize();
+}
+
+bool USAudioPoolSubsystem::CanPlayAudio(UWorld* World)
+{
+	return FSCosmetics::ShouldPlay(World) && FApp::CanEverRender() && World->GetAudioDevice() != nullptr;
+}
+
+FSAudioHandle USAudioPoolSubsystem::PlaySoundAttached(UWorld* World, USoundBase* Sound, USceneComponent* AttachToComponent)
+{
+	if (Sound == nullptr || AttachToComponent == nullptr)
+		return FSAudioHandle();
+
+	++AudioRequested;
+	INC_DWORD_STAT(STAT_AudioPoolRequested);
+
+	USAudioPoolSubsystem* AudioPool = World != nullptr ? World->GetSubsystem<USAudioPoolSubsystem>() : nullptr;
+	if (AudioPool == nullptr || !CanPlayAudio(World))
+	{
+		INC_DWORD_STAT(STAT_AudioPoolSkippedNoAudio);
+		return FSAudioHandle();
+	}
+
+	return AudioPool->Play(Sound, AttachToComponent, AttachToComponent->GetComponentLocation());
+}
+
+FSAudioHandle USAudioPoolSubsystem::PlaySoundAtLocation(UWorld* World, USoundBase* Sound, const FVector& Location)
+{
+	if (Sound == nullptr)
+		return FSAudioHandle();
+
+	++AudioRequested;
+	INC_DWORD_STAT(STAT_AudioPoolRequested);
+
+	USAudioPoolSubsystem* AudioPool = World != nullptr ? World->GetSubsystem<USAudioPoolSubsystem>() : nullptr;
+	if (AudioPool == nullptr || !CanPlayAudio(World))
+	{
+		INC_DWORD_STAT(STAT_AudioPoolSkippedNoAudio);
+		return FSAudioHandle();
+	}
+
+	return AudioPool->Play(Sound, nullptr, Location);
+}
+
+bool USAudioPoolSubsystem::IsDuplicate(USoundBase* Sound, USceneComponent* AttachToComponent, const FVector& Location)
+{
+	if (DedupFrame != GFrameCounter)
+	{
+		PlayedThisFrame.Reset();
+		DedupFrame = GFrameCounter;
+	}
+
+	float DedupDistanceSq = FMath::Square(AudioDedupDistance);
+	for (const FPlayedSound& Played : PlayedThisFrame)
+	{
+		if (Played.Sound != Sound)
+			continue;
+
+		if (AttachToComponent != nullptr ? Played.AttachParent == AttachToComponent : FVector::DistSquared(Played.Location, Location) <= DedupDistanceSq)
+			return true;
+	}
+
+	FPlayedSound& Played = PlayedThisFrame.AddDefaulted_GetRef();
+	Played.Sound = Sound;
+	Played.AttachParent = AttachToComponent;
+	Played.Location = Location;
+	return false;
+}
+
+FSAudioHandle USAudioPoolSubsystem::Play(USoundBase* Sound, USceneComponent* AttachToComponent, const FVector& Location)
+{
+	if (IsDuplicate(Sound, AttachToComponent, Location))
+	{
+		INC_DWORD_STAT(STAT_AudioPoolSkippedDuplicate);
+		return FSAudioHandle();
+	}
+
+	int32& Voices = ActiveVoices.FindOrAdd(Sound);
+	if (Voices >= AudioMaxVoicesPerCue || (FreeComponents.Num() == 0 && ActiveComponents.Num() >= AudioPoolSize))
+	{
+		INC_DWORD_STAT(STAT_AudioPoolSkippedBudget);
+		return FSAudioHandle();
+	}
+
+	UAudioComponent* AC = nullptr;
+	if (FreeComponents.Num() > 0)
+	{
+		AC = FreeComponents.Pop(false);
+	}
+	else
+	{
+		AC = NewObject<UAudioComponent>(GetWorld());
+		AC->bAutoDestroy = false;
+		AC->bAutoActivate = false;
+		AC->OnAudioFinishedNative.AddUObject(this, &USAudioPoolSubsystem::OnAudioFinished);
+		AC->RegisterComponentWithWorld(GetWorld());
+
+		++AudioAllocated;
+		INC_DWORD_STAT(STAT_AudioPoolComponents);
+	}
+
+	if (AttachToComponent != nullptr)
+	{
+		AC->AttachToComponent(AttachToComponent, FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	}
+	else
+	{
+		if (AC->GetAttachParent() != nullptr)
+			AC->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+		AC->SetWorldLocation(Location);
+	}
+
+	++Voices;
+	ActiveComponents.Add(AC);
+
+	// 0 is an empty handle
+	if (++LastPlayId == 0)
+		++LastPlayId;
+	PlayIds.Add(AC, LastPlayId);
+
+	AC->SetSound(Sound);
+	AC->Play();
+
+	++AudioPlayed;
+	INC_DWORD_STAT(STAT_AudioPoolPlayed);
+
+	FSAudioHandle Handle;
+	Handle.Component = AC;
+	Handle.PlayId = LastPlayId;
+	return Handle;
+}
+
+void USAudioPoolSubsystem::OnAudioFinished(UAudioComponent* AudioComponent)
+{
+	if (ActiveComponents.RemoveSingleSwap(AudioComponent, false) == 0)
+		return;
+
+	// Handles to the finished sound go stale
+	PlayIds.Remove(AudioComponent);
+
+	int32* Voices = ActiveVoices.Find(AudioComponent->Sound);
+	if (Voices != nullptr && --(*Voices) <= 0)
+		ActiveVoices.Remove(AudioComponent->Sound);
+
+	if (AudioComponent->GetAttachParent() != nullptr)
+		AudioComponent->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+	FreeComponents.Add(AudioComponent);
+}
@@ -0,0 +1,607 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SExplosionSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/DamageType.h"
+#include "GameFramework/MovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "PhysicsEngine/RadialForceComponent.h"
+#include "Async/ParallelFor.h"
+#include "Components/SHealthComponent.h"
+#include "SExplosiveBarrel.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopExplosions"), STATGROUP_CoopExplosions, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Resolve Explosions"), STAT_ExplosionResolve, STATGROUP_CoopExplosions);
+DECLARE_CYCLE_STAT(TEXT("Broadphase"), STAT_ExplosionBroadphase, STATGROUP_CoopExplosions);
+DECLARE_CYCLE_STAT(TEXT("Visibility Traces"), STAT_ExplosionTraces, STATGROUP_CoopExplosions);
+DECLARE_CYCLE_STAT(TEXT("Deliver Damage And Impulses"), STAT_ExplosionDeliver, STATGROUP_CoopExplosions);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosions"), STAT_ExplosionCount, STATGROUP_CoopExplosions);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Broadphase Queries"), STAT_ExplosionQueries, STATGROUP_CoopExplosions);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visibility Traces"), STAT_ExplosionTraceCount, STATGROUP_CoopExplosions);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pending Explosions"), STAT_ExplosionPending, STATGROUP_CoopExplosions);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Resolve Time (ms)"), STAT_ExplosionFrameMs, STATGROUP_CoopExplosions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Worst Frame Resolve Time (ms)"), STAT_ExplosionWorstFrameMs, STATGROUP_CoopExplosions);
+
+static int32 ExplosionBatching = 1;
+FAutoConsoleVariableRef CVARExplosionBatching(
+	TEXT("COOP.ExplosionBatching"),
+	ExplosionBatching,
+	TEXT("Resolve the explosions of a frame together with a shared broadphase (0 = ApplyRadialDamage and FireImpulse per explosion)"),
+	ECVF_Default);
+
+static float ExplosionClusterExtent = 4000.0f;
+FAutoConsoleVariableRef CVARExplosionClusterExtent(
+	TEXT("COOP.ExplosionClusterExtent"),
+	ExplosionClusterExtent,
+	TEXT("Max size of the box around explosions sharing a broadphase query, explosions further apart get their own query"),
+	ECVF_Default);
+
+static int32 ExplosionMaxPerFrame = 32;
+FAutoConsoleVariableRef CVARExplosionMaxPerFrame(
+	TEXT("COOP.ExplosionMaxPerFrame"),
+	ExplosionMaxPerFrame,
+	TEXT("Max explosions resolved per frame, the rest waits for the next frames"),
+	ECVF_Default);
+
+static float ExplosionBudgetMs = 2.0f;
+FAutoConsoleVariableRef CVARExplosionBudgetMs(
+	TEXT("COOP.ExplosionBudgetMs"),
+	ExplosionBudgetMs,
+	TEXT("Milliseconds per frame spent resolving explosions, at least one batch is resolved per frame"),
+	ECVF_Default);
+
+static int32 ExplosionBatchSize = 8;
+FAutoConsoleVariableRef CVARExplosionBatchSize(
+	TEXT("COOP.ExplosionBatchSize"),
+	ExplosionBatchSize,
+	TEXT("Explosions sharing a broadphase pass, the time budget is checked between batches"),
+	ECVF_Default);
+
+static float ExplosionFuseDelay = 0.1f;
+FAutoConsoleVariableRef CVARExplosionFuseDelay(
+	TEXT("COOP.ExplosionFuseDelay"),
+	ExplosionFuseDelay,
+	TEXT("Seconds between an explosion and the detonations it sets off, these never resolve before the next frame"),
+	ECVF_Default);
+
+static int32 ExplosionTraceChunks = 0;
+FAutoConsoleVariableRef CVARExplosionTraceChunks(
+	TEXT("COOP.ExplosionTraceChunks"),
+	ExplosionTraceChunks,
+	TEXT("Parallel chunks for explosion visibility traces (0 = one per worker thread, 1 = game thread only)"),
+	ECVF_Default);
+
+// Below this many visibility traces they stay on the game thread
+static const int32 MinTracesForParallel = 32;
+
+// Frames the chain reaction benchmark keeps watching once every explosion is resolved, and at most
+static const int32 BenchmarkIdleFrameCount = 30;
+static const int32 BenchmarkMaxFrameCount = 1200;
+
+static FAutoConsoleCommandWithWorldAndArgs ExplosionBenchmarkCmd(
+	TEXT("COOP.ExplosionBenchmark"),
+	TEXT("Lays out barrels in front of the first player, detonates them in one frame and logs the resolve time and worst frame. Usage: COOP.ExplosionBenchmark [NumBarrels=200] [Spacing=150]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USExplosionSubsystem* Explosions = World != nullptr ? World->GetSubsystem<USExplosionSubsystem>() : nullptr;
+		if (Explosions == nullptr)
+			return;
+
+		int32 NumBarrels = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200;
+		float Spacing = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 150.0f;
+		Explosions->RunChainReactionBenchmark(FMath::Max(NumBarrels, 1), FMath::Max(Spacing, 1.0f));
+	}));
+
+namespace
+{
+	// Explosions sharing one broadphase query
+	struct FExplosionCluster
+	{
+		FBox Bounds;
+		TArray<int32, TInlineAllocator<8>> Explosions;
+	};
+
+	// Visibility of a component from an explosion, same test as ApplyRadialDamage
+	struct FExplosionTrace
+	{
+		int32 Explosion;
+		UPrimitiveComponent* Component;
+		FHitResult Hit;
+		bool bDamageable;
+	};
+
+	// A component pushed by an explosion
+	struct FExplosionImpulse
+	{
+		int32 Explosion;
+		UPrimitiveComponent* Component;
+	};
+
+	bool IsResolvedBefore(const FSExplosion& A, const FSExplosion& B)
+	{
+		if (A.DueTime != B.DueTime)
+			return A.DueTime < B.DueTime;
+		if (A.ChainDepth != B.ChainDepth)
+			return A.ChainDepth < B.ChainDepth;
+		if (A.TriggerDistance != B.TriggerDistance)
+			return A.TriggerDistance < B.TriggerDistance;
+		return A.CauserId < B.CauserId;
+	}
+}
+
+void USExplosionSubsystem::Deinitialize()
+{
+	Pending.Empty();
+	Resolving.Empty();
+	bBenchmark = false;
+
+	Super::Deinitialize();
+}
+
+bool USExplosionSubsystem::IsTickable() const
+{
+	return !IsTemplate() && (Pending.Num() > 0 || bBenchmark);
+}
+
+TStatId USExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USExplosionSubsystem, STATGROUP_Tickables);
+}
+
+bool USExplosionSubsystem::IsBatchingEnabled()
+{
+	return ExplosionBatching > 0;
+}
+
+void USExplosionSubsystem::Detonate(AActor* DamageCauser, float BaseDamage, float DamageRadius, URadialForceComponent* ForceComp)
+{
+	if (DamageCauser == nullptr)
+		return;
+
+	FSExplosion Explosion;
+	Explosion.DamageCauser = DamageCauser;
+	Explosion.InstigatedBy = DamageCauser->GetInstigatorController();
+	Explosion.Origin = DamageCauser->GetActorLocation();
+	Explosion.bApplyDamage = DamageCauser->GetLocalRole() == ROLE_Authority;
+	Explosion.BaseDamage = BaseDamage;
+	Explosion.DamageRadius = DamageRadius;
+
+	if (ForceComp != nullptr)
+	{
+		Explosion.ImpulseOrigin = ForceComp->GetComponentLocation();
+		Explosion.ImpulseRadius = ForceComp->Radius;
+		Explosion.ImpulseStrength = ForceComp->ImpulseStrength;
+		Explosion.ImpulseFalloff = ForceComp->Falloff;
+		Explosion.bImpulseVelChange = ForceComp->bImpulseVelChange;
+		if (ForceComp->bIgnoreOwningActor)
+			Explosion.ImpulseIgnoredActor = ForceComp->GetOwner();
+	}
+
+	DetonateExplosion(Explosion, ForceComp);
+}
+
+void USExplosionSubsystem::DetonateExplosion(FSExplosion Explosion, URadialForceComponent* ForceComp)
+{
+	AActor* DamageCauser = Explosion.DamageCauser.Get();
+	Explosion.DueTime = GetWorld()->TimeSeconds;
+	Explosion.CauserId = DamageCauser != nullptr ? DamageCauser->GetUniqueID() : 0;
+
+	// Set off by another explosion, burn the fuse first
+	if (CurrentExplosion != nullptr)
+	{
+		Explosion.DueTime += ExplosionFuseDelay;
+		Explosion.ChainDepth = CurrentExplosion->ChainDepth + 1;
+		Explosion.TriggerDistance = FVector::Dist(CurrentExplosion->Origin, Explosion.Origin);
+	}
+
+	++NumDetonations;
+	INC_DWORD_STAT(STAT_ExplosionCount);
+
+	if (!IsBatchingEnabled())
+	{
+		ResolveImmediate(Explosion, ForceComp);
+		return;
+	}
+
+	QueueExplosion(Explosion);
+}
+
+void USExplosionSubsystem::QueueExplosion(const FSExplosion& Explosion)
+{
+	Pending.Add(Explosion);
+	SET_DWORD_STAT(STAT_ExplosionPending, Pending.Num());
+}
+
+void USExplosionSubsystem::ResolveImmediate(const FSExplosion& Explosion, URadialForceComponent* ForceComp)
+{
+	if (ForceComp != nullptr)
+	{
+		ForceComp->FireImpulse();
+	}
+	else if (Explosion.ImpulseRadius > 0.0f)
+	{
+		// No component to fire it, push things the batched way
+		TArray<FSExplosion> Impulse;
+		Impulse.Add(Explosion);
+		Impulse[0].bApplyDamage = false;
+		ResolveBatch(Impulse);
+	}
+
+	if (Explosion.bApplyDamage)
+	{
+		TArray<AActor*> IgnoredActors;
+		if (Explosion.DamageCauser.IsValid())
+			IgnoredActors.Add(Explosion.DamageCauser.Get());
+
+		UGameplayStatics::ApplyRadialDamage(this, Explosion.BaseDamage, Explosion.Origin, Explosion.DamageRadius,
+			Explosion.DamageTypeClass, IgnoredActors, Explosion.DamageCauser.Get(), Explosion.InstigatedBy.Get(), Explosion.bDoFullDamage);
+	}
+}
+
+void USExplosionSubsystem::Tick(float DeltaTime)
+{
+	if (Pending.Num() > 0)
+		ResolveDue();
+
+	if (bBenchmark)
+		TickBenchmark();
+}
+
+void USExplosionSubsystem::ResolveDue()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ExplosionResolve);
+
+	double StartTime = FPlatformTime::Seconds();
+	double EndTime = StartTime + ExplosionBudgetMs / 1000.0;
+
+	// Explosions set off from here on land behind the due ones and wait for the next frame
+	Pending.StableSort(&IsResolvedBefore);
+
+	float Now = GetWorld()->TimeSeconds;
+	int32 MaxDue = FMath::Max(ExplosionMaxPerFrame, 1);
+	int32 NumDue = 0;
+	while (NumDue < Pending.Num() && NumDue < MaxDue && Pending[NumDue].DueTime <= Now)
+	{
+		++NumDue;
+	}
+
+	int32 BatchSize = FMath::Max(ExplosionBatchSize, 1);
+	int32 NumResolved = 0;
+	while (NumResolved < NumDue && (NumResolved == 0 || FPlatformTime::Seconds() < EndTime))
+	{
+		int32 Count = FMath::Min(BatchSize, NumDue - NumResolved);
+		Resolving.Reset();
+		Resolving.Append(Pending.GetData() + NumResolved, Count);
+		ResolveBatch(Resolving);
+		NumResolved += Count;
+	}
+
+	Pending.RemoveAt(0, NumResolved, false);
+	Resolving.Reset();
+
+	float ResolveMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	WorstResolveMs = FMath::Max(WorstResolveMs, ResolveMs);
+	SET_FLOAT_STAT(STAT_ExplosionFrameMs, ResolveMs);
+	SET_FLOAT_STAT(STAT_ExplosionWorstFrameMs, WorstResolveMs);
+	SET_DWORD_STAT(STAT_ExplosionPending, Pending.Num());
+}
+
+void USExplosionSubsystem::ResolveBatch(const TArray<FSExplosion>& Explosions)
+{
+	UWorld* World = GetWorld();
+
+	// Group explosions close enough to share a query
+	TArray<FExplosionCluster, TInlineAllocator<4>> Clusters;
+	for (int32 i = 0; i < Explosions.Num(); ++i)
+	{
+		const FSExplosion& Explosion = Explosions[i];
+
+		FBox Bounds(ForceInit);
+		if (Explosion.bApplyDamage)
+			Bounds += FBox::BuildAABB(Explosion.Origin, FVector(Explosion.DamageRadius));
+		if (Explosion.ImpulseRadius > 0.0f)
+			Bounds += FBox::BuildAABB(Explosion.ImpulseOrigin, FVector(Explosion.ImpulseRadius));
+		if (!Bounds.IsValid)
+			continue;
+
+		FExplosionCluster* Cluster = Clusters.FindByPredicate([&](const FExplosionCluster& Other)
+		{
+			return (Other.Bounds + Bounds).GetSize().GetMax() <= ExplosionClusterExtent;
+		});
+
+		if (Cluster == nullptr)
+		{
+			Cluster = &Clusters.AddDefaulted_GetRef();
+			Cluster->Bounds = Bounds;
+		}
+
+		Cluster->Bounds += Bounds;
+		Cluster->Explosions.Add(i);
+	}
+
+	TArray<FExplosionTrace> Traces;
+	TArray<FExplosionImpulse> Impulses;
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ExplosionBroadphase);
+
+		// The default object types of a radial force component are the dynamic ones too
+		FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects);
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ExplosionBroadphase), false);
+
+		TArray<FOverlapResult> Overlaps;
+		TArray<UPrimitiveComponent*> Components;
+		TSet<UPrimitiveComponent*> SeenComponents;
+
+		for (const FExplosionCluster& Cluster : Clusters)
+		{
+			INC_DWORD_STAT(STAT_ExplosionQueries);
+
+			Overlaps.Reset();
+			World->OverlapMultiByObjectType(Overlaps, Cluster.Bounds.GetCenter(), FQuat::Identity, ObjectParams,
+				FCollisionShape::MakeBox(Cluster.Bounds.GetExtent()), QueryParams);
+
+			// A component with several bodies shows up once per body
+			Components.Reset();
+			SeenComponents.Reset();
+			for (const FOverlapResult& Overlap : Overlaps)
+			{
+				UPrimitiveComponent* Component = Overlap.Component.Get();
+				if (Component != nullptr && Component->GetOwner() != nullptr && !SeenComponents.Contains(Component))
+				{
+					SeenComponents.Add(Component);
+					Components.Add(Component);
+				}
+			}
+
+			// Narrow down to the components each blast sphere actually overlaps
+			for (int32 ExplosionIndex : Cluster.Explosions)
+			{
+				const FSExplosion& Explosion = Explosions[ExplosionIndex];
+				AActor* DamageCauser = Explosion.DamageCauser.Get();
+				AActor* ImpulseIgnoredActor = Explosion.ImpulseIgnoredActor.Get();
+
+				FCollisionShape DamageSphere = FCollisionShape::MakeSphere(Explosion.DamageRadius);
+				FCollisionShape ImpulseSphere = FCollisionShape::MakeSphere(Explosion.ImpulseRadius);
+
+				for (UPrimitiveComponent* Component : Components)
+				{
+					AActor* Owner = Component->GetOwner();
+					FBox ComponentBox = Component->Bounds.GetBox();
+
+					if (Explosion.ImpulseRadius > 0.0f && Owner != ImpulseIgnoredActor
+						&& FMath::SphereAABBIntersection(Explosion.ImpulseOrigin, FMath::Square(Explosion.ImpulseRadius), ComponentBox)
+						&& Component->OverlapComponent(Explosion.ImpulseOrigin, FQuat::Identity, ImpulseSphere))
+					{
+						Impulses.Add({ ExplosionIndex, Component });
+					}
+
+					if (Explosion.bApplyDamage && Owner != DamageCauser && Owner->CanBeDamaged()
+						&& FMath::SphereAABBIntersection(Explosion.Origin, FMath::Square(Explosion.DamageRadius), ComponentBox)
+						&& Component->OverlapComponent(Explosion.Origin, FQuat::Identity, DamageSphere))
+					{
+						Traces.Add({ ExplosionIndex, Component, FHitResult(), false });
+					}
+				}
+			}
+		}
+	}
+
+	if (Traces.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ExplosionTraces);
+		INC_DWORD_STAT_BY(STAT_ExplosionTraceCount, Traces.Num());
+
+		// Weak pointers are resolved here, not on the workers
+		TArray<const AActor*, TInlineAllocator<16>> DamageCausers;
+		for (const FSExplosion& Explosion : Explosions)
+		{
+			DamageCausers.Add(Explosion.DamageCauser.Get());
+		}
+
+		int32 NumTraces = Traces.Num();
+		int32 NumChunks = ExplosionTraceChunks > 0 ? ExplosionTraceChunks : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+		NumChunks = NumTraces < MinTracesForParallel ? 1 : FMath::Min(NumChunks, NumTraces);
+		int32 ChunkSize = FMath::DivideAndRoundUp(NumTraces, NumChunks);
+
+		// Scene queries only read the physics scene, every chunk writes its own range of Traces
+		ParallelFor(NumChunks, [&](int32 Chunk)
+		{
+			int32 End = FMath::Min((Chunk + 1) * ChunkSize, NumTraces);
+			for (int32 i = Chunk * ChunkSize; i < End; ++i)
+			{
+				FExplosionTrace& Trace = Traces[i];
+				const FSExplosion& Explosion = Explosions[Trace.Explosion];
+				UPrimitiveComponent* Component = Trace.Component;
+
+				// Blocked by anything but the component itself means no damage
+				FCollisionQueryParams LineParams(SCENE_QUERY_STAT(ExplosionVisibility), true, DamageCausers[Trace.Explosion]);
+
+				FVector TraceStart = Explosion.Origin;
+				FVector TraceEnd = Component->Bounds.Origin;
+				if (TraceStart == TraceEnd)
+					TraceStart.Z += 0.01f;
+
+				if (World->LineTraceSingleByChannel(Trace.Hit, TraceStart, TraceEnd, ECC_Visibility, LineParams))
+				{
+					Trace.bDamageable = Trace.Hit.Component == Component;
+					continue;
+				}
+
+				// Nothing in the way, hit the component where it is
+				FVector HitLocation = Component->GetComponentLocation();
+				Trace.Hit = FHitResult(Component->GetOwner(), Component, HitLocation, (Explosion.Origin - HitLocation).GetSafeNormal());
+				Trace.bDamageable = true;
+			}
+		}, NumChunks == 1);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ExplosionDeliver);
+
+	// Clusters interleave explosions, the stable sort keeps broadphase order within one
+	Impulses.StableSort([](const FExplosionImpulse& A, const FExplosionImpulse& B) { return A.Explosion < B.Explosion; });
+	Traces.StableSort([](const FExplosionTrace& A, const FExplosionTrace& B) { return A.Explosion < B.Explosion; });
+
+	// Deliver in resolve order, impulses first like FireImpulse before ApplyRadialDamage
+	const FSExplosion* OuterExplosion = CurrentExplosion;
+	int32 NextImpulse = 0;
+	int32 NextTrace = 0;
+	TArray<TPair<AActor*, TArray<FHitResult>>> Victims;
+
+	for (int32 i = 0; i < Explosions.Num(); ++i)
+	{
+		const FSExplosion& Explosion = Explosions[i];
+		CurrentExplosion = &Explosion;
+
+		for (; NextImpulse < Impulses.Num() && Impulses[NextImpulse].Explosion == i; ++NextImpulse)
+		{
+			UPrimitiveComponent* Component = Impulses[NextImpulse].Component;
+			if (IsValid(Component))
+				DeliverImpulse(Explosion, Component);
+		}
+
+		// Hits per actor, nearest actor first
+		Victims.Reset();
+		for (; NextTrace < Traces.Num() && Traces[NextTrace].Explosion == i; ++NextTrace)
+		{
+			const FExplosionTrace& Trace = Traces[NextTrace];
+			if (!Trace.bDamageable)
+				continue;
+
+			AActor* Victim = Trace.Component->GetOwner();
+			TPair<AActor*, TArray<FHitResult>>* Entry = Victims.FindByPredicate([Victim](const TPair<AActor*, TArray<FHitResult>>& Other) { return Other.Key == Victim; });
+			if (Entry == nullptr)
+				Entry = &Victims.Emplace_GetRef(Victim, TArray<FHitResult>());
+			Entry->Value.Add(Trace.Hit);
+		}
+
+		Victims.Sort([&Explosion](const TPair<AActor*, TArray<FHitResult>>& A, const TPair<AActor*, TArray<FHitResult>>& B)
+		{
+			float DistSqA = FVector::DistSquared(Explosion.Origin, A.Key->GetActorLocation());
+			float DistSqB = FVector::DistSquared(Explosion.Origin, B.Key->GetActorLocation());
+			return DistSqA != DistSqB ? DistSqA < DistSqB : A.Key->GetUniqueID() < B.Key->GetUniqueID();
+		});
+
+		for (TPair<AActor*, TArray<FHitResult>>& Victim : Victims)
+		{
+			// Earlier damage of this batch may have destroyed it
+			if (!IsValid(Victim.Key))
+				continue;
+
+			FRadialDamageEvent DamageEvent;
+			DamageEvent.DamageTypeClass = Explosion.DamageTypeClass != nullptr ? Explosion.DamageTypeClass : TSubclassOf<UDamageType>(UDamageType::StaticClass());
+			DamageEvent.Origin = Explosion.Origin;
+			DamageEvent.Params = FRadialDamageParams(Explosion.BaseDamage, 0.0f, 0.0f, Explosion.DamageRadius, Explosion.bDoFullDamage ? 0.0f : 1.0f);
+			DamageEvent.ComponentHits = MoveTemp(Victim.Value);
+
+			Victim.Key->TakeDamage(Explosion.BaseDamage, DamageEvent, Explosion.InstigatedBy.Get(), Explosion.DamageCauser.Get());
+		}
+	}
+
+	CurrentExplosion = OuterExplosion;
+}
+
+void USExplosionSubsystem::DeliverImpulse(const FSExplosion& Explosion, UPrimitiveComponent* Component) const
+{
+	Component->AddRadialImpulse(Explosion.ImpulseOrigin, Explosion.ImpulseRadius, Explosion.ImpulseStrength, Explosion.ImpulseFalloff, Explosion.bImpulseVelChange);
+
+	if (Component->bIgnoreRadialImpulse)
+		return;
+
+	// Movement components driving this component take the impulse too
+	TInlineComponentArray<UMovementComponent*> MovementComponents;
+	Component->GetOwner()->GetComponents<UMovementComponent>(MovementComponents);
+	for (UMovementComponent* MovementComponent : MovementComponents)
+	{
+		if (MovementComponent->UpdatedComponent == Component)
+		{
+			MovementComponent->AddRadialImpulse(Explosion.ImpulseOrigin, Explosion.ImpulseRadius, Explosion.ImpulseStrength, Explosion.ImpulseFalloff, Explosion.bImpulseVelChange);
+			break;
+		}
+	}
+}
+
+void USExplosionSubsystem::RunChainReactionBenchmark(int32 NumBarrels, float Spacing)
+{
+	UWorld* World = GetWorld();
+	APlayerController* PC = World->GetFirstPlayerController();
+	if (World->GetNetMode() == NM_Client || PC == nullptr || PC->GetPawn() == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Explosion benchmark: needs a server with a spawned player"));
+		return;
+	}
+
+	TActorIterator<ASExplosiveBarrel> It(World);
+	if (!It)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Explosion benchmark: no explosive barrel in the level to copy"));
+		return;
+	}
+	UClass* BarrelClass = It->GetClass();
+
+	// A grid of barrels in front of the player, each within blast range of its neighbours
+	APawn* Pawn = PC->GetPawn();
+	FVector Forward = Pawn->GetActorForwardVector() * Spacing;
+	FVector Right = Pawn->GetActorRightVector() * Spacing;
+	int32 NumColumns = FMath::CeilToInt(FMath::Sqrt((float)NumBarrels));
+	FVector Start = Pawn->GetActorLocation() + Pawn->GetActorForwardVector() * 600.0f - Right * (NumColumns - 1) * 0.5f;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	TArray<AActor*> Barrels;
+	for (int32 i = 0; i < NumBarrels; ++i)
+	{
+		FVector Location = Start + Right * (i % NumColumns) + Forward * (i / NumColumns);
+		AActor* Barrel = World->SpawnActor<AActor>(BarrelClass, FTransform(Location), SpawnParams);
+		if (Barrel != nullptr)
+			Barrels.Add(Barrel);
+	}
+
+	BenchmarkStartDetonations = NumDetonations;
+	WorstResolveMs = 0.0f;
+	BenchmarkStartTime = FPlatformTime::Seconds();
+
+	// Kill every barrel, each damages itself so team rules don't get in the way. Without batching they all resolve right here
+	for (AActor* Barrel : Barrels)
+	{
+		USHealthComponent* HealthComp = Barrel->FindComponentByClass<USHealthComponent>();
+		if (HealthComp != nullptr)
+			UGameplayStatics::ApplyDamage(Barrel, HealthComp->GetHealth(), nullptr, Barrel, nullptr);
+	}
+
+	bBenchmark = true;
+	BenchmarkNumBarrels = Barrels.Num();
+	BenchmarkFrames = 0;
+	BenchmarkIdleFrames = 0;
+	BenchmarkLastFrameTime = FPlatformTime::Seconds();
+	BenchmarkFirstFrameSeconds = BenchmarkLastFrameTime - BenchmarkStartTime;
+	BenchmarkWorstFrameSeconds = BenchmarkFirstFrameSeconds;
+}
+
+void USExplosionSubsystem::TickBenchmark()
+{
+	// Physics of the pushed barrels lands in the following frames too
+	double Now = FPlatformTime::Seconds();
+	BenchmarkWorstFrameSeconds = FMath::Max(BenchmarkWorstFrameSeconds, Now - BenchmarkLastFrameTime);
+	BenchmarkLastFrameTime = Now;
+	++BenchmarkFrames;
+
+	BenchmarkIdleFrames = Pending.Num() == 0 ? BenchmarkIdleFrames + 1 : 0;
+	if (BenchmarkIdleFrames < BenchmarkIdleFrameCount && BenchmarkFrames < BenchmarkMaxFrameCount)
+		return;
+
+	bBenchmark = false;
+
+	bool bBatched = IsBatchingEnabled();
+	UE_LOG(LogTemp, Log, TEXT("Explosion benchmark (%s): %d barrels, %d detonations over %d frames in %.2f s, detonating frame %.2f ms, worst frame %.2f ms, worst resolve %.2f ms (budget %.1f ms, %d per frame)"),
+		bBatched ? TEXT("scheduled") : TEXT("immediate"), BenchmarkNumBarrels, NumDetonations - BenchmarkStartDetonations,
+		BenchmarkFrames - BenchmarkIdleFrames, Now - BenchmarkStartTime, BenchmarkFirstFrameSeconds * 1000.0,
+		BenchmarkWorstFrameSeconds * 1000.0, WorstResolveMs, ExplosionBudgetMs, ExplosionMaxPerFrame);
+
+	if (bBatched && WorstResolveMs > ExplosionBudgetMs)
+		UE_LOG(LogTemp, Warning, TEXT("Explosion benchmark: worst resolve %.2f ms is over the %.1f ms budget, lower COOP.ExplosionBatchSize"), WorstResolveMs, ExplosionBudgetMs);
+}
@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SFXPoolSubsystem.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "SCosmetics.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopFXPool"), STATGROUP_CoopFXPool, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Hits"), STAT_FXPoolHits, STATGROUP_CoopFXPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Misses (Allocations)"), STAT_FXPoolMisses, STATGROUP_CoopFXPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Steals"), STAT_FXPoolSteals, STATGROUP_CoopFXPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Components"), STAT_FXPoolLiveComponents, STATGROUP_CoopFXPool);
+
+static int32 FXPooling = 1;
+FAutoConsoleVariableRef CVARFXPooling(
+	TEXT("COOP.FXPooling"),
+	FXPooling,
+	TEXT("Recycle weapon particle components (0 = spawn a new component for every effect)"),
+	ECVF_Default);
+
+static int32 FXPoolMaxPerTemplate = 32;
+FAutoConsoleVariableRef CVARFXPoolMaxPerTemplate(
+	TEXT("COOP.FXPoolMaxPerTemplate"),
+	FXPoolMaxPerTemplate,
+	TEXT("Max pooled particle components per template, the oldest playing one is stolen past this"),
+	ECVF_Default);
+
+// Totals since the last COOP.FXPoolReport
+static uint64 FXPoolHits = 0;
+static uint64 FXPoolMisses = 0;
+static uint64 FXPoolSteals = 0;
+static double FXPoolReportStartTime = 0.0;
+
+static FAutoConsoleCommandWithWorld FXPoolReportCmd(
+	TEXT("COOP.FXPoolReport"),
+	TEXT("Logs particle pool hits, misses (allocations) and steals per second since the last report and resets the counters"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		USFXPoolSubsystem* FXPool = World != nullptr ? World->GetSubsystem<USFXPoolSubsystem>() : nullptr;
+
+		double Now = FPlatformTime::Seconds();
+		double Elapsed = FXPoolReportStartTime > 0.0 ? FMath::Max(Now - FXPoolReportStartTime, 0.001) : 0.0;
+
+		UE_LOG(LogTemp, Log, TEXT("FX pool: %llu hits, %llu misses, %llu steals over %.1f s (%.1f allocations/s), %d live components"),
+			FXPoolHits, FXPoolMisses, FXPoolSteals, Elapsed, Elapsed > 0.0 ? FXPoolMisses / Elapsed : 0.0,
+			FXPool != nullptr ? FXPool->GetNumLiveComponents() : 0);
+
+		FXPoolHits = 0;
+		FXPoolMisses = 0;
+		FXPoolSteals = 0;
+		FXPoolReportStartTime = Now;
+	}));
+
+void USFXPoolSubsystem::Deinitialize()
+{
+	for (TPair<UParticleSystem*, FFXPool>& Pair : Pools)
+	{
+		for (UParticleSystemComponent* Comp : Pair.Value.Active)
+		{
+			if (Comp != nullptr)
+				Comp->DestroyComponent();
+		}
+		for (UParticleSystemComponent* Comp : Pair.Value.Free)
+		{
+			if (Comp != nullptr)
+				Comp->DestroyComponent();
+		}
+	}
+	Pools.Empty();
+
+	SET_DWORD_STAT(STAT_FXPoolLiveComponents, 0);
+	NumLiveComponents = 0;
+
+	Super::Deinitialize();
+}
+
+bool USFXPoolSubsystem::IsPoolingEnabled()
+{
+	return FXPooling > 0;
+}
+
+void USFXPoolSubsystem::Prewarm(UParticleSystem* Template, int32 Count)
+{
+	if (Template == nullptr || !IsPoolingEnabled() || !FSCosmetics::ShouldPlay(GetWorld()))
+		return;
+
+	FFXPool& Pool = Pools.FindOrAdd(Template);
+	Count = FMath::Min(Count, FXPoolMaxPerTemplate);
+
+	while (Pool.Active.Num() + Pool.Free.Num() < Count)
+	{
+		Pool.Free.Add(CreateComponent(Template));
+	}
+}
+
+UParticleSystemComponent* USFXPoolSubsystem::CreateComponent(UParticleSystem* Template)
+{
+	UParticleSystemComponent* Comp = NewObject<UParticleSystemComponent>(GetWorld());
+	Comp->bAutoDestroy = false;
+	Comp->bAutoActivate = false;
+	Comp->SetTemplate(Template);
+	Comp->OnSystemFinished.AddDynamic(this, &USFXPoolSubsystem::OnEmitterFinished);
+	Comp->RegisterComponentWithWorld(GetWorld());
+
+	++NumLiveComponents;
+	INC_DWORD_STAT(STAT_FXPoolLiveComponents);
+
+	return Comp;
+}
+
+UParticleSystemComponent* USFXPoolSubsystem::Acquire(UParticleSystem* Template)
+{
+	FFXPool& Pool = Pools.FindOrAdd(Template);
+
+	UParticleSystemComponent* Comp = nullptr;
+	if (Pool.Free.Num() > 0)
+	{
+		Comp = Pool.Free.Pop(false);
+
+		++FXPoolHits;
+		INC_DWORD_STAT(STAT_FXPoolHits);
+	}
+	else if (Pool.Active.Num() < FXPoolMaxPerTemplate)
+	{
+		Comp = CreateComponent(Template);
+
+		++FXPoolMisses;
+		INC_DWORD_STAT(STAT_FXPoolMisses);
+	}
+	else
+	{
+		// Steal the oldest playing component
+		Comp = Pool.Active[0];
+		Pool.Active.RemoveAt(0, 1, false);
+		Comp->KillParticlesForced();
+
+		++FXPoolSteals;
+		INC_DWORD_STAT(STAT_FXPoolSteals);
+	}
+
+	Pool.Active.Add(Comp);
+	return Comp;
+}
+
+void USFXPoolSubsystem::OnEmitterFinished(UParticleSystemComponent* PSystem)
+{
+	FFXPool* Pool = PSystem != nullptr ? Pools.Find(PSystem->Template) : nullptr;
+
+	// Stolen components finish while they are being reused
+	if (Pool != nullptr && Pool->Active.RemoveSingle(PSystem) > 0)
+	{
+		if (PSystem->GetAttachParent() != nullptr)
+			PSystem->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+		Pool->Free.Add(PSystem);
+	}
+}
+
+UParticleSystemComponent* USFXPoolSubsystem::SpawnEmitterAtLocation(UWorld* World, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation)
+{
+	if (World == nullptr || Template == nullptr || !FSCosmetics::ShouldPlay(World))
+		return nullptr;
+
+	USFXPoolSubsystem* FXPool = World->GetSubsystem<USFXPoolSubsystem>();
+	if (FXPool == nullptr || !IsPoolingEnabled())
+	{
+		++FXPoolMisses;
+		INC_DWORD_STAT(STAT_FXPoolMisses);
+		return UGameplayStatics::SpawnEmitterAtLocation(World, Template, Location, Rotation);
+	}
+
+	UParticleSystemComponent* Comp = FXPool->Acquire(Template);
+	if (Comp->GetAttachParent() != nullptr)
+		Comp->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+	Comp->SetWorldLocationAndRotation(Location, Rotation);
+	Comp->ActivateSystem(true);
+
+	return Comp;
+}
+
+UParticleSystemComponent* USFXPoolSubsystem::SpawnEmitterAttached(UWorld* World, UParticleSystem* Template, USceneComponent* AttachToComponent, FName AttachPointName)
+{
+	if (World == nullptr || Template == nullptr || AttachToComponent == nullptr || !FSCosmetics::ShouldPlay(World))
+		return nullptr;
+
+	USFXPoolSubsystem* FXPool = World->GetSubsystem<USFXPoolSubsystem>();
+	if (FXPool == nullptr || !IsPoolingEnabled())
+	{
+		++FXPoolMisses;
+		INC_DWORD_STAT(STAT_FXPoolMisses);
+		return UGameplayStatics::SpawnEmitterAttached(Template, AttachToComponent, AttachPointName);
+	}
+
+	UParticleSystemComponent* Comp = FXPool->Acquire(Template);
+	Comp->AttachToComponent(AttachToComponent, FAttachmentTransformRules::SnapToTargetNotIncludingScale, AttachPointName);
+	Comp->ActivateSystem(true);
+
+	return Comp;
+}
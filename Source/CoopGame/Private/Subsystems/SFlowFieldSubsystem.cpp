@@ -0,0 +1,513 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SFlowFieldSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopFlowField"), STATGROUP_CoopFlowField, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Build Fields"), STAT_FlowFieldBuild, STATGROUP_CoopFlowField);
+DECLARE_CYCLE_STAT(TEXT("Sample"), STAT_FlowFieldSample, STATGROUP_CoopFlowField);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fields Completed"), STAT_FlowFieldsCompleted, STATGROUP_CoopFlowField);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active Fields"), STAT_FlowFieldsActive, STATGROUP_CoopFlowField);
+
+static float FlowFieldCellSize = 100.0f;
+FAutoConsoleVariableRef CVARFlowFieldCellSize(
+	TEXT("COOP.FlowFieldCellSize"),
+	FlowFieldCellSize,
+	TEXT("Flow field grid cell size, grown automatically if the navmesh needs more than COOP.FlowFieldMaxCells cells (read when the grid is built)"),
+	ECVF_Default);
+
+static int32 FlowFieldMaxCells = 256 * 256;
+FAutoConsoleVariableRef CVARFlowFieldMaxCells(
+	TEXT("COOP.FlowFieldMaxCells"),
+	FlowFieldMaxCells,
+	TEXT("Max flow field grid cells (read when the grid is built)"),
+	ECVF_Default);
+
+static float FlowFieldBuildBudgetMs = 1.0f;
+FAutoConsoleVariableRef CVARFlowFieldBuildBudgetMs(
+	TEXT("COOP.FlowFieldBuildBudgetMs"),
+	FlowFieldBuildBudgetMs,
+	TEXT("Milliseconds per frame spent building the grid and rebuilding flow fields for moved targets"),
+	ECVF_Default);
+
+static int32 FlowFieldLookAhead = 3;
+FAutoConsoleVariableRef CVARFlowFieldLookAhead(
+	TEXT("COOP.FlowFieldLookAhead"),
+	FlowFieldLookAhead,
+	TEXT("Cells a bot looks ahead along the flow field for its next steering point"),
+	ECVF_Default);
+
+// Fields nobody sampled for this long are dropped
+static const float FlowFieldUnusedTime = 5.0f;
+
+static const uint8 NoDirection = 0xFF;
+
+static FAutoConsoleCommandWithWorldAndArgs FlowFieldBenchmarkCmd(
+	TEXT("COOP.FlowFieldBenchmark"),
+	TEXT("Logs the cost of per bot path queries against a shared flow field. Usage: COOP.FlowFieldBenchmark [BotCount...] (default 50 200 1000)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USFlowFieldSubsystem* FlowField = World != nullptr ? World->GetSubsystem<USFlowFieldSubsystem>() : nullptr;
+		if (FlowField == nullptr)
+			return;
+
+		TArray<int32> BotCounts;
+		for (const FString& Arg : Args)
+		{
+			BotCounts.Add(FMath::Max(FCString::Atoi(*Arg), 1));
+		}
+		if (BotCounts.Num() == 0)
+			BotCounts = { 50, 200, 1000 };
+
+		FlowField->RunBenchmark(BotCounts);
+	}));
+
+const FIntPoint FFlowFieldGrid::DirectionOffsets[8] =
+{
+	FIntPoint(1, 0), FIntPoint(1, 1), FIntPoint(0, 1), FIntPoint(-1, 1),
+	FIntPoint(-1, 0), FIntPoint(-1, -1), FIntPoint(0, -1), FIntPoint(1, -1)
+};
+
+bool FFlowFieldGrid::BeginBuild(UWorld* World, float InCellSize, int32 MaxCells)
+{
+	SizeX = 0;
+	SizeY = 0;
+	Heights.Empty();
+	Links.Empty();
+	bBuilding = false;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	if (NavSys == nullptr || NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) == nullptr)
+		return false;
+
+	FBox Bounds(ForceInit);
+	for (const FNavigationBounds& NavBounds : NavSys->GetNavigationBounds())
+	{
+		Bounds += NavBounds.AreaBox;
+	}
+	if (!Bounds.IsValid)
+		return false;
+
+	// Grow the cells until the grid fits the budget
+	CellSize = FMath::Max(InCellSize, 10.0f);
+	FVector Size = Bounds.GetSize();
+	while (FMath::CeilToInt(Size.X / CellSize) * FMath::CeilToInt(Size.Y / CellSize) > FMath::Max(MaxCells, 1))
+	{
+		CellSize *= 1.5f;
+	}
+
+	Origin = Bounds.Min;
+	SizeX = FMath::Max(FMath::CeilToInt(Size.X / CellSize), 1);
+	SizeY = FMath::Max(FMath::CeilToInt(Size.Y / CellSize), 1);
+	Heights.SetNumUninitialized(SizeX * SizeY);
+	Links.SetNumZeroed(SizeX * SizeY);
+
+	Walkable.Init(false, SizeX * SizeY);
+	ProjectExtent = FVector(CellSize * 0.5f, CellSize * 0.5f, Size.Z * 0.5f);
+	ProjectZ = Bounds.GetCenter().Z;
+	MinZ = Bounds.Min.Z;
+
+	bBuilding = true;
+	BuildStep = 0;
+	return true;
+}
+
+bool FFlowFieldGrid::StepBuild(UWorld* World, double EndTime)
+{
+	if (!bBuilding)
+		return true;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	if (NavSys == nullptr)
+	{
+		// Navigation went away mid build, leave the grid invalid
+		SizeX = 0;
+		SizeY = 0;
+		bBuilding = false;
+		Walkable.Empty();
+		return true;
+	}
+
+	int32 NumCells = SizeX * SizeY;
+	while (BuildStep < NumCells * 2)
+	{
+		// Every step is a navmesh query, far slower than checking the clock
+		if (FPlatformTime::Seconds() > EndTime)
+			return false;
+
+		if (BuildStep < NumCells)
+		{
+			// Project the cell center onto the navmesh
+			int32 Cell = BuildStep;
+			FVector Center(Origin.X + (Cell % SizeX + 0.5f) * CellSize, Origin.Y + (Cell / SizeX + 0.5f) * CellSize, ProjectZ);
+
+			FNavLocation NavLocation;
+			if (NavSys->ProjectPointToNavigation(Center, NavLocation, ProjectExtent))
+			{
+				Heights[Cell] = NavLocation.Location.Z;
+				Walkable[Cell] = true;
+			}
+			else
+			{
+				Heights[Cell] = MinZ;
+			}
+		}
+		else
+		{
+			// Link neighbours that can see each other over the navmesh, half of the directions are mirrored
+			int32 Cell = BuildStep - NumCells;
+			int32 X = Cell % SizeX;
+			int32 Y = Cell / SizeX;
+
+			for (int32 Direction = 0; Walkable[Cell] && Direction < 4; ++Direction)
+			{
+				int32 NX = X + DirectionOffsets[Direction].X;
+				int32 NY = Y + DirectionOffsets[Direction].Y;
+				if (NX < 0 || NX >= SizeX || NY < 0 || NY >= SizeY)
+					continue;
+
+				int32 Neighbour = NY * SizeX + NX;
+				if (!Walkable[Neighbour] || FMath::Abs(Heights[Cell] - Heights[Neighbour]) > CellSize)
+					continue;
+
+				FVector HitLocation;
+				if (UNavigationSystemV1::NavigationRaycast(World, GetCellLocation(Cell), GetCellLocation(Neighbour), HitLocation))
+					continue;
+
+				Links[Cell] |= 1 << Direction;
+				Links[Neighbour] |= 1 << (Direction + 4);
+			}
+		}
+
+		++BuildStep;
+	}
+
+	bBuilding = false;
+	Walkable.Empty();
+	return true;
+}
+
+int32 FFlowFieldGrid::FindCell(const FVector& Location) const
+{
+	if (!IsValid())
+		return INDEX_NONE;
+
+	int32 X = FMath::FloorToInt((Location.X - Origin.X) / CellSize);
+	int32 Y = FMath::FloorToInt((Location.Y - Origin.Y) / CellSize);
+	if (X < 0 || X >= SizeX || Y < 0 || Y >= SizeY)
+		return INDEX_NONE;
+
+	int32 Cell = Y * SizeX + X;
+	return Links[Cell] != 0 ? Cell : INDEX_NONE;
+}
+
+FVector FFlowFieldGrid::GetCellLocation(int32 Cell) const
+{
+	return FVector(Origin.X + (Cell % SizeX + 0.5f) * CellSize, Origin.Y + (Cell / SizeX + 0.5f) * CellSize, Heights[Cell]);
+}
+
+int32 FFlowFieldGrid::GetNeighbour(int32 Cell, int32 Direction) const
+{
+	uint8 CellLinks = Links[Cell];
+	if ((CellLinks & (1 << Direction)) == 0)
+		return INDEX_NONE;
+
+	// No cutting corners on diagonals
+	if ((Direction & 1) != 0 && ((CellLinks & (1 << ((Direction + 7) & 7))) == 0 || (CellLinks & (1 << ((Direction + 1) & 7))) == 0))
+		return INDEX_NONE;
+
+	return Cell + DirectionOffsets[Direction].Y * SizeX + DirectionOffsets[Direction].X;
+}
+
+void FFlowField::BeginBuild(const FFlowFieldGrid& Grid, int32 InGoalCell)
+{
+	bBuilding = true;
+	BuildGoalCell = InGoalCell;
+
+	BuildDistances.Init(FLT_MAX, Grid.GetNumCells());
+	BuildDirections.Init(NoDirection, Grid.GetNumCells());
+	OpenCells.Reset();
+
+	BuildDistances[InGoalCell] = 0.0f;
+	OpenCells.HeapPush(FOpenCell{ 0.0f, InGoalCell });
+}
+
+bool FFlowField::StepBuild(const FFlowFieldGrid& Grid, double EndTime)
+{
+	if (!bBuilding)
+		return true;
+
+	int32 NumExpanded = 0;
+	while (OpenCells.Num() > 0)
+	{
+		// Checking the clock is slower than expanding a cell
+		if ((++NumExpanded & 63) == 0 && FPlatformTime::Seconds() > EndTime)
+			return false;
+
+		FOpenCell Open;
+		OpenCells.HeapPop(Open, false);
+		if (Open.Distance > BuildDistances[Open.Cell])
+			continue;
+
+		for (int32 Direction = 0; Direction < 8; ++Direction)
+		{
+			int32 Neighbour = Grid.GetNeighbour(Open.Cell, Direction);
+			if (Neighbour == INDEX_NONE)
+				continue;
+
+			float Distance = Open.Distance + ((Direction & 1) != 0 ? UE_SQRT_2 : 1.0f);
+			if (Distance < BuildDistances[Neighbour])
+			{
+				BuildDistances[Neighbour] = Distance;
+
+				// Neighbour steps back towards the expanded cell
+				BuildDirections[Neighbour] = (Direction + 4) & 7;
+				OpenCells.HeapPush(FOpenCell{ Distance, Neighbour });
+			}
+		}
+	}
+
+	// Swap the finished field in
+	bBuilding = false;
+	GoalCell = BuildGoalCell;
+	Swap(Directions, BuildDirections);
+	BuildDistances.Empty();
+	BuildDirections.Empty();
+	return true;
+}
+
+bool FFlowField::Sample(const FFlowFieldGrid& Grid, int32 Cell, int32 LookAhead, int32& OutCell) const
+{
+	if (!IsValid() || Cell == INDEX_NONE)
+		return false;
+
+	if (Cell != GoalCell && Directions[Cell] == NoDirection)
+		return false;
+
+	for (int32 Step = 0; Step < LookAhead && Cell != GoalCell; ++Step)
+	{
+		int32 Next = Grid.GetNeighbour(Cell, Directions[Cell]);
+		if (Next == INDEX_NONE)
+			break;
+
+		Cell = Next;
+	}
+
+	OutCell = Cell;
+	return true;
+}
+
+void USFlowFieldSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_FlowFieldsActive, Fields.Num());
+	Fields.Empty();
+
+	Super::Deinitialize();
+}
+
+void USFlowFieldSubsystem::StepGridBuild(double EndTime)
+{
+	double StartTime = FPlatformTime::Seconds();
+
+	if (!bGridBuildStarted)
+	{
+		bGridBuildStarted = true;
+		GridBuildSeconds = 0.0;
+		GridBuildFrames = 0;
+
+		if (!Grid.BeginBuild(GetWorld(), FlowFieldCellSize, FlowFieldMaxCells))
+			return;
+	}
+
+	bool bFinished = Grid.StepBuild(GetWorld(), EndTime);
+
+	GridBuildSeconds += FPlatformTime::Seconds() - StartTime;
+	++GridBuildFrames;
+
+	if (bFinished && Grid.IsValid())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Flow field grid: %d cells of %.0f units built in %.2f ms over %d frames"),
+			Grid.GetNumCells(), Grid.GetCellSize(), GridBuildSeconds * 1000.0, GridBuildFrames);
+	}
+}
+
+void USFlowFieldSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldBuild);
+
+	float Now = GetWorld()->GetTimeSeconds();
+	double EndTime = FPlatformTime::Seconds() + FlowFieldBuildBudgetMs / 1000.0;
+
+	// Bots keep using their paths until the grid is ready, no field can exist before it
+	if (!bGridBuildStarted || Grid.IsBuilding())
+	{
+		StepGridBuild(EndTime);
+		return;
+	}
+
+	for (auto It = Fields.CreateIterator(); It; ++It)
+	{
+		AActor* Target = It->Key.Get();
+		FTargetField& TargetField = It->Value;
+		if (Target == nullptr || Now - TargetField.LastSampleTime > FlowFieldUnusedTime)
+		{
+			DEC_DWORD_STAT(STAT_FlowFieldsActive);
+			It.RemoveCurrent();
+			continue;
+		}
+
+		// Finish the current build before following the target again, restarting on every move would never finish
+		if (!TargetField.Field.IsBuilding())
+		{
+			int32 TargetCell = FindTargetCell(Target);
+			if (TargetCell == INDEX_NONE || TargetCell == TargetField.Field.GetGoalCell())
+				continue;
+
+			TargetField.Field.BeginBuild(Grid, TargetCell);
+		}
+
+		if (FPlatformTime::Seconds() > EndTime)
+			continue;
+
+		if (TargetField.Field.StepBuild(Grid, EndTime))
+			INC_DWORD_STAT(STAT_FlowFieldsCompleted);
+	}
+}
+
+bool USFlowFieldSubsystem::IsTickable() const
+{
+	// Only the server moves bots, the grid is built as soon as the world begins play
+	UWorld* World = GetWorld();
+	return !IsTemplate() && World != nullptr && World->GetNetMode() != NM_Client && World->HasBegunPlay()
+		&& (Fields.Num() > 0 || !bGridBuildStarted || Grid.IsBuilding());
+}
+
+TStatId USFlowFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USFlowFieldSubsystem, STATGROUP_Tickables);
+}
+
+int32 USFlowFieldSubsystem::FindTargetCell(AActor* Target) const
+{
+	FVector Location = Target->GetActorLocation();
+	int32 Cell = Grid.FindCell(Location);
+	if (Cell != INDEX_NONE)
+		return Cell;
+
+	// Target is jumping over a gap or hugging a wall, try the cells around it
+	for (const FIntPoint& Offset : FFlowFieldGrid::DirectionOffsets)
+	{
+		Cell = Grid.FindCell(Location + FVector(Offset.X, Offset.Y, 0.0f) * Grid.GetCellSize());
+		if (Cell != INDEX_NONE)
+			return Cell;
+	}
+
+	return INDEX_NONE;
+}
+
+bool USFlowFieldSubsystem::SampleNextPoint(AActor* Target, const FVector& Location, FVector& OutPoint)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldSample);
+
+	if (Target == nullptr || !Grid.IsValid())
+		return false;
+
+	FTargetField* TargetField = Fields.Find(Target);
+	if (TargetField == nullptr)
+	{
+		// Built from the next tick on
+		TargetField = &Fields.Add(Target);
+		INC_DWORD_STAT(STAT_FlowFieldsActive);
+	}
+	TargetField->LastSampleTime = GetWorld()->GetTimeSeconds();
+
+	int32 NextCell;
+	if (!TargetField->Field.Sample(Grid, Grid.FindCell(Location), FlowFieldLookAhead, NextCell))
+		return false;
+
+	OutPoint = NextCell == TargetField->Field.GetGoalCell() ? Target->GetActorLocation() : Grid.GetCellLocation(NextCell);
+	return true;
+}
+
+void USFlowFieldSubsystem::RunBenchmark(const TArray<int32>& BotCounts)
+{
+	UWorld* World = GetWorld();
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	ANavigationData* NavData = NavSys != nullptr ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+	// The benchmark doesn't mind a hitch, finish the grid now
+	if (NavData != nullptr && (!bGridBuildStarted || Grid.IsBuilding()))
+		StepGridBuild(DBL_MAX);
+
+	if (NavData == nullptr || !Grid.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FlowField benchmark: no navmesh"));
+		return;
+	}
+
+	FRandomStream Stream(1234);
+
+	// Chase the first player if there is one, a random walkable cell otherwise
+	int32 GoalCell = INDEX_NONE;
+	APlayerController* PC = World->GetFirstPlayerController();
+	if (PC != nullptr && PC->GetPawn() != nullptr)
+		GoalCell = FindTargetCell(PC->GetPawn());
+
+	TArray<int32> WalkableCells;
+	for (int32 Cell = 0; Cell < Grid.GetNumCells(); ++Cell)
+	{
+		if (Grid.FindCell(Grid.GetCellLocation(Cell)) == Cell)
+			WalkableCells.Add(Cell);
+	}
+	if (WalkableCells.Num() == 0)
+		return;
+
+	if (GoalCell == INDEX_NONE)
+		GoalCell = WalkableCells[Stream.RandHelper(WalkableCells.Num())];
+
+	FVector Goal = Grid.GetCellLocation(GoalCell);
+
+	for (int32 NumBots : BotCounts)
+	{
+		TArray<FVector> Starts;
+		for (int32 i = 0; i < NumBots; ++i)
+		{
+			Starts.Add(Grid.GetCellLocation(WalkableCells[Stream.RandHelper(WalkableCells.Num())]));
+		}
+
+		// One synchronous path query per bot
+		int32 NumPaths = 0;
+		double StartTime = FPlatformTime::Seconds();
+		for (const FVector& Start : Starts)
+		{
+			FPathFindingQuery Query(this, *NavData, Start, Goal);
+			if (NavSys->FindPathSync(Query).IsSuccessful())
+				++NumPaths;
+		}
+		double PathMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		// One field build shared by every bot, then one sample each
+		StartTime = FPlatformTime::Seconds();
+		FFlowField Field;
+		Field.BeginBuild(Grid, GoalCell);
+		Field.StepBuild(Grid, DBL_MAX);
+		double BuildMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		int32 NumReached = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (const FVector& Start : Starts)
+		{
+			int32 NextCell;
+			if (Field.Sample(Grid, Grid.FindCell(Start), FlowFieldLookAhead, NextCell))
+				++NumReached;
+		}
+		double SampleMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		UE_LOG(LogTemp, Log, TEXT("FlowField benchmark: %d bots, per bot paths %.2f ms (%d found), flow field %.2f ms (build %.2f ms, sampling %.3f ms, %d reachable)"),
+			NumBots, PathMs, NumPaths, BuildMs + SampleMs, BuildMs, SampleMs, NumReached);
+	}
+}
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SHealthRegistrySubsystem.h"
+#include "Engine/World.h"
+#include "Components/SHealthComponent.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopHealthRegistry"), STATGROUP_CoopHealthRegistry, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Registered Components"), STAT_HealthRegistryComponents, STATGROUP_CoopHealthRegistry);
+
+static FAutoConsoleCommandWithWorldAndArgs IsFriendlyBenchmarkCmd(
+	TEXT("COOP.IsFriendlyBenchmark"),
+	TEXT("Logs the cost of IsFriendly through component lookups against the health registry. Usage: COOP.IsFriendlyBenchmark [NumChecks=100000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USHealthRegistrySubsystem* Registry = World != nullptr ? World->GetSubsystem<USHealthRegistrySubsystem>() : nullptr;
+		if (Registry != nullptr)
+			Registry->RunIsFriendlyBenchmark(FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000, 1));
+	}));
+
+void USHealthRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FMemory::Memzero(AliveCounts);
+}
+
+void USHealthRegistrySubsystem::Deinitialize()
+{
+	for (USHealthComponent* HealthComp : Components)
+	{
+		if (HealthComp != nullptr)
+			HealthComp->RegistryHandle = INDEX_NONE;
+	}
+
+	DEC_DWORD_STAT_BY(STAT_HealthRegistryComponents, Components.Num());
+
+	Components.Empty();
+	Owners.Empty();
+	Teams.Empty();
+	Alive.Empty();
+	OwnerHandles.Empty();
+
+	Super::Deinitialize();
+}
+
+int32 USHealthRegistrySubsystem::Register(USHealthComponent* HealthComp)
+{
+	if (HealthComp == nullptr || HealthComp->RegistryHandle != INDEX_NONE)
+		return HealthComp != nullptr ? HealthComp->RegistryHandle : INDEX_NONE;
+
+	int32 Handle = Components.Add(HealthComp);
+	Owners.Add(HealthComp->GetOwner());
+	Teams.Add(HealthComp->TeamNum);
+	Alive.Add(HealthComp->GetHealth() > 0.0f);
+
+	if (Alive[Handle])
+		++AliveCounts[HealthComp->TeamNum];
+
+	// First health component of an actor wins, same as GetComponentByClass
+	if (HealthComp->GetOwner() != nullptr && !OwnerHandles.Contains(HealthComp->GetOwner()))
+		OwnerHandles.Add(HealthComp->GetOwner(), Handle);
+
+	HealthComp->RegistryHandle = Handle;
+	INC_DWORD_STAT(STAT_HealthRegistryComponents);
+
+	if (Alive[Handle])
+		OnAliveChanged.Broadcast(HealthComp, true);
+
+	return Handle;
+}
+
+void USHealthRegistrySubsystem::Unregister(USHealthComponent* HealthComp)
+{
+	if (HealthComp == nullptr || !Components.IsValidIndex(HealthComp->RegistryHandle) || Components[HealthComp->RegistryHandle] != HealthComp)
+		return;
+
+	int32 Handle = HealthComp->RegistryHandle;
+	bool bWasAlive = Alive[Handle] != 0;
+	if (bWasAlive)
+		--AliveCounts[Teams[Handle]];
+
+	const int32* OwnerHandle = OwnerHandles.Find(Owners[Handle]);
+	if (OwnerHandle != nullptr && *OwnerHandle == Handle)
+		OwnerHandles.Remove(Owners[Handle]);
+
+	// Swap the last component into the hole
+	int32 LastHandle = Components.Num() - 1;
+	if (Handle != LastHandle)
+	{
+		int32* MovedOwnerHandle = OwnerHandles.Find(Owners[LastHandle]);
+		if (MovedOwnerHandle != nullptr && *MovedOwnerHandle == LastHandle)
+			*MovedOwnerHandle = Handle;
+
+		Components[LastHandle]->RegistryHandle = Handle;
+	}
+
+	Components.RemoveAtSwap(Handle, 1, false);
+	Owners.RemoveAtSwap(Handle, 1, false);
+	Teams.RemoveAtSwap(Handle, 1, false);
+	Alive.RemoveAtSwap(Handle, 1, false);
+
+	HealthComp->RegistryHandle = INDEX_NONE;
+	DEC_DWORD_STAT(STAT_HealthRegistryComponents);
+
+	if (bWasAlive)
+		OnAliveChanged.Broadcast(HealthComp, false);
+}
+
+void USHealthRegistrySubsystem::UpdateAlive(USHealthComponent* HealthComp)
+{
+	if (HealthComp == nullptr || !Components.IsValidIndex(HealthComp->RegistryHandle))
+		return;
+
+	int32 Handle = HealthComp->RegistryHandle;
+	uint8 bAlive = HealthComp->GetHealth() > 0.0f;
+	if (bAlive == Alive[Handle])
+		return;
+
+	Alive[Handle] = bAlive;
+	AliveCounts[Teams[Handle]] += bAlive ? 1 : -1;
+
+	OnAliveChanged.Broadcast(HealthComp, bAlive != 0);
+}
+
+int32 USHealthRegistrySubsystem::FindHandle(const AActor* Actor) const
+{
+	const int32* Handle = OwnerHandles.Find(Actor);
+	return Handle != nullptr ? *Handle : INDEX_NONE;
+}
+
+USHealthComponent* USHealthRegistrySubsystem::FindHealthComponent(const AActor* Actor) const
+{
+	const int32* Handle = OwnerHandles.Find(Actor);
+	return Handle != nullptr ? Components[*Handle] : nullptr;
+}
+
+void USHealthRegistrySubsystem::RunIsFriendlyBenchmark(int32 NumChecks) const
+{
+	if (Owners.Num() < 2)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("IsFriendly benchmark: needs at least two actors with health components"));
+		return;
+	}
+
+	FRandomStream Stream(1234);
+	TArray<int32> Pairs;
+	Pairs.Reserve(NumChecks * 2);
+	for (int32 i = 0; i < NumChecks * 2; ++i)
+	{
+		Pairs.Add(Stream.RandHelper(Owners.Num()));
+	}
+
+	// Old path, two component searches per check
+	int32 NumFriendly = 0;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < NumChecks; ++i)
+	{
+		USHealthComponent* HealthCompA = Cast<USHealthComponent>(Owners[Pairs[i * 2]]->GetComponentByClass(USHealthComponent::StaticClass()));
+		USHealthComponent* HealthCompB = Cast<USHealthComponent>(Owners[Pairs[i * 2 + 1]]->GetComponentByClass(USHealthComponent::StaticClass()));
+		if (HealthCompA == nullptr || HealthCompB == nullptr || HealthCompA->TeamNum == HealthCompB->TeamNum)
+			++NumFriendly;
+	}
+	double ComponentNs = (FPlatformTime::Seconds() - StartTime) * 1.0e9 / NumChecks;
+
+	// What USHealthComponent::IsFriendly does now
+	StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < NumChecks; ++i)
+	{
+		if (USHealthComponent::IsFriendly(Owners[Pairs[i * 2]], Owners[Pairs[i * 2 + 1]]))
+			++NumFriendly;
+	}
+	double ActorNs = (FPlatformTime::Seconds() - StartTime) * 1.0e9 / NumChecks;
+
+	// Callers that already hold handles
+	StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < NumChecks; ++i)
+	{
+		if (IsFriendly(Pairs[i * 2], Pairs[i * 2 + 1]))
+			++NumFriendly;
+	}
+	double HandleNs = (FPlatformTime::Seconds() - StartTime) * 1.0e9 / NumChecks;
+
+	UE_LOG(LogTemp, Log, TEXT("IsFriendly benchmark: %d checks over %d actors, component lookup %.1f ns, registry by actor %.1f ns, registry by handle %.1f ns (%d friendly)"),
+		NumChecks, Owners.Num(), ComponentNs, ActorNs, HandleNs, NumFriendly);
+}
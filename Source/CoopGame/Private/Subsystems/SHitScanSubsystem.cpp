@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SHitScanSubsystem.h"
+#include "CoopGame\CoopGame.h"
+#include "SWeapon.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shots Queued"), STAT_HitScanShotsQueued, STATGROUP_CoopHitScan);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shots Resolved"), STAT_HitScanShotsResolved, STATGROUP_CoopHitScan);
+DECLARE_CYCLE_STAT(TEXT("Queue Shot"), STAT_HitScanQueueShot, STATGROUP_CoopHitScan);
+DECLARE_CYCLE_STAT(TEXT("Resolve Shot"), STAT_HitScanResolveShot, STATGROUP_CoopHitScan);
+
+static int32 HitScanBatching = 1;
+FAutoConsoleVariableRef CVARHitScanBatching(
+	TEXT("COOP.HitScanBatching"),
+	HitScanBatching,
+	TEXT("Resolve server hitscan shots with batched async traces (0 = synchronous trace per shot)"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs HitScanBenchmarkCmd(
+	TEXT("COOP.HitScanBenchmark"),
+	TEXT("Traces N shots from the first player view, synchronously and batched, and logs traces per millisecond from dispatch to results and on the game thread. Usage: COOP.HitScanBenchmark [NumShots=1000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USHitScanSubsystem* HitScan = World != nullptr ? World->GetSubsystem<USHitScanSubsystem>() : nullptr;
+		APlayerController* PC = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+		if (HitScan == nullptr || PC == nullptr)
+			return;
+
+		int32 NumShots = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		PC->GetPlayerViewPoint(EyeLocation, EyeRotation);
+
+		HitScan->RunBenchmark(EyeLocation, EyeRotation.Vector(), FMath::Max(NumShots, 1), 5.0f);
+	}));
+
+void USHitScanSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TraceDelegate.BindUObject(this, &USHitScanSubsystem::OnTraceCompleted);
+
+	NextShotId = 0;
+	BenchmarkShotsPending = 0;
+	BenchmarkShotsTotal = 0;
+	BenchmarkDispatchSeconds = 0.0;
+	BenchmarkStartTime = 0.0;
+	BenchmarkStartFrame = 0;
+	BenchmarkDeliverySeconds = 0.0;
+	BenchmarkLastResultTime = 0.0;
+	BenchmarkLastResultFrame = 0;
+}
+
+void USHitScanSubsystem::Deinitialize()
+{
+	TraceDelegate.Unbind();
+	ShotsInFlight.Empty();
+
+	Super::Deinitialize();
+}
+
+bool USHitScanSubsystem::IsBatchingEnabled()
+{
+	return HitScanBatching > 0;
+}
+
+void USHitScanSubsystem::QueueShot(const FHitScanRequest& Request)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HitScanQueueShot);
+	INC_DWORD_STAT(STAT_HitScanShotsQueued);
+
+	// The async trace buffer is kicked off once at the end of the world tick, so every shot queued this frame
+	// is traced together on the worker threads and handed back in a single pass at the start of the next frame
+	uint32 ShotId = ++NextShotId;
+	ShotsInFlight.Add(ShotId, Request);
+
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Request.TraceStart, Request.TraceEnd, COLLISION_WEAPON,
+		Request.QueryParams, FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, ShotId);
+}
+
+void USHitScanSubsystem::OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HitScanResolveShot);
+	INC_DWORD_STAT(STAT_HitScanShotsResolved);
+
+	FHitScanRequest Request;
+	if (!ShotsInFlight.RemoveAndCopyValue(Datum.UserData, Request))
+		return;
+
+	if (Request.bBenchmark)
+	{
+		// Results come back in one pass on the game thread, the first one of a frame only starts the clock
+		double Now = FPlatformTime::Seconds();
+		if (BenchmarkLastResultFrame == GFrameCounter)
+			BenchmarkDeliverySeconds += Now - BenchmarkLastResultTime;
+
+		BenchmarkLastResultTime = Now;
+		BenchmarkLastResultFrame = GFrameCounter;
+
+		if (--BenchmarkShotsPending == 0)
+		{
+			double ElapsedMs = (Now - BenchmarkStartTime) * 1000.0;
+			double DispatchMs = BenchmarkDispatchSeconds * 1000.0;
+			double DeliveryMs = BenchmarkDeliverySeconds * 1000.0;
+			UE_LOG(LogTemp, Log, TEXT("HitScan benchmark (batched): %d traces, dispatch to last result %.3f ms over %llu frame(s) (%.1f traces/ms), game thread %.3f ms (dispatch %.3f ms, delivery %.3f ms, %.1f traces/ms)"),
+				BenchmarkShotsTotal, ElapsedMs, GFrameCounter - BenchmarkStartFrame, BenchmarkShotsTotal / FMath::Max(ElapsedMs, 0.001),
+				DispatchMs + DeliveryMs, DispatchMs, DeliveryMs, BenchmarkShotsTotal / FMath::Max(DispatchMs + DeliveryMs, 0.001));
+		}
+		return;
+	}
+
+	ASWeapon* Weapon = Request.Weapon.Get();
+	if (Weapon == nullptr)
+		return;
+
+	const FHitResult* Hit = Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit ? &Datum.OutHits[0] : nullptr;
+	Weapon->ProcessHitScan(Request.TraceStart, Request.TraceEnd, Request.ShotDirection, Hit, Request.RewindTime);
+}
+
+void USHitScanSubsystem::RunBenchmark(const FVector& Origin, const FVector& Direction, int32 NumShots, float SpreadDegrees)
+{
+	if (BenchmarkShotsPending > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("HitScan benchmark already running"));
+		return;
+	}
+
+	float HalfRad = FMath::DegreesToRadians(SpreadDegrees);
+
+	TArray<FVector> TraceEnds;
+	TraceEnds.Reserve(NumShots);
+	for (int32 i = 0; i < NumShots; ++i)
+	{
+		TraceEnds.Add(Origin + FMath::VRandCone(Direction, HalfRad, HalfRad) * 10000.0f);
+	}
+
+	FCollisionQueryParams QueryParams;
+	QueryParams.bTraceComplex = true;
+	QueryParams.bReturnPhysicalMaterial = true;
+
+	// Current per-shot path
+	double StartTime = FPlatformTime::Seconds();
+	for (const FVector& TraceEnd : TraceEnds)
+	{
+		FHitResult Hit;
+		GetWorld()->LineTraceSingleByChannel(Hit, Origin, TraceEnd, COLLISION_WEAPON, QueryParams);
+	}
+	double SyncMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	UE_LOG(LogTemp, Log, TEXT("HitScan benchmark (per shot): %d traces, game thread %.3f ms (%.1f traces/ms)"),
+		NumShots, SyncMs, NumShots / FMath::Max(SyncMs, 0.001));
+
+	// Batched path, timed until OnTraceCompleted got every shot back, the async trace pass runs a frame later
+	BenchmarkShotsTotal = NumShots;
+	BenchmarkShotsPending = NumShots;
+	BenchmarkStartFrame = GFrameCounter;
+	BenchmarkDeliverySeconds = 0.0;
+	BenchmarkLastResultFrame = 0;
+	BenchmarkStartTime = FPlatformTime::Seconds();
+
+	FHitScanRequest Request;
+	Request.TraceStart = Origin;
+	Request.QueryParams = QueryParams;
+	Request.bBenchmark = true;
+
+	for (const FVector& TraceEnd : TraceEnds)
+	{
+		Request.TraceEnd = TraceEnd;
+		QueueShot(Request);
+	}
+	BenchmarkDispatchSeconds = FPlatformTime::Seconds() - BenchmarkStartTime;
+}
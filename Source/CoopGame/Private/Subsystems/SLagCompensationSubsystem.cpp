@@ -0,0 +1,410 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SLagCompensationSubsystem.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+#include "CoopGame/CoopGame.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopLagCompensation"), STATGROUP_CoopLagCompensation, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Rewind Per Shot"), STAT_LagCompRewind, STATGROUP_CoopLagCompensation);
+DECLARE_CYCLE_STAT(TEXT("Retrace Behind Tracked"), STAT_LagCompRetrace, STATGROUP_CoopLagCompensation);
+DECLARE_CYCLE_STAT(TEXT("Record History"), STAT_LagCompRecord, STATGROUP_CoopLagCompensation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Retraces"), STAT_LagCompRetraces, STATGROUP_CoopLagCompensation);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Tracked Actors"), STAT_LagCompTrackedActors, STATGROUP_CoopLagCompensation);
+
+static const int32 HitboxHistoryLength = 64;
+
+static int32 LagCompMaxActors = 256;
+FAutoConsoleVariableRef CVARLagCompMaxActors(
+	TEXT("COOP.LagCompMaxActors"),
+	LagCompMaxActors,
+	TEXT("Number of pawns the lag compensation history is preallocated for (read when the world starts)"),
+	ECVF_Default);
+
+static float LagCompMaxRewind = 0.5f;
+FAutoConsoleVariableRef CVARLagCompMaxRewind(
+	TEXT("COOP.LagCompMaxRewind"),
+	LagCompMaxRewind,
+	TEXT("Maximum time in seconds a client shot can be rewound"),
+	ECVF_Default);
+
+static FAutoConsoleCommand LagCompBenchmarkCmd(
+	TEXT("COOP.LagCompBenchmark"),
+	TEXT("Logs the rewind cost per shot with 16, 64 and 256 tracked pawns. Usage: COOP.LagCompBenchmark [NumShots=1000]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		int32 NumShots = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000, 1);
+		const int32 PawnCounts[] = { 16, 64, 256 };
+
+		FRandomStream Stream(1234);
+		for (int32 NumPawns : PawnCounts)
+		{
+			FHitboxHistory History;
+			History.Init(NumPawns, HitboxHistoryLength);
+
+			for (int32 i = 0; i < NumPawns; ++i)
+			{
+				History.AddEntry(FVector(34.0f, 34.0f, 88.0f));
+			}
+
+			// One second of history at 60 fps
+			for (int32 Frame = 0; Frame < HitboxHistoryLength; ++Frame)
+			{
+				History.BeginFrame(Frame / 60.0f);
+				for (int32 Slot = 0; Slot < NumPawns; ++Slot)
+				{
+					FVector Location(Stream.FRandRange(-5000.0f, 5000.0f), Stream.FRandRange(-5000.0f, 5000.0f), 100.0f);
+					History.Record(Slot, Location, FRotator(0.0f, Stream.FRandRange(0.0f, 360.0f), 0.0f).Quaternion());
+				}
+			}
+
+			int32 NumHits = 0;
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < NumShots; ++i)
+			{
+				FVector Start(Stream.FRandRange(-5000.0f, 5000.0f), Stream.FRandRange(-5000.0f, 5000.0f), 100.0f);
+				FVector End = Start + Stream.GetUnitVector() * 10000.0f;
+				float Distance;
+				if (History.Raycast(Start, End, Stream.FRandRange(0.0f, 1.0f), INDEX_NONE, Distance) != INDEX_NONE)
+					++NumHits;
+			}
+			double ElapsedUs = (FPlatformTime::Seconds() - StartTime) * 1000000.0;
+
+			UE_LOG(LogTemp, Log, TEXT("LagComp benchmark: %d pawns, %d shots, %.3f us per shot (%d hits)"), NumPawns, NumShots, ElapsedUs / NumShots, NumHits);
+		}
+	}));
+
+void FHitboxHistory::Init(int32 InMaxEntries, int32 InHistoryLength)
+{
+	MaxEntries = InMaxEntries;
+	HistoryLength = InHistoryLength;
+	NumFrames = 0;
+
+	FrameTimes.SetNumZeroed(HistoryLength);
+	Frames.SetNumZeroed(MaxEntries * HistoryLength);
+	Entries.SetNumZeroed(MaxEntries);
+	ActiveSlots.Empty(MaxEntries);
+
+	// Hand out the lowest slots first
+	FreeSlots.Empty(MaxEntries);
+	for (int32 Slot = MaxEntries - 1; Slot >= 0; --Slot)
+	{
+		FreeSlots.Add(Slot);
+	}
+}
+
+int32 FHitboxHistory::AddEntry(const FVector& BoxExtent)
+{
+	if (FreeSlots.Num() == 0)
+		return INDEX_NONE;
+
+	int32 Slot = FreeSlots.Pop(false);
+
+	FHitboxEntry& Entry = Entries[Slot];
+	Entry.BoxExtent = BoxExtent;
+	Entry.FirstFrame = NumFrames;
+	Entry.ActiveIndex = ActiveSlots.Add(Slot);
+
+	return Slot;
+}
+
+void FHitboxHistory::RemoveEntry(int32 Slot)
+{
+	if (!Entries.IsValidIndex(Slot) || Entries[Slot].ActiveIndex == INDEX_NONE)
+		return;
+
+	int32 ActiveIndex = Entries[Slot].ActiveIndex;
+	ActiveSlots.RemoveAtSwap(ActiveIndex, 1, false);
+	if (ActiveSlots.IsValidIndex(ActiveIndex))
+	{
+		Entries[ActiveSlots[ActiveIndex]].ActiveIndex = ActiveIndex;
+	}
+
+	Entries[Slot].ActiveIndex = INDEX_NONE;
+	FreeSlots.Add(Slot);
+}
+
+void FHitboxHistory::BeginFrame(float Time)
+{
+	FrameTimes[NumFrames % HistoryLength] = Time;
+	++NumFrames;
+}
+
+void FHitboxHistory::Record(int32 Slot, const FVector& Location, const FQuat& Rotation)
+{
+	FHitboxFrame& Frame = Frames[Slot * HistoryLength + (NumFrames - 1) % HistoryLength];
+	Frame.Location = Location;
+	Frame.Rotation = Rotation;
+}
+
+bool FHitboxHistory::FindFrames(float Time, uint32& OutOlder, uint32& OutNewer, float& OutAlpha) const
+{
+	if (NumFrames == 0)
+		return false;
+
+	uint32 Newest = NumFrames - 1;
+	uint32 Oldest = NumFrames > (uint32)HistoryLength ? NumFrames - HistoryLength : 0;
+
+	OutAlpha = 0.0f;
+
+	if (Time >= FrameTimes[Newest % HistoryLength])
+	{
+		OutOlder = OutNewer = Newest;
+		return true;
+	}
+
+	if (Time <= FrameTimes[Oldest % HistoryLength])
+	{
+		OutOlder = OutNewer = Oldest;
+		return true;
+	}
+
+	// Last frame recorded at or before Time
+	uint32 Low = Oldest;
+	uint32 High = Newest;
+	while (High - Low > 1)
+	{
+		uint32 Mid = Low + (High - Low) / 2;
+		if (FrameTimes[Mid % HistoryLength] <= Time)
+			Low = Mid;
+		else
+			High = Mid;
+	}
+
+	float OlderTime = FrameTimes[Low % HistoryLength];
+	float NewerTime = FrameTimes[High % HistoryLength];
+
+	OutOlder = Low;
+	OutNewer = High;
+	OutAlpha = NewerTime > OlderTime ? (Time - OlderTime) / (NewerTime - OlderTime) : 0.0f;
+	return true;
+}
+
+bool FHitboxHistory::RaycastBox(const FVector& Start, const FVector& Dir, float Length, const FVector& Center, const FQuat& Rotation, const FVector& Extent, float& OutDistance) const
+{
+	// Slab test in box space
+	FVector LocalStart = Rotation.UnrotateVector(Start - Center);
+	FVector LocalDir = Rotation.UnrotateVector(Dir);
+
+	float TMin = 0.0f;
+	float TMax = Length;
+
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (FMath::Abs(LocalDir[Axis]) < KINDA_SMALL_NUMBER)
+		{
+			if (FMath::Abs(LocalStart[Axis]) > Extent[Axis])
+				return false;
+			continue;
+		}
+
+		float InvDir = 1.0f / LocalDir[Axis];
+		float T0 = (-Extent[Axis] - LocalStart[Axis]) * InvDir;
+		float T1 = (Extent[Axis] - LocalStart[Axis]) * InvDir;
+		if (T0 > T1)
+			Swap(T0, T1);
+
+		TMin = FMath::Max(TMin, T0);
+		TMax = FMath::Min(TMax, T1);
+		if (TMin > TMax)
+			return false;
+	}
+
+	OutDistance = TMin;
+	return true;
+}
+
+int32 FHitboxHistory::Raycast(const FVector& Start, const FVector& End, float Time, int32 IgnoredSlot, float& OutDistance) const
+{
+	uint32 Older, Newer;
+	float Alpha;
+	if (!FindFrames(Time, Older, Newer, Alpha))
+		return INDEX_NONE;
+
+	FVector Dir = End - Start;
+	float Length = Dir.Size();
+	if (Length <= KINDA_SMALL_NUMBER)
+		return INDEX_NONE;
+	Dir /= Length;
+
+	int32 BestSlot = INDEX_NONE;
+	float BestDistance = Length;
+
+	for (int32 Slot : ActiveSlots)
+	{
+		if (Slot == IgnoredSlot)
+			continue;
+
+		const FHitboxEntry& Entry = Entries[Slot];
+		if (Entry.FirstFrame >= NumFrames)
+			continue;	// Nothing recorded yet
+
+		// Frames before the entry was added belong to the previous owner of the slot
+		uint32 EntryOlder = FMath::Max(Older, Entry.FirstFrame);
+		uint32 EntryNewer = FMath::Max(Newer, Entry.FirstFrame);
+
+		const FHitboxFrame& OlderFrame = Frames[Slot * HistoryLength + EntryOlder % HistoryLength];
+		const FHitboxFrame& NewerFrame = Frames[Slot * HistoryLength + EntryNewer % HistoryLength];
+
+		FVector Center = FMath::Lerp(OlderFrame.Location, NewerFrame.Location, Alpha);
+		FQuat Rotation = FQuat::FastLerp(OlderFrame.Rotation, NewerFrame.Rotation, Alpha).GetNormalized();
+
+		float Distance;
+		if (RaycastBox(Start, Dir, BestDistance, Center, Rotation, Entry.BoxExtent, Distance) && Distance < BestDistance)
+		{
+			BestSlot = Slot;
+			BestDistance = Distance;
+		}
+	}
+
+	OutDistance = BestDistance;
+	return BestSlot;
+}
+
+void USLagCompensationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	int32 MaxActors = FMath::Max(LagCompMaxActors, 1);
+	History.Init(MaxActors, HitboxHistoryLength);
+
+	SlotActors.SetNum(MaxActors);
+	ActorSlots.Reserve(MaxActors);
+}
+
+void USLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompRecord);
+
+	History.BeginFrame(GetWorld()->GetTimeSeconds());
+
+	for (const TPair<TWeakObjectPtr<AActor>, int32>& Pair : ActorSlots)
+	{
+		AActor* Actor = Pair.Key.Get();
+		if (Actor != nullptr)
+		{
+			History.Record(Pair.Value, Actor->GetActorLocation(), Actor->GetActorQuat());
+		}
+	}
+}
+
+bool USLagCompensationSubsystem::IsTickable() const
+{
+	// Only the server resolves shots
+	UWorld* World = GetWorld();
+	return !IsTemplate() && World != nullptr && World->GetNetMode() != NM_Client && ActorSlots.Num() > 0;
+}
+
+TStatId USLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+void USLagCompensationSubsystem::RegisterActor(AActor* Actor)
+{
+	if (Actor == nullptr || ActorSlots.Contains(Actor))
+		return;
+
+	// Hitbox is the simple collision cylinder as a box
+	float Radius, HalfHeight;
+	Actor->GetSimpleCollisionCylinder(Radius, HalfHeight);
+
+	int32 Slot = History.AddEntry(FVector(Radius, Radius, HalfHeight));
+	if (Slot == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Lag compensation history is full, %s won't be rewound. Increase COOP.LagCompMaxActors"), *Actor->GetName());
+		return;
+	}
+
+	SlotActors[Slot] = Actor;
+	ActorSlots.Add(Actor, Slot);
+
+	INC_DWORD_STAT(STAT_LagCompTrackedActors);
+}
+
+void USLagCompensationSubsystem::UnregisterActor(AActor* Actor)
+{
+	int32 Slot;
+	if (ActorSlots.RemoveAndCopyValue(Actor, Slot))
+	{
+		History.RemoveEntry(Slot);
+		SlotActors[Slot] = nullptr;
+
+		DEC_DWORD_STAT(STAT_LagCompTrackedActors);
+	}
+}
+
+bool USLagCompensationSubsystem::RewindHitScan(const FVector& TraceStart, const FVector& TraceEnd, float RewindTime, const AActor* Shooter, const FCollisionQueryParams& QueryParams,
+	FHitResult& InOutHit, bool bBlockingHit) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompRewind);
+
+	FVector ShotDirection = (TraceEnd - TraceStart).GetSafeNormal();
+	float Now = GetWorld()->GetTimeSeconds();
+	RewindTime = FMath::Clamp(RewindTime, Now - LagCompMaxRewind, Now);
+
+	// World geometry still blocks, tracked actors are replaced by their rewound hitboxes
+	AActor* WorldHitActor = bBlockingHit ? InOutHit.GetActor() : nullptr;
+
+	FHitResult WorldHit;
+	bool bWorldBlocking = bBlockingHit;
+	if (bBlockingHit)
+		WorldHit = InOutHit;
+
+	// Walls behind a tracked actor at its current location still stop the rewound ray
+	if (WorldHitActor != nullptr && ActorSlots.Contains(WorldHitActor))
+		bWorldBlocking = TraceUntracked(TraceStart, TraceEnd, QueryParams, WorldHit);
+
+	FVector RewindEnd = bWorldBlocking ? WorldHit.ImpactPoint : TraceEnd;
+
+	const int32* ShooterSlot = ActorSlots.Find(const_cast<AActor*>(Shooter));
+
+	float Distance;
+	int32 Slot = History.Raycast(TraceStart, RewindEnd, RewindTime, ShooterSlot != nullptr ? *ShooterSlot : INDEX_NONE, Distance);
+
+	AActor* RewoundActor = Slot != INDEX_NONE ? SlotActors[Slot].Get() : nullptr;
+	if (RewoundActor != nullptr)
+	{
+		FVector ImpactPoint = TraceStart + ShotDirection * Distance;
+
+		FHitResult RewoundHit(RewoundActor, Cast<UPrimitiveComponent>(RewoundActor->GetRootComponent()), ImpactPoint, -ShotDirection);
+		RewoundHit.bBlockingHit = true;
+		RewoundHit.Distance = Distance;
+		RewoundHit.TraceStart = TraceStart;
+		RewoundHit.TraceEnd = TraceEnd;
+
+		// Keep the surface when the server trace agrees on the actor (vulnerable spots)
+		if (RewoundActor == WorldHitActor)
+		{
+			RewoundHit.PhysMaterial = InOutHit.PhysMaterial;
+			RewoundHit.BoneName = InOutHit.BoneName;
+			RewoundHit.Component = InOutHit.Component;
+		}
+
+		InOutHit = RewoundHit;
+		return true;
+	}
+
+	// Missed the rewound hitboxes, the shot stops at the world geometry
+	if (bWorldBlocking)
+		InOutHit = WorldHit;
+
+	return bWorldBlocking;
+}
+
+bool USLagCompensationSubsystem::TraceUntracked(const FVector& TraceStart, const FVector& TraceEnd, const FCollisionQueryParams& QueryParams, FHitResult& OutHit) const
+{
+	// Counted in Rewind Per Shot too, a single synchronous trace however many actors are tracked
+	SCOPE_CYCLE_COUNTER(STAT_LagCompRetrace);
+	INC_DWORD_STAT(STAT_LagCompRetraces);
+
+	FCollisionQueryParams UntrackedParams = QueryParams;
+	for (const TWeakObjectPtr<AActor>& SlotActor : SlotActors)
+	{
+		if (SlotActor.IsValid())
+			UntrackedParams.AddIgnoredActor(SlotActor.Get());
+	}
+
+	return GetWorld()->LineTraceSingleByChannel(OutHit, TraceStart, TraceEnd, COLLISION_WEAPON, UntrackedParams);
+}
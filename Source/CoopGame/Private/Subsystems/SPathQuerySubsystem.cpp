@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SPathQuerySubsystem.h"
+#include "Engine/World.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopPathQueries"), STATGROUP_CoopPathQueries, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Requests"), STAT_PathRequests, STATGROUP_CoopPathQueries);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Queries Issued"), STAT_PathQueries, STATGROUP_CoopPathQueries);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Requests Shared"), STAT_PathRequestsShared, STATGROUP_CoopPathQueries);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Path Queries In Flight"), STAT_PathQueriesInFlight, STATGROUP_CoopPathQueries);
+DECLARE_CYCLE_STAT(TEXT("Request Path"), STAT_RequestPath, STATGROUP_CoopPathQueries);
+
+static float PathShareCellSize = 200.0f;
+FAutoConsoleVariableRef CVARPathShareCellSize(
+	TEXT("COOP.PathShareCellSize"),
+	PathShareCellSize,
+	TEXT("Path requests starting in the same cell of this size share one query (0 = never share)"),
+	ECVF_Default);
+
+static float PathCacheTime = 0.5f;
+FAutoConsoleVariableRef CVARPathCacheTime(
+	TEXT("COOP.PathCacheTime"),
+	PathCacheTime,
+	TEXT("Seconds a finished path is reused for requests from the same cell"),
+	ECVF_Default);
+
+// Latency samples kept between reports
+static const int32 MaxLatencySamples = 8192;
+
+static double PathQueryReportStartTime = 0.0;
+
+static FAutoConsoleCommandWithWorld PathQueryReportCmd(
+	TEXT("COOP.PathQueryReport"),
+	TEXT("Logs path queries per second and their p50/p99 latency since the last report and resets the counters"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		USPathQuerySubsystem* PathQueries = World != nullptr ? World->GetSubsystem<USPathQuerySubsystem>() : nullptr;
+		if (PathQueries == nullptr)
+			return;
+
+		int32 NumQueries = 0;
+		int32 NumRequests = 0;
+		TArray<float> Latencies;
+		PathQueries->ConsumeReport(NumQueries, NumRequests, Latencies);
+
+		double Now = FPlatformTime::Seconds();
+		double Elapsed = PathQueryReportStartTime > 0.0 ? FMath::Max(Now - PathQueryReportStartTime, 0.001) : 0.0;
+		PathQueryReportStartTime = Now;
+
+		float P50 = 0.0f;
+		float P99 = 0.0f;
+		if (Latencies.Num() > 0)
+		{
+			Latencies.Sort();
+			P50 = Latencies[(Latencies.Num() - 1) / 2];
+			P99 = Latencies[FMath::Min(FMath::CeilToInt(Latencies.Num() * 0.99f) - 1, Latencies.Num() - 1)];
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Path queries: %d requests, %d queries over %.1f s (%.1f queries/s), latency p50 %.2f ms p99 %.2f ms"),
+			NumRequests, NumQueries, Elapsed, Elapsed > 0.0 ? NumQueries / Elapsed : 0.0, P50, P99);
+	}));
+
+void USPathQuerySubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_PathQueriesInFlight, PendingQueries.Num());
+
+	PendingQueries.Empty();
+	PendingQueryIds.Empty();
+	CachedPaths.Empty();
+
+	Super::Deinitialize();
+}
+
+void USPathQuerySubsystem::RequestPath(const FVector& Start, AActor* Goal, const FSPathQueryDelegate& Callback)
+{
+	SCOPE_CYCLE_COUNTER(STAT_RequestPath);
+
+	++NumRequests;
+	INC_DWORD_STAT(STAT_PathRequests);
+
+	UWorld* World = GetWorld();
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	ANavigationData* NavData = NavSys != nullptr ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+	if (Goal == nullptr || NavData == nullptr)
+	{
+		Callback.ExecuteIfBound(false, TArray<FVector>());
+		return;
+	}
+
+	FQueryKey Key;
+	Key.Goal = Goal;
+	Key.StartCell = PathShareCellSize > 0.0f ? FIntVector(Start / PathShareCellSize) : FIntVector(NumRequests, 0, 0);
+
+	double Now = World->GetTimeSeconds();
+
+	// Drop stale results every now and then
+	if (Now - LastCachePruneTime > PathCacheTime)
+	{
+		for (auto It = CachedPaths.CreateIterator(); It; ++It)
+		{
+			if (Now - It->Value.Time > PathCacheTime)
+				It.RemoveCurrent();
+		}
+		LastCachePruneTime = Now;
+	}
+
+	// Reuse a recent result
+	const FCachedPath* Cached = CachedPaths.Find(Key);
+	if (Cached != nullptr && Now - Cached->Time <= PathCacheTime)
+	{
+		INC_DWORD_STAT(STAT_PathRequestsShared);
+		Callback.ExecuteIfBound(Cached->bSuccess, Cached->PathPoints);
+		return;
+	}
+
+	// Join a query in flight
+	const uint32* PendingId = PendingQueryIds.Find(Key);
+	if (PendingId != nullptr)
+	{
+		INC_DWORD_STAT(STAT_PathRequestsShared);
+		PendingQueries[*PendingId].Callbacks.Add(Callback);
+		return;
+	}
+
+	FPathFindingQuery Query(this, *NavData, Start, Goal->GetActorLocation());
+	uint32 QueryId = NavSys->FindPathAsync(FNavAgentProperties::DefaultProperties, Query, FNavPathQueryDelegate::CreateUObject(this, &USPathQuerySubsystem::OnPathFound));
+	if (QueryId == INVALID_NAVQUERYID)
+	{
+		Callback.ExecuteIfBound(false, TArray<FVector>());
+		return;
+	}
+
+	FPendingQuery& Pending = PendingQueries.Add(QueryId);
+	Pending.Key = Key;
+	Pending.StartTime = FPlatformTime::Seconds();
+	Pending.Callbacks.Add(Callback);
+	PendingQueryIds.Add(Key, QueryId);
+
+	++NumQueries;
+	INC_DWORD_STAT(STAT_PathQueries);
+	INC_DWORD_STAT(STAT_PathQueriesInFlight);
+}
+
+void USPathQuerySubsystem::OnPathFound(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path)
+{
+	FPendingQuery Pending;
+	if (!PendingQueries.RemoveAndCopyValue(QueryID, Pending))
+		return;
+
+	PendingQueryIds.Remove(Pending.Key);
+	DEC_DWORD_STAT(STAT_PathQueriesInFlight);
+
+	if (LatenciesMs.Num() < MaxLatencySamples)
+		LatenciesMs.Add((FPlatformTime::Seconds() - Pending.StartTime) * 1000.0);
+
+	FCachedPath& Cached = CachedPaths.Add(Pending.Key);
+	Cached.Time = GetWorld()->GetTimeSeconds();
+	Cached.bSuccess = Result == ENavigationQueryResult::Success && Path.IsValid() && Path->GetPathPoints().Num() > 1;
+	if (Cached.bSuccess)
+	{
+		const TArray<FNavPathPoint>& Points = Path->GetPathPoints();
+		Cached.PathPoints.Reserve(Points.Num());
+		for (const FNavPathPoint& Point : Points)
+		{
+			Cached.PathPoints.Add(Point.Location);
+		}
+	}
+
+	// Copy, callbacks may request new paths and touch the cache
+	TArray<FVector> PathPoints = Cached.PathPoints;
+	bool bSuccess = Cached.bSuccess;
+	for (const FSPathQueryDelegate& Callback : Pending.Callbacks)
+	{
+		Callback.ExecuteIfBound(bSuccess, PathPoints);
+	}
+}
+
+void USPathQuerySubsystem::ConsumeReport(int32& OutQueries, int32& OutRequests, TArray<float>& OutLatenciesMs)
+{
+	OutQueries = NumQueries;
+	OutRequests = NumRequests;
+	OutLatenciesMs = MoveTemp(LatenciesMs);
+
+	NumQueries = 0;
+	NumRequests = 0;
+	LatenciesMs.Reset();
+}
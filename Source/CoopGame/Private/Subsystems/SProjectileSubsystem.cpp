@@ -0,0 +1,539 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SProjectileSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Sound/SoundCue.h"
+#include "Async/ParallelFor.h"
+#include "Subsystems/SExplosionSubsystem.h"
+#include "SGrenadeDefinition.h"
+#include "SGrenadeLauncher.h"
+#include "SCosmetics.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopProjectiles"), STATGROUP_CoopProjectiles, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Step Projectiles"), STAT_ProjectileStep, STATGROUP_CoopProjectiles);
+DECLARE_CYCLE_STAT(TEXT("Sweeps"), STAT_ProjectileSweeps, STATGROUP_CoopProjectiles);
+DECLARE_CYCLE_STAT(TEXT("Update Visuals"), STAT_ProjectileVisuals, STATGROUP_CoopProjectiles);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectiles"), STAT_ProjectileCount, STATGROUP_CoopProjectiles);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sweeps"), STAT_ProjectileSweepCount, STATGROUP_CoopProjectiles);
+
+static int32 GrenadeSimulation = 1;
+FAutoConsoleVariableRef CVARGrenadeSimulation(
+	TEXT("COOP.GrenadeSimulation"),
+	GrenadeSimulation,
+	TEXT("Fire grenades with a definition as simulated data instead of projectile actors"),
+	ECVF_Default);
+
+static int32 GrenadeSweepChunks = 0;
+FAutoConsoleVariableRef CVARGrenadeSweepChunks(
+	TEXT("COOP.GrenadeSweepChunks"),
+	GrenadeSweepChunks,
+	TEXT("Parallel chunks for grenade sweeps (0 = one per worker thread, 1 = game thread only)"),
+	ECVF_Default);
+
+// Below this many sweeps they stay on the game thread
+static const int32 MinSweepsForParallel = 64;
+
+// Grenades bouncing slower than this come to rest
+static const float RestSpeed = 50.0f;
+
+// Grenades are swept against what blocks dynamic objects
+static const ECollisionChannel GrenadeTraceChannel = ECC_WorldDynamic;
+
+// Step length when catching up on a grenade launched in the past
+static const float FastForwardStep = 1.0f / 60.0f;
+
+static FAutoConsoleCommandWithWorldAndArgs GrenadeBenchmarkCmd(
+	TEXT("COOP.GrenadeBenchmark"),
+	TEXT("Launches grenades of the first grenade launcher in the level (default grenades without one) at once and logs step times. Usage: COOP.GrenadeBenchmark [NumGrenades=1000] [FireType=0]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USProjectileSubsystem* Projectiles = World != nullptr ? World->GetSubsystem<USProjectileSubsystem>() : nullptr;
+		if (Projectiles == nullptr)
+			return;
+
+		int32 NumGrenades = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		int32 FireType = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+
+		// Works on a dedicated server without players too
+		const USGrenadeDefinition* Definition = GetDefault<USGrenadeDefinition>();
+		FVector Origin(0.0f, 0.0f, 500.0f);
+
+		TActorIterator<ASGrenadeLauncher> It(World);
+		if (It)
+		{
+			if (It->GetGrenadeDefinition(FireType) != nullptr)
+				Definition = It->GetGrenadeDefinition(FireType);
+			Origin = It->GetActorLocation() + FVector(0.0f, 0.0f, 200.0f);
+		}
+
+		Projectiles->RunBenchmark(Definition, Origin, FMath::Max(NumGrenades, 1));
+	}));
+
+void USProjectileSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_ProjectileCount, Projectiles.Num());
+	Projectiles.Empty();
+	Definitions.Empty();
+	Visuals.Empty();
+	VisualTransforms.Empty();
+	VisualActor = nullptr;
+	NumVisibleInstances = 0;
+	bBenchmark = false;
+
+	Super::Deinitialize();
+}
+
+bool USProjectileSubsystem::IsTickable() const
+{
+	return !IsTemplate() && (Projectiles.Num() > 0 || NumVisibleInstances > 0);
+}
+
+TStatId USProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USProjectileSubsystem, STATGROUP_Tickables);
+}
+
+bool USProjectileSubsystem::IsSimulationEnabled()
+{
+	return GrenadeSimulation > 0;
+}
+
+void USProjectileSubsystem::Launch(const USGrenadeDefinition* Definition, AActor* Launcher, const FVector& Location, const FVector& Velocity,
+	uint16 ShotId, float FastForwardSeconds)
+{
+	if (Definition == nullptr)
+		return;
+
+	FSProjectile Projectile;
+	Projectile.Definition = Definition;
+	Projectile.Location = Location;
+	Projectile.Velocity = Velocity;
+	Projectile.FuseLeft = Definition->FuseTime;
+	Projectile.ShotId = ShotId;
+	Projectile.Seed = ShotId;
+
+	if (Launcher != nullptr)
+	{
+		Projectile.Launcher = Launcher;
+		Projectile.LauncherOwner = Launcher->GetOwner();
+		Projectile.InstigatedBy = Launcher->GetOwner() != nullptr ? Launcher->GetOwner()->GetInstigatorController() : nullptr;
+		Projectile.bApplyDamage = Launcher->GetLocalRole() == ROLE_Authority;
+	}
+
+	if (FastForwardSeconds > 0.0f)
+		FastForward(Projectile, FastForwardSeconds);
+
+	Launch(Projectile);
+}
+
+bool USProjectileSubsystem::CorrectLaunch(AActor* Launcher, uint16 ShotId, const USGrenadeDefinition* Definition, const FVector& Location,
+	const FVector& Velocity, float FastForwardSeconds)
+{
+	int32 Index = Projectiles.IndexOfByPredicate([Launcher, ShotId](const FSProjectile& Projectile)
+	{
+		return Projectile.ShotId == ShotId && Projectile.Launcher.Get() == Launcher;
+	});
+
+	// Already exploded, nothing left to correct
+	if (Index == INDEX_NONE)
+		return false;
+
+	Projectiles.RemoveAtSwap(Index, 1, false);
+	DEC_DWORD_STAT(STAT_ProjectileCount);
+
+	Launch(Definition, Launcher, Location, Velocity, ShotId, FastForwardSeconds);
+	return true;
+}
+
+void USProjectileSubsystem::Launch(const FSProjectile& Projectile)
+{
+	Projectiles.Add(Projectile);
+
+	Definitions.AddUnique(Projectile.Definition);
+	INC_DWORD_STAT(STAT_ProjectileCount);
+
+	if (Projectile.bBenchmark)
+	{
+		++NumBenchmarkGrenades;
+		BenchmarkPeakGrenades = FMath::Max(BenchmarkPeakGrenades, NumBenchmarkGrenades);
+	}
+}
+
+void USProjectileSubsystem::Tick(float DeltaTime)
+{
+	double StartTime = FPlatformTime::Seconds();
+
+	StepProjectiles(DeltaTime);
+
+	double StepSeconds = FPlatformTime::Seconds() - StartTime;
+
+#if WITH_COOP_COSMETICS
+	if (FSCosmetics::ShouldPlay(this))
+		UpdateVisuals();
+#endif
+
+	if (!bBenchmark)
+		return;
+
+	++BenchmarkFrames;
+	BenchmarkStepSeconds += StepSeconds;
+	BenchmarkWorstStepSeconds = FMath::Max(BenchmarkWorstStepSeconds, StepSeconds);
+
+	if (NumBenchmarkGrenades > 0)
+		return;
+
+	bBenchmark = false;
+
+	UE_LOG(LogTemp, Log, TEXT("Grenade benchmark: %d grenades, %d at once, gone after %.2f s over %d frames, step %.3f ms avg / %.3f ms worst"),
+		BenchmarkTotalGrenades, BenchmarkPeakGrenades, FPlatformTime::Seconds() - BenchmarkStartTime, BenchmarkFrames,
+		BenchmarkStepSeconds * 1000.0 / BenchmarkFrames, BenchmarkWorstStepSeconds * 1000.0);
+}
+
+bool USProjectileSubsystem::Integrate(FSProjectile& Projectile, float GravityZ, float DeltaTime, FVector& OutEnd)
+{
+	Projectile.FuseLeft -= DeltaTime;
+
+	if (Projectile.bStuck)
+	{
+		UPrimitiveComponent* StuckTo = Projectile.StuckTo.Get();
+		if (StuckTo != nullptr)
+		{
+			Projectile.Location = StuckTo->GetComponentTransform().TransformPosition(Projectile.StuckOffset);
+			return false;
+		}
+
+		// What it stuck to is gone, fall
+		Projectile.bStuck = false;
+	}
+
+	if (Projectile.bAtRest)
+		return false;
+
+	Projectile.Velocity.Z += GravityZ * Projectile.Definition->GravityScale * DeltaTime;
+	OutEnd = Projectile.Location + Projectile.Velocity * DeltaTime;
+	return true;
+}
+
+void USProjectileSubsystem::ResolveSweep(FSProjectile& Projectile, const FVector& End, bool bBlocked, const FHitResult& Hit)
+{
+	const USGrenadeDefinition* Definition = Projectile.Definition;
+
+	if (!bBlocked)
+	{
+		Projectile.Location = End;
+		return;
+	}
+
+	Projectile.Location = Hit.Location;
+	if (Hit.bStartPenetrating)
+		Projectile.Location += Hit.Normal * (Hit.PenetrationDepth + 0.1f);
+
+	if (Definition->bExplodeOnImpact)
+	{
+		Projectile.FuseLeft = 0.0f;
+		return;
+	}
+
+	UPrimitiveComponent* HitComponent = Hit.GetComponent();
+	if (Definition->bSticky && HitComponent != nullptr)
+	{
+		Projectile.bStuck = true;
+		Projectile.StuckTo = HitComponent;
+		Projectile.StuckOffset = HitComponent->GetComponentTransform().InverseTransformPosition(Projectile.Location);
+		Projectile.Velocity = FVector::ZeroVector;
+		return;
+	}
+
+	float IntoSurface = FVector::DotProduct(Projectile.Velocity, Hit.Normal);
+	FVector AlongSurface = Projectile.Velocity - Hit.Normal * IntoSurface;
+	Projectile.Velocity = AlongSurface * (1.0f - Definition->Friction) - Hit.Normal * IntoSurface * Definition->Restitution;
+	Projectile.Location += Hit.Normal * 0.1f;
+
+	if (++Projectile.NumBounces >= Definition->MaxBounces || Projectile.Velocity.SizeSquared() < FMath::Square(RestSpeed))
+	{
+		Projectile.bAtRest = true;
+		Projectile.Velocity = FVector::ZeroVector;
+	}
+}
+
+void USProjectileSubsystem::FastForward(FSProjectile& Projectile, float Seconds)
+{
+	UWorld* World = GetWorld();
+	float GravityZ = World->GetGravityZ();
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(GrenadeSweep), false, Projectile.Launcher.Get());
+	QueryParams.AddIgnoredActor(Projectile.LauncherOwner.Get());
+
+	// Same steps as a frame would take, one sweep each
+	while (Seconds > 0.0f && Projectile.FuseLeft > 0.0f)
+	{
+		float DeltaTime = FMath::Min(Seconds, FastForwardStep);
+		Seconds -= DeltaTime;
+
+		FVector End;
+		if (!Integrate(Projectile, GravityZ, DeltaTime, End))
+			continue;
+
+		FHitResult Hit;
+		bool bBlocked = World->SweepSingleByChannel(Hit, Projectile.Location, End, FQuat::Identity, GrenadeTraceChannel,
+			FCollisionShape::MakeSphere(Projectile.Definition->CollisionRadius), QueryParams);
+		ResolveSweep(Projectile, End, bBlocked, Hit);
+	}
+}
+
+void USProjectileSubsystem::StepProjectiles(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileStep);
+
+	UWorld* World = GetWorld();
+	float GravityZ = World->GetGravityZ();
+	int32 NumProjectiles = Projectiles.Num();
+
+	SweepIndices.Reset();
+	SweepEnds.SetNumUninitialized(NumProjectiles, false);
+	SweepIgnored.SetNumUninitialized(NumProjectiles * 2, false);
+
+	// Burn fuses, move stuck grenades with what they stuck to and integrate the ones in flight
+	for (int32 i = 0; i < NumProjectiles; ++i)
+	{
+		FSProjectile& Projectile = Projectiles[i];
+		if (!Integrate(Projectile, GravityZ, DeltaTime, SweepEnds[i]))
+			continue;
+
+		SweepIgnored[i * 2] = Projectile.Launcher.Get();
+		SweepIgnored[i * 2 + 1] = Projectile.LauncherOwner.Get();
+		SweepIndices.Add(i);
+	}
+
+	int32 NumSweeps = SweepIndices.Num();
+	SweepHits.SetNum(NumSweeps, false);
+	SweepBlocked.SetNumZeroed(NumSweeps, false);
+
+	if (NumSweeps > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProjectileSweeps);
+		INC_DWORD_STAT_BY(STAT_ProjectileSweepCount, NumSweeps);
+
+		int32 NumChunks = GrenadeSweepChunks > 0 ? GrenadeSweepChunks : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+		NumChunks = NumSweeps < MinSweepsForParallel ? 1 : FMath::Min(NumChunks, NumSweeps);
+		int32 ChunkSize = FMath::DivideAndRoundUp(NumSweeps, NumChunks);
+
+		// Scene queries only read the physics scene, every chunk writes its own range of the sweep results
+		ParallelFor(NumChunks, [&](int32 Chunk)
+		{
+			int32 End = FMath::Min((Chunk + 1) * ChunkSize, NumSweeps);
+			for (int32 Sweep = Chunk * ChunkSize; Sweep < End; ++Sweep)
+			{
+				int32 i = SweepIndices[Sweep];
+				const FSProjectile& Projectile = Projectiles[i];
+
+				FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(GrenadeSweep), false, SweepIgnored[i * 2]);
+				QueryParams.AddIgnoredActor(SweepIgnored[i * 2 + 1]);
+
+				SweepBlocked[Sweep] = World->SweepSingleByChannel(SweepHits[Sweep], Projectile.Location, SweepEnds[i], FQuat::Identity,
+					GrenadeTraceChannel, FCollisionShape::MakeSphere(Projectile.Definition->CollisionRadius), QueryParams);
+			}
+		}, NumChunks == 1);
+	}
+
+	// Bounce, stick or explode on impact
+	for (int32 Sweep = 0; Sweep < NumSweeps; ++Sweep)
+	{
+		int32 i = SweepIndices[Sweep];
+		ResolveSweep(Projectiles[i], SweepEnds[i], SweepBlocked[Sweep] != 0, SweepHits[Sweep]);
+	}
+
+	// Explode the grenades whose fuse ran out, submunitions they release are added at the end
+	for (int32 i = NumProjectiles - 1; i >= 0; --i)
+	{
+		if (Projectiles[i].FuseLeft > 0.0f)
+			continue;
+
+		FSProjectile Projectile = Projectiles[i];
+		Projectiles.RemoveAtSwap(i, 1, false);
+		DEC_DWORD_STAT(STAT_ProjectileCount);
+
+		if (Projectile.bBenchmark)
+			--NumBenchmarkGrenades;
+
+		Explode(Projectile);
+	}
+}
+
+void USProjectileSubsystem::Explode(const FSProjectile& Projectile)
+{
+	const USGrenadeDefinition* Definition = Projectile.Definition;
+
+	if (!Projectile.bBenchmark)
+	{
+		FSExplosion Explosion;
+		Explosion.DamageCauser = Projectile.Launcher;
+		Explosion.InstigatedBy = Projectile.InstigatedBy;
+		Explosion.Origin = Projectile.Location;
+		Explosion.bApplyDamage = Projectile.bApplyDamage;
+		Explosion.BaseDamage = Definition->ExplosionDamage;
+		Explosion.DamageRadius = Definition->ExplosionRadius;
+
+		if (Definition->ImpulseStrength > 0.0f)
+		{
+			Explosion.ImpulseOrigin = Projectile.Location;
+			Explosion.ImpulseRadius = Definition->ExplosionRadius;
+			Explosion.ImpulseStrength = Definition->ImpulseStrength;
+			Explosion.ImpulseFalloff = RIF_Linear;
+			Explosion.bImpulseVelChange = true;
+		}
+
+		USExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<USExplosionSubsystem>();
+		if (Explosions != nullptr)
+		{
+			Explosions->DetonateExplosion(Explosion);
+		}
+		else if (Explosion.bApplyDamage)
+		{
+			UGameplayStatics::ApplyRadialDamage(this, Explosion.BaseDamage, Explosion.Origin, Explosion.DamageRadius, nullptr, TArray<AActor*>(),
+				Projectile.Launcher.Get(), Projectile.InstigatedBy.Get(), true);
+		}
+
+#if WITH_COOP_COSMETICS
+		if (FSCosmetics::ShouldPlay(this))
+		{
+			UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Definition->ExplosionEffect, Projectile.Location);
+
+			UGameplayStatics::PlaySoundAtLocation(this, Definition->ExplosionSound, Projectile.Location);
+		}
+#endif
+	}
+
+	if (Definition->SubmunitionDefinition == nullptr || Definition->NumSubmunitions <= 0)
+		return;
+
+	// Scattered upwards, the same way on every machine
+	FRandomStream Stream(Projectile.Seed);
+	for (int32 i = 0; i < Definition->NumSubmunitions; ++i)
+	{
+		FVector Direction = Stream.VRand();
+		Direction.Z = FMath::Abs(Direction.Z);
+
+		FSProjectile Submunition = Projectile;
+		Submunition.Definition = Definition->SubmunitionDefinition;
+		Submunition.Velocity = Direction * Definition->SubmunitionSpeed;
+		Submunition.Seed = (uint16)Stream.RandHelper(MAX_uint16 + 1);
+		Submunition.FuseLeft = Submunition.Definition->FuseTime;
+		Submunition.ShotId = 0;
+		Submunition.NumBounces = 0;
+		Submunition.bAtRest = false;
+		Submunition.bStuck = false;
+		Submunition.StuckTo = nullptr;
+
+		if (Submunition.bBenchmark)
+			++BenchmarkTotalGrenades;
+
+		Launch(Submunition);
+	}
+}
+
+void USProjectileSubsystem::UpdateVisuals()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileVisuals);
+
+	for (TPair<UStaticMesh*, TArray<FTransform>>& Pair : VisualTransforms)
+	{
+		Pair.Value.Reset();
+	}
+
+	for (const FSProjectile& Projectile : Projectiles)
+	{
+		UStaticMesh* Mesh = Projectile.Definition->Mesh;
+		if (Mesh == nullptr)
+			continue;
+
+		FRotator Rotation = Projectile.Velocity.IsNearlyZero() ? FRotator::ZeroRotator : Projectile.Velocity.Rotation();
+		VisualTransforms.FindOrAdd(Mesh).Add(FTransform(Rotation, Projectile.Location, FVector(Projectile.Definition->MeshScale)));
+	}
+
+	NumVisibleInstances = 0;
+	for (const TPair<UStaticMesh*, TArray<FTransform>>& Pair : VisualTransforms)
+	{
+		const TArray<FTransform>& Transforms = Pair.Value;
+
+		UInstancedStaticMeshComponent* Instances = Visuals.FindRef(Pair.Key);
+		if (Instances == nullptr)
+		{
+			if (Transforms.Num() == 0)
+				continue;
+
+			if (VisualActor == nullptr)
+			{
+				FActorSpawnParameters SpawnParams;
+				SpawnParams.ObjectFlags |= RF_Transient;
+				VisualActor = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+			}
+
+			Instances = NewObject<UInstancedStaticMeshComponent>(VisualActor);
+			Instances->SetStaticMesh(Pair.Key);
+			Instances->SetMobility(EComponentMobility::Movable);
+			Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			Instances->RegisterComponent();
+			if (VisualActor->GetRootComponent() == nullptr)
+				VisualActor->SetRootComponent(Instances);
+			VisualActor->AddInstanceComponent(Instances);
+			Visuals.Add(Pair.Key, Instances);
+		}
+
+		// Grow or shrink at the end, then move every instance
+		int32 NumInstances = Instances->GetInstanceCount();
+		for (int32 i = NumInstances; i < Transforms.Num(); ++i)
+		{
+			Instances->AddInstanceWorldSpace(Transforms[i]);
+		}
+		for (int32 i = NumInstances - 1; i >= Transforms.Num(); --i)
+		{
+			Instances->RemoveInstance(i);
+		}
+		for (int32 i = 0; i < FMath::Min(NumInstances, Transforms.Num()); ++i)
+		{
+			Instances->UpdateInstanceTransform(i, Transforms[i], true, false, true);
+		}
+		Instances->MarkRenderStateDirty();
+
+		NumVisibleInstances += Transforms.Num();
+	}
+}
+
+void USProjectileSubsystem::RunBenchmark(const USGrenadeDefinition* Definition, const FVector& Origin, int32 NumGrenades)
+{
+	if (bBenchmark)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Grenade benchmark: still running"));
+		return;
+	}
+
+	bBenchmark = true;
+	NumBenchmarkGrenades = 0;
+	BenchmarkPeakGrenades = 0;
+	BenchmarkTotalGrenades = NumGrenades;
+	BenchmarkFrames = 0;
+	BenchmarkStartTime = FPlatformTime::Seconds();
+	BenchmarkStepSeconds = 0.0;
+	BenchmarkWorstStepSeconds = 0.0;
+
+	// Fanned out upwards so they land all around Origin
+	FRandomStream Stream(1234);
+	for (int32 i = 0; i < NumGrenades; ++i)
+	{
+		FVector Direction = Stream.VRandCone(FVector::UpVector, FMath::DegreesToRadians(60.0f));
+
+		FSProjectile Projectile;
+		Projectile.Definition = Definition;
+		Projectile.Location = Origin;
+		Projectile.Velocity = Direction * Definition->LaunchSpeed;
+		Projectile.FuseLeft = Definition->FuseTime;
+		Projectile.Seed = (uint16)Stream.RandHelper(MAX_uint16 + 1);
+		Projectile.bBenchmark = true;
+		Launch(Projectile);
+	}
+}
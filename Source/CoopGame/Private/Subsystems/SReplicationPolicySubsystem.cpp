@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SReplicationPolicySubsystem.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/SReplicationPolicyComponent.h"
+#include "SReplicationGraph.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopNetPolicy"), STATGROUP_CoopNetPolicy, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Update Policies"), STAT_NetPolicyUpdate, STATGROUP_CoopNetPolicy);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Policies"), STAT_NetPolicyCount, STATGROUP_CoopNetPolicy);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dormant"), STAT_NetPolicyDormant, STATGROUP_CoopNetPolicy);
+
+static int32 NetPolicy = 1;
+FAutoConsoleVariableRef CVARNetPolicy(
+	TEXT("COOP.NetPolicy"),
+	NetPolicy,
+	TEXT("Adjust net update frequency, priority and dormancy of bots, barrels, pickups and holstered weapons by distance to players"),
+	ECVF_Default);
+
+static float NetPolicyInterval = 0.25f;
+FAutoConsoleVariableRef CVARNetPolicyInterval(
+	TEXT("COOP.NetPolicyInterval"),
+	NetPolicyInterval,
+	TEXT("Seconds between replication policy updates"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs NetPolicyBenchmarkCmd(
+	TEXT("COOP.NetPolicyBenchmark"),
+	TEXT("Logs bytes sent and frame times on the server with the replication policies off and then on. ")
+	TEXT("Connect the clients and deploy the bots first, e.g. COOP.WaveDeployBenchmark 300, and watch stat net for the replication time. Usage: COOP.NetPolicyBenchmark [SecondsPerPhase=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USReplicationPolicySubsystem* Policies = World != nullptr ? World->GetSubsystem<USReplicationPolicySubsystem>() : nullptr;
+		if (Policies == nullptr)
+			return;
+
+		float Seconds = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f;
+		Policies->RunBenchmark(FMath::Max(Seconds, 1.0f));
+	}));
+
+static uint64 GetBytesSent(UWorld* World)
+{
+	UNetDriver* NetDriver = World->GetNetDriver();
+	return NetDriver != nullptr ? NetDriver->OutTotalBytes : 0;
+}
+
+// Server replication time, only measured when the replication graph drives replication
+static double GetReplicateSeconds(UWorld* World)
+{
+	UNetDriver* NetDriver = World->GetNetDriver();
+	USReplicationGraph* Graph = NetDriver != nullptr ? Cast<USReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+	return Graph != nullptr ? Graph->GetTotalReplicateSeconds() : -1.0;
+}
+
+void USReplicationPolicySubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_NetPolicyCount, Policies.Num());
+	Policies.Empty();
+	BenchmarkPhase = 0;
+
+	Super::Deinitialize();
+}
+
+bool USReplicationPolicySubsystem::IsTickable() const
+{
+	return !IsTemplate() && (Policies.Num() > 0 || BenchmarkPhase > 0);
+}
+
+TStatId USReplicationPolicySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USReplicationPolicySubsystem, STATGROUP_Tickables);
+}
+
+void USReplicationPolicySubsystem::Register(USReplicationPolicyComponent* Policy)
+{
+	if (Policy == nullptr || Policy->PolicyIndex != INDEX_NONE)
+		return;
+
+	Policy->PolicyIndex = Policies.Add(Policy);
+	INC_DWORD_STAT(STAT_NetPolicyCount);
+}
+
+void USReplicationPolicySubsystem::Unregister(USReplicationPolicyComponent* Policy)
+{
+	if (Policy == nullptr || !Policies.IsValidIndex(Policy->PolicyIndex) || Policies[Policy->PolicyIndex] != Policy)
+		return;
+
+	// Swap the last policy into the hole
+	int32 Index = Policy->PolicyIndex;
+	Policies.RemoveAtSwap(Index, 1, false);
+	if (Policies.IsValidIndex(Index))
+		Policies[Index]->PolicyIndex = Index;
+
+	Policy->PolicyIndex = INDEX_NONE;
+	DEC_DWORD_STAT(STAT_NetPolicyCount);
+}
+
+void USReplicationPolicySubsystem::Tick(float DeltaTime)
+{
+	if (BenchmarkPhase > 0)
+	{
+		double Now = FPlatformTime::Seconds();
+		double FrameSeconds = Now - BenchmarkLastFrameTime;
+		BenchmarkLastFrameTime = Now;
+
+		++BenchmarkFrames;
+		BenchmarkFrameSeconds += FrameSeconds;
+		BenchmarkWorstFrameSeconds = FMath::Max(BenchmarkWorstFrameSeconds, FrameSeconds);
+
+		if (Now - BenchmarkPhaseStartTime >= BenchmarkPhaseSeconds)
+		{
+			LogBenchmarkPhase(BenchmarkPhase == 1 ? TEXT("policies off") : TEXT("policies on"));
+
+			BenchmarkPhase = BenchmarkPhase == 1 ? 2 : 0;
+			BenchmarkPhaseStartTime = Now;
+			BenchmarkFrames = 0;
+			BenchmarkFrameSeconds = 0.0;
+			BenchmarkWorstFrameSeconds = 0.0;
+			BenchmarkUpdateSeconds = 0.0;
+			BenchmarkStartBytes = GetBytesSent(GetWorld());
+			BenchmarkStartReplicateSeconds = GetReplicateSeconds(GetWorld());
+
+			// Apply the new phase right away
+			TimeToUpdate = 0.0f;
+		}
+	}
+
+	TimeToUpdate -= DeltaTime;
+	if (TimeToUpdate > 0.0f)
+		return;
+
+	// Don't catch up on missed updates after a hitch
+	TimeToUpdate = FMath::Max(TimeToUpdate + NetPolicyInterval, 0.0f);
+
+	double StartTime = FPlatformTime::Seconds();
+
+	UpdatePolicies();
+
+	if (BenchmarkPhase > 0)
+		BenchmarkUpdateSeconds += FPlatformTime::Seconds() - StartTime;
+}
+
+void USReplicationPolicySubsystem::UpdatePolicies()
+{
+	SCOPE_CYCLE_COUNTER(STAT_NetPolicyUpdate);
+
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	USReplicationGraph* Graph = NetDriver != nullptr ? Cast<USReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+
+	bool bEnabled = NetPolicy > 0 && BenchmarkPhase != 1;
+	if (!bEnabled)
+	{
+		if (bPoliciesApplied)
+		{
+			for (USReplicationPolicyComponent* Policy : Policies)
+			{
+				Policy->RestoreDefaults(Graph);
+			}
+			bPoliciesApplied = false;
+
+			SET_DWORD_STAT(STAT_NetPolicyDormant, 0);
+		}
+		return;
+	}
+
+	UpdatePlayerDistances();
+
+	float Now = GetWorld()->GetTimeSeconds();
+	int32 NumDormant = 0;
+	for (int32 i = 0; i < Policies.Num(); ++i)
+	{
+		Policies[i]->UpdatePolicy(PlayerDistances[i], Now, Graph);
+		NumDormant += Policies[i]->IsDormant() ? 1 : 0;
+	}
+	bPoliciesApplied = true;
+
+	SET_DWORD_STAT(STAT_NetPolicyDormant, NumDormant);
+}
+
+void USReplicationPolicySubsystem::UpdatePlayerDistances()
+{
+	PlayerLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		if (PC == nullptr)
+			continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		PlayerLocations.Add(ViewLocation);
+	}
+
+	int32 NumPolicies = Policies.Num();
+	PlayerDistances.SetNumUninitialized(NumPolicies, false);
+	for (int32 i = 0; i < NumPolicies; ++i)
+	{
+		FVector Location = Policies[i]->GetOwner()->GetActorLocation();
+
+		float ClosestDistSquared = FLT_MAX;
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			ClosestDistSquared = FMath::Min(ClosestDistSquared, FVector::DistSquared(Location, PlayerLocation));
+		}
+		PlayerDistances[i] = ClosestDistSquared < FLT_MAX ? FMath::Sqrt(ClosestDistSquared) : FLT_MAX;
+	}
+}
+
+void USReplicationPolicySubsystem::RunBenchmark(float Seconds)
+{
+	if (BenchmarkPhase > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Net policy benchmark: still running"));
+		return;
+	}
+
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (NetDriver == nullptr || GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Net policy benchmark: run it on a server"));
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Net policy benchmark: %d policies, %d client connections, %.0f s per phase"),
+		Policies.Num(), NetDriver->ClientConnections.Num(), Seconds);
+
+	BenchmarkPhase = 1;
+	BenchmarkPhaseSeconds = Seconds;
+	BenchmarkPhaseStartTime = FPlatformTime::Seconds();
+	BenchmarkLastFrameTime = BenchmarkPhaseStartTime;
+	BenchmarkFrames = 0;
+	BenchmarkFrameSeconds = 0.0;
+	BenchmarkWorstFrameSeconds = 0.0;
+	BenchmarkUpdateSeconds = 0.0;
+	BenchmarkStartBytes = GetBytesSent(GetWorld());
+	BenchmarkStartReplicateSeconds = GetReplicateSeconds(GetWorld());
+	TimeToUpdate = 0.0f;
+}
+
+void USReplicationPolicySubsystem::LogBenchmarkPhase(const TCHAR* Name) const
+{
+	int32 NumDormant = 0;
+	for (const USReplicationPolicyComponent* Policy : Policies)
+	{
+		NumDormant += Policy->IsDormant() ? 1 : 0;
+	}
+
+	uint64 Bytes = GetBytesSent(GetWorld()) - BenchmarkStartBytes;
+	int32 Frames = FMath::Max(BenchmarkFrames, 1);
+	double KBPerSecond = Bytes / 1024.0 / FMath::Max(BenchmarkFrameSeconds, 0.001);
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	int32 NumConnections = NetDriver != nullptr ? FMath::Max(NetDriver->ClientConnections.Num(), 1) : 1;
+	UE_LOG(LogTemp, Log, TEXT("Net policy benchmark, %s: %d frames, %.0f bytes sent per frame (%.1f KB/s, %.1f KB/s per connection), frame %.2f ms avg / %.2f ms worst, policy updates %.3f ms per frame, %d of %d dormant"),
+		Name, BenchmarkFrames, (double)Bytes / Frames, KBPerSecond, KBPerSecond / NumConnections,
+		BenchmarkFrameSeconds * 1000.0 / Frames, BenchmarkWorstFrameSeconds * 1000.0, BenchmarkUpdateSeconds * 1000.0 / Frames,
+		NumDormant, Policies.Num());
+
+	if (BenchmarkStartReplicateSeconds >= 0.0)
+	{
+		double ReplicateSeconds = GetReplicateSeconds(GetWorld()) - BenchmarkStartReplicateSeconds;
+		UE_LOG(LogTemp, Log, TEXT("Net policy benchmark, %s: replication %.3f ms per frame, %.4f ms per connection"),
+			Name, ReplicateSeconds * 1000.0 / Frames, ReplicateSeconds * 1000.0 / Frames / NumConnections);
+	}
+}
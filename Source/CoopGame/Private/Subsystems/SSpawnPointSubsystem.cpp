@@ -0,0 +1,430 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SSpawnPointSubsystem.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/PlayerController.h"
+#include "NavigationSystem.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopSpawnPoints"), STATGROUP_CoopSpawnPoints, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Select Spawn Points"), STAT_SpawnPointSelect, STATGROUP_CoopSpawnPoints);
+DECLARE_CYCLE_STAT(TEXT("Score Candidates"), STAT_SpawnPointScore, STATGROUP_CoopSpawnPoints);
+DECLARE_CYCLE_STAT(TEXT("Line Of Sight"), STAT_SpawnPointLineOfSight, STATGROUP_CoopSpawnPoints);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Candidates"), STAT_SpawnPointCandidates, STATGROUP_CoopSpawnPoints);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Line Of Sight Traces"), STAT_SpawnPointTraces, STATGROUP_CoopSpawnPoints);
+
+static int32 SpawnPointCandidatesPerPoint = 16;
+FAutoConsoleVariableRef CVARSpawnPointCandidatesPerPoint(
+	TEXT("COOP.SpawnPointCandidatesPerPoint"),
+	SpawnPointCandidatesPerPoint,
+	TEXT("Candidate spawn locations generated around every actor tagged BotSpawnPoint, read when the level starts"),
+	ECVF_Default);
+
+static float SpawnPointCandidateRadius = 1000.0f;
+FAutoConsoleVariableRef CVARSpawnPointCandidateRadius(
+	TEXT("COOP.SpawnPointCandidateRadius"),
+	SpawnPointCandidateRadius,
+	TEXT("Radius around every BotSpawnPoint actor candidates are generated in"),
+	ECVF_Default);
+
+static float SpawnPointMinPlayerDistance = 1500.0f;
+FAutoConsoleVariableRef CVARSpawnPointMinPlayerDistance(
+	TEXT("COOP.SpawnPointMinPlayerDistance"),
+	SpawnPointMinPlayerDistance,
+	TEXT("Bots never spawn closer than this to a player"),
+	ECVF_Default);
+
+static float SpawnPointPreferredPlayerDistance = 3000.0f;
+FAutoConsoleVariableRef CVARSpawnPointPreferredPlayerDistance(
+	TEXT("COOP.SpawnPointPreferredPlayerDistance"),
+	SpawnPointPreferredPlayerDistance,
+	TEXT("Bots preferably spawn this far from the nearest player"),
+	ECVF_Default);
+
+static float SpawnPointMaxPlayerDistance = 8000.0f;
+FAutoConsoleVariableRef CVARSpawnPointMaxPlayerDistance(
+	TEXT("COOP.SpawnPointMaxPlayerDistance"),
+	SpawnPointMaxPlayerDistance,
+	TEXT("Bots never spawn further than this from every player"),
+	ECVF_Default);
+
+static float SpawnPointCrowdRadius = 400.0f;
+FAutoConsoleVariableRef CVARSpawnPointCrowdRadius(
+	TEXT("COOP.SpawnPointCrowdRadius"),
+	SpawnPointCrowdRadius,
+	TEXT("Bots within this radius crowd a spawn point, points picked together stay this far apart"),
+	ECVF_Default);
+
+static float SpawnPointCrowdPenalty = 0.1f;
+FAutoConsoleVariableRef CVARSpawnPointCrowdPenalty(
+	TEXT("COOP.SpawnPointCrowdPenalty"),
+	SpawnPointCrowdPenalty,
+	TEXT("Spawn point score lost per bot crowding it, distance scores range from 0 to 1"),
+	ECVF_Default);
+
+static int32 SpawnPointLineOfSight = 1;
+FAutoConsoleVariableRef CVARSpawnPointLineOfSight(
+	TEXT("COOP.SpawnPointLineOfSight"),
+	SpawnPointLineOfSight,
+	TEXT("Reject spawn points a player can see (0 = no line of sight traces)"),
+	ECVF_Default);
+
+static int32 SpawnPointChunks = 0;
+FAutoConsoleVariableRef CVARSpawnPointChunks(
+	TEXT("COOP.SpawnPointChunks"),
+	SpawnPointChunks,
+	TEXT("Parallel chunks for spawn point scoring (0 = one per worker thread, 1 = game thread only)"),
+	ECVF_Default);
+
+// Below this many candidates scoring stays on the game thread
+static const int32 MinCandidatesForParallelScoring = 256;
+
+// Line of sight traces per requested point before points are accepted unchecked
+static const int32 MaxTracesPerPoint = 4;
+
+static FAutoConsoleCommand SpawnPointBenchmarkCmd(
+	TEXT("COOP.SpawnPointBenchmark"),
+	TEXT("Logs spawn point selection latency with scoring on one and on all threads. Usage: COOP.SpawnPointBenchmark [NumCandidates=1000] [NumBots=500]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		int32 NumCandidates = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000, 1);
+		int32 NumBots = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 500, 0);
+		USSpawnPointSubsystem::RunSelectionBenchmark(NumCandidates, NumBots);
+	}));
+
+void USSpawnPointSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_SpawnPointCandidates, Candidates.Num());
+	Candidates.Empty();
+	CandidateRotations.Empty();
+	bCandidatesBuilt = false;
+
+	Super::Deinitialize();
+}
+
+int32 USSpawnPointSubsystem::GetNumCandidates()
+{
+	if (!bCandidatesBuilt)
+		BuildCandidates();
+
+	return Candidates.Num();
+}
+
+void USSpawnPointSubsystem::BuildCandidates()
+{
+	bCandidatesBuilt = true;
+
+	TArray<AActor*> SpawnPointActors;
+	UGameplayStatics::GetAllActorsWithTag(this, TEXT("BotSpawnPoint"), SpawnPointActors);
+
+	UNavigationSystemV1* NavSys = UNavigationSystemV1::GetCurrent<UNavigationSystemV1>(GetWorld());
+	FVector QueryExtent(SpawnPointCandidateRadius * 0.25f, SpawnPointCandidateRadius * 0.25f, 500.0f);
+
+	// Same candidates every time the level is played
+	FRandomStream Stream(1234);
+
+	for (AActor* SpawnPointActor : SpawnPointActors)
+	{
+		FVector Origin = SpawnPointActor->GetActorLocation();
+
+		// Scattered candidates keep the actor's height above the navmesh
+		FNavLocation NavOrigin;
+		float HeightAboveNav = 0.0f;
+		if (NavSys != nullptr && NavSys->ProjectPointToNavigation(Origin, NavOrigin, QueryExtent))
+			HeightAboveNav = Origin.Z - NavOrigin.Location.Z;
+
+		// The actor itself is always a candidate, the rest are scattered around it and dropped if off the navmesh
+		Candidates.Add(Origin);
+		CandidateRotations.Add(SpawnPointActor->GetActorRotation());
+
+		for (int32 i = 1; i < SpawnPointCandidatesPerPoint; ++i)
+		{
+			float Angle = Stream.FRandRange(0.0f, 2.0f * PI);
+			float Radius = SpawnPointCandidateRadius * FMath::Sqrt(Stream.FRand());
+			FVector Point = Origin + FVector(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, 0.0f);
+
+			if (NavSys != nullptr)
+			{
+				FNavLocation NavLocation;
+				if (!NavSys->ProjectPointToNavigation(Point, NavLocation, QueryExtent))
+					continue;
+
+				Point = NavLocation.Location + FVector(0.0f, 0.0f, HeightAboveNav);
+			}
+
+			Candidates.Add(Point);
+			CandidateRotations.Add(SpawnPointActor->GetActorRotation());
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_SpawnPointCandidates, Candidates.Num());
+}
+
+FSpawnPointScoreParams USSpawnPointSubsystem::GetScoreParams()
+{
+	FSpawnPointScoreParams Params;
+	Params.MinPlayerDistance = SpawnPointMinPlayerDistance;
+	Params.PreferredPlayerDistance = FMath::Max(SpawnPointPreferredPlayerDistance, 1.0f);
+	Params.MaxPlayerDistance = SpawnPointMaxPlayerDistance;
+	Params.CrowdRadius = FMath::Max(SpawnPointCrowdRadius, 1.0f);
+	Params.CrowdPenalty = SpawnPointCrowdPenalty;
+	return Params;
+}
+
+void USSpawnPointSubsystem::ScoreCandidates(const TArray<FVector>& InCandidates, const TArray<FVector>& PlayerLocations, const FSpatialHashGrid& InCrowd,
+	const FSpawnPointScoreParams& Params, TArray<float>& OutScores, int32 NumChunks)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpawnPointScore);
+
+	int32 NumCandidates = InCandidates.Num();
+	OutScores.SetNumUninitialized(NumCandidates, false);
+	if (NumCandidates == 0)
+		return;
+
+	NumChunks = FMath::Clamp(NumChunks, 1, NumCandidates);
+	int32 ChunkSize = FMath::DivideAndRoundUp(NumCandidates, NumChunks);
+
+	float MinDistanceSq = FMath::Square(Params.MinPlayerDistance);
+	float MaxDistanceSq = FMath::Square(Params.MaxPlayerDistance);
+
+	// Every chunk writes its own range of OutScores, everything else is read only
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		int32 End = FMath::Min((Chunk + 1) * ChunkSize, NumCandidates);
+		for (int32 i = Chunk * ChunkSize; i < End; ++i)
+		{
+			const FVector& Candidate = InCandidates[i];
+
+			float DistanceScore = 0.0f;
+			if (PlayerLocations.Num() > 0)
+			{
+				float NearestDistSq = FLT_MAX;
+				for (const FVector& PlayerLocation : PlayerLocations)
+				{
+					NearestDistSq = FMath::Min(NearestDistSq, FVector::DistSquared(Candidate, PlayerLocation));
+				}
+
+				if (NearestDistSq < MinDistanceSq || NearestDistSq > MaxDistanceSq)
+				{
+					OutScores[i] = -FLT_MAX;
+					continue;
+				}
+
+				float Distance = FMath::Sqrt(NearestDistSq);
+				DistanceScore = FMath::Max(1.0f - FMath::Abs(Distance - Params.PreferredPlayerDistance) / Params.PreferredPlayerDistance, 0.0f);
+			}
+
+			OutScores[i] = DistanceScore - Params.CrowdPenalty * InCrowd.CountPointsNear(Candidate, Params.CrowdRadius);
+		}
+	}, NumChunks == 1);
+}
+
+void USSpawnPointSubsystem::SortCandidates(const TArray<float>& InScores, TArray<int32>& OutOrder)
+{
+	OutOrder.Reset();
+	for (int32 i = 0; i < InScores.Num(); ++i)
+	{
+		if (InScores[i] > -FLT_MAX)
+			OutOrder.Add(i);
+	}
+
+	OutOrder.Sort([&InScores](int32 A, int32 B) { return InScores[A] > InScores[B]; });
+}
+
+int32 USSpawnPointSubsystem::FindFallbackCandidate(const TArray<FVector>& InCandidates, const TArray<FVector>& PlayerLocations, const FSpawnPointScoreParams& Params)
+{
+	int32 BestIndex = INDEX_NONE;
+	float BestOutside = FLT_MAX;
+	for (int32 i = 0; i < InCandidates.Num(); ++i)
+	{
+		float NearestDistSq = FLT_MAX;
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			NearestDistSq = FMath::Min(NearestDistSq, FVector::DistSquared(InCandidates[i], PlayerLocation));
+		}
+
+		// Distance outside [MinPlayerDistance, MaxPlayerDistance], the farthest candidate wins while players are too close to all of them
+		float Distance = NearestDistSq < FLT_MAX ? FMath::Sqrt(NearestDistSq) : Params.MinPlayerDistance;
+		float Outside = FMath::Max(Params.MinPlayerDistance - Distance, 0.0f) + FMath::Max(Distance - Params.MaxPlayerDistance, 0.0f);
+		if (Outside < BestOutside)
+		{
+			BestOutside = Outside;
+			BestIndex = i;
+		}
+	}
+	return BestIndex;
+}
+
+void USSpawnPointSubsystem::PickSpacedCandidates(const TArray<int32>& InOrder, const TArray<FVector>& InCandidates, int32 NumPoints, float MinSpacing,
+	TFunctionRef<bool(const FVector&)> IsRejected, TArray<int32>& OutPicked)
+{
+	OutPicked.Reset();
+
+	float MinSpacingSq = FMath::Square(MinSpacing);
+	for (int32 CandidateIndex : InOrder)
+	{
+		if (OutPicked.Num() >= NumPoints)
+			break;
+
+		const FVector& Candidate = InCandidates[CandidateIndex];
+
+		// Keep points of the same batch apart
+		bool bTooClose = false;
+		for (int32 PickedIndex : OutPicked)
+		{
+			if (FVector::DistSquared(InCandidates[PickedIndex], Candidate) < MinSpacingSq)
+			{
+				bTooClose = true;
+				break;
+			}
+		}
+		if (bTooClose || IsRejected(Candidate))
+			continue;
+
+		OutPicked.Add(CandidateIndex);
+	}
+
+	// Players seeing every candidate must not stall the wave, the best one is hidden the least badly
+	if (OutPicked.Num() == 0 && InOrder.Num() > 0 && NumPoints > 0)
+		OutPicked.Add(InOrder[0]);
+}
+
+int32 USSpawnPointSubsystem::SelectSpawnPoints(int32 NumPoints, TArray<FTransform>& OutTransforms)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpawnPointSelect);
+
+	OutTransforms.Reset();
+	if (NumPoints <= 0 || GetNumCandidates() == 0)
+		return 0;
+
+	// Players and where they look from
+	TArray<FVector> PlayerLocations;
+	TArray<FVector> PlayerViewLocations;
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(SpawnPointLineOfSight), false);
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		if (PC == nullptr || PC->GetPawn() == nullptr)
+			continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		PlayerLocations.Add(PC->GetPawn()->GetActorLocation());
+		PlayerViewLocations.Add(ViewLocation);
+		QueryParams.AddIgnoredActor(PC->GetPawn());
+	}
+
+	FSpawnPointScoreParams Params = GetScoreParams();
+
+	// Crowding by live bots
+	USTrackerBotSubsystem* TrackerBots = GetWorld()->GetSubsystem<USTrackerBotSubsystem>();
+	BotLocations.Reset();
+	if (TrackerBots != nullptr)
+		BotLocations.Append(TrackerBots->GetBotLocations());
+	Crowd.Build(BotLocations, Params.CrowdRadius);
+
+	int32 NumChunks = SpawnPointChunks > 0 ? SpawnPointChunks : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	if (Candidates.Num() < MinCandidatesForParallelScoring)
+		NumChunks = 1;
+
+	ScoreCandidates(Candidates, PlayerLocations, Crowd, Params, Scores, NumChunks);
+	SortCandidates(Scores, Order);
+
+	// Players standing at every spawn point must not stall the wave
+	if (Order.Num() == 0)
+	{
+		int32 FallbackIndex = FindFallbackCandidate(Candidates, PlayerLocations, Params);
+		OutTransforms.Add(FTransform(CandidateRotations[FallbackIndex], Candidates[FallbackIndex]));
+		return OutTransforms.Num();
+	}
+
+	int32 TracesLeft = SpawnPointLineOfSight > 0 ? NumPoints * MaxTracesPerPoint : 0;
+	PickSpacedCandidates(Order, Candidates, NumPoints, Params.CrowdRadius, [&](const FVector& Candidate)
+	{
+		if (TracesLeft <= 0)
+			return false;
+
+		--TracesLeft;
+		return IsVisibleToPlayers(Candidate, PlayerViewLocations, QueryParams);
+	}, Picked);
+
+	for (int32 CandidateIndex : Picked)
+	{
+		OutTransforms.Add(FTransform(CandidateRotations[CandidateIndex], Candidates[CandidateIndex]));
+	}
+
+	return OutTransforms.Num();
+}
+
+bool USSpawnPointSubsystem::IsVisibleToPlayers(const FVector& Location, const TArray<FVector>& PlayerViewLocations, const FCollisionQueryParams& QueryParams) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpawnPointLineOfSight);
+
+	for (const FVector& ViewLocation : PlayerViewLocations)
+	{
+		INC_DWORD_STAT(STAT_SpawnPointTraces);
+
+		// Blocked means hidden from this player
+		if (!GetWorld()->LineTraceTestByChannel(ViewLocation, Location, ECC_Visibility, QueryParams))
+			return true;
+	}
+	return false;
+}
+
+void USSpawnPointSubsystem::RunSelectionBenchmark(int32 NumCandidates, int32 NumBots)
+{
+	FRandomStream Stream(1234);
+
+	TArray<FVector> BenchmarkCandidates;
+	for (int32 i = 0; i < NumCandidates; ++i)
+	{
+		BenchmarkCandidates.Add(FVector(Stream.FRandRange(-10000.0f, 10000.0f), Stream.FRandRange(-10000.0f, 10000.0f), 0.0f));
+	}
+
+	TArray<FVector> BenchmarkBots;
+	for (int32 i = 0; i < NumBots; ++i)
+	{
+		BenchmarkBots.Add(FVector(Stream.FRandRange(-10000.0f, 10000.0f), Stream.FRandRange(-10000.0f, 10000.0f), 0.0f));
+	}
+
+	TArray<FVector> Players;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		Players.Add(FVector(Stream.FRandRange(-2000.0f, 2000.0f), Stream.FRandRange(-2000.0f, 2000.0f), 0.0f));
+	}
+
+	FSpawnPointScoreParams Params = GetScoreParams();
+
+	const int32 NumRuns = 50;
+	const int32 ChunkCounts[] = { 1, FTaskGraphInterface::Get().GetNumWorkerThreads() + 1 };
+
+	FSpatialHashGrid BenchmarkCrowd;
+	TArray<float> BenchmarkScores;
+	TArray<int32> BenchmarkOrder;
+	double SingleUs = 0.0;
+	for (int32 NumChunks : ChunkCounts)
+	{
+		// Warm up the workers
+		BenchmarkCrowd.Build(BenchmarkBots, Params.CrowdRadius);
+		ScoreCandidates(BenchmarkCandidates, Players, BenchmarkCrowd, Params, BenchmarkScores, NumChunks);
+
+		// Everything a selection does except the line of sight traces
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Run = 0; Run < NumRuns; ++Run)
+		{
+			BenchmarkCrowd.Build(BenchmarkBots, Params.CrowdRadius);
+			ScoreCandidates(BenchmarkCandidates, Players, BenchmarkCrowd, Params, BenchmarkScores, NumChunks);
+			SortCandidates(BenchmarkScores, BenchmarkOrder);
+		}
+		double ElapsedUs = (FPlatformTime::Seconds() - StartTime) * 1.0e6 / NumRuns;
+		if (NumChunks == 1)
+			SingleUs = ElapsedUs;
+
+		UE_LOG(LogTemp, Log, TEXT("SpawnPoint benchmark: %d candidates, %d bots, %d chunks, %.1f us per selection (%.2fx), %d valid"),
+			NumCandidates, NumBots, NumChunks, ElapsedUs, ElapsedUs > 0.0 ? SingleUs / ElapsedUs : 0.0, BenchmarkOrder.Num());
+	}
+}
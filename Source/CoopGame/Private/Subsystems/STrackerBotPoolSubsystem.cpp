@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/STrackerBotPoolSubsystem.h"
+#include "Engine/World.h"
+#include "AI/STrackerBot.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopBotPool"), STATGROUP_CoopBotPool, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Spawn Bot"), STAT_BotPoolSpawn, STATGROUP_CoopBotPool);
+DECLARE_CYCLE_STAT(TEXT("Prewarm"), STAT_BotPoolPrewarm, STATGROUP_CoopBotPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Hits"), STAT_BotPoolHits, STATGROUP_CoopBotPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Misses (Spawns)"), STAT_BotPoolMisses, STATGROUP_CoopBotPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Free Bots"), STAT_BotPoolFree, STATGROUP_CoopBotPool);
+
+static int32 BotPooling = 1;
+FAutoConsoleVariableRef CVARBotPooling(
+	TEXT("COOP.BotPooling"),
+	BotPooling,
+	TEXT("Reuse exploded tracker bots and prewarm them between waves (0 = SpawnActor and destroy every bot)"),
+	ECVF_Default);
+
+// Totals since the last COOP.BotPoolReport
+static int32 PooledSpawns = 0;
+static int32 FreshSpawns = 0;
+static int32 PrewarmedBots = 0;
+static double PooledSpawnSeconds = 0.0;
+static double FreshSpawnSeconds = 0.0;
+static double PrewarmSeconds = 0.0;
+
+static FAutoConsoleCommandWithWorld BotPoolReportCmd(
+	TEXT("COOP.BotPoolReport"),
+	TEXT("Logs the average cost of pooled and newly spawned tracker bots since the last report and resets the counters"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		USTrackerBotPoolSubsystem* BotPool = World != nullptr ? World->GetSubsystem<USTrackerBotPoolSubsystem>() : nullptr;
+
+		UE_LOG(LogTemp, Log, TEXT("Bot pool: %d pooled spawns %.1f us avg, %d new spawns %.1f us avg, %d bots prewarmed in %.2f ms, %d free"),
+			PooledSpawns, PooledSpawns > 0 ? PooledSpawnSeconds * 1.0e6 / PooledSpawns : 0.0,
+			FreshSpawns, FreshSpawns > 0 ? FreshSpawnSeconds * 1.0e6 / FreshSpawns : 0.0,
+			PrewarmedBots, PrewarmSeconds * 1.0e3, BotPool != nullptr ? BotPool->GetNumFree() : 0);
+
+		PooledSpawns = 0;
+		FreshSpawns = 0;
+		PrewarmedBots = 0;
+		PooledSpawnSeconds = 0.0;
+		FreshSpawnSeconds = 0.0;
+		PrewarmSeconds = 0.0;
+	}));
+
+void USTrackerBotPoolSubsystem::Deinitialize()
+{
+	// Bots are actors of the world and go away with it
+	DEC_DWORD_STAT_BY(STAT_BotPoolFree, GetNumFree());
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+bool USTrackerBotPoolSubsystem::IsPoolingEnabled()
+{
+	return BotPooling > 0;
+}
+
+int32 USTrackerBotPoolSubsystem::GetNumFree() const
+{
+	int32 NumFree = 0;
+	for (const TPair<UClass*, FTrackerBotPool>& Pair : Pools)
+	{
+		NumFree += Pair.Value.Free.Num();
+	}
+	return NumFree;
+}
+
+int32 USTrackerBotPoolSubsystem::GetNumFree(TSubclassOf<ASTrackerBot> BotClass) const
+{
+	const FTrackerBotPool* Pool = Pools.Find(BotClass);
+	return Pool != nullptr ? Pool->Free.Num() : 0;
+}
+
+ASTrackerBot* USTrackerBotPoolSubsystem::SpawnBotAt(TSubclassOf<ASTrackerBot> BotClass, const FTransform& Transform)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BotPoolSpawn);
+
+	if (BotClass == nullptr || GetWorld()->GetNetMode() == NM_Client)
+		return nullptr;
+
+	double StartTime = FPlatformTime::Seconds();
+
+	FTrackerBotPool* Pool = IsPoolingEnabled() ? Pools.Find(BotClass) : nullptr;
+	while (Pool != nullptr && Pool->Free.Num() > 0)
+	{
+		ASTrackerBot* Bot = Pool->Free.Pop(false);
+		DEC_DWORD_STAT(STAT_BotPoolFree);
+
+		// Destroyed while parked, e.g. by a level script
+		if (!IsValid(Bot))
+			continue;
+
+		Bot->ActivateFromPool(Transform);
+
+		INC_DWORD_STAT(STAT_BotPoolHits);
+		++PooledSpawns;
+		PooledSpawnSeconds += FPlatformTime::Seconds() - StartTime;
+		return Bot;
+	}
+
+	ASTrackerBot* Bot = SpawnNewBot(BotClass, Transform, false);
+
+	INC_DWORD_STAT(STAT_BotPoolMisses);
+	++FreshSpawns;
+	FreshSpawnSeconds += FPlatformTime::Seconds() - StartTime;
+	return Bot;
+}
+
+void USTrackerBotPoolSubsystem::Prewarm(TSubclassOf<ASTrackerBot> BotClass, int32 Count)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BotPoolPrewarm);
+
+	if (!IsPoolingEnabled() || BotClass == nullptr || GetWorld()->GetNetMode() == NM_Client)
+		return;
+
+	double StartTime = FPlatformTime::Seconds();
+
+	FTrackerBotPool& Pool = Pools.FindOrAdd(BotClass);
+	while (Pool.Free.Num() < Count)
+	{
+		ASTrackerBot* Bot = SpawnNewBot(BotClass, FTransform::Identity, true);
+		if (Bot == nullptr)
+			break;
+
+		Pool.Free.Add(Bot);
+		INC_DWORD_STAT(STAT_BotPoolFree);
+		++PrewarmedBots;
+	}
+
+	PrewarmSeconds += FPlatformTime::Seconds() - StartTime;
+}
+
+void USTrackerBotPoolSubsystem::ReleaseBot(ASTrackerBot* Bot)
+{
+	if (!IsValid(Bot))
+		return;
+
+	if (!IsPoolingEnabled())
+	{
+		Bot->Destroy();
+		return;
+	}
+
+	Bot->DeactivateToPool();
+
+	Pools.FindOrAdd(Bot->GetClass()).Free.Add(Bot);
+	INC_DWORD_STAT(STAT_BotPoolFree);
+}
+
+ASTrackerBot* USTrackerBotPoolSubsystem::SpawnNewBot(TSubclassOf<ASTrackerBot> BotClass, const FTransform& Transform, bool bInPool)
+{
+	// Deferred so prewarmed bots begin play already parked
+	ASTrackerBot* Bot = GetWorld()->SpawnActorDeferred<ASTrackerBot>(BotClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (Bot == nullptr)
+		return nullptr;
+
+	// No overlaps while registering components, BeginPlay parks the rest
+	Bot->PoolState.bInPool = bInPool;
+	Bot->SetActorEnableCollision(!bInPool);
+	Bot->FinishSpawning(Transform);
+
+	return Bot;
+}
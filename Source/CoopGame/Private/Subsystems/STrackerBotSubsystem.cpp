@@ -0,0 +1,600 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/STrackerBotSubsystem.h"
+#include "Engine/World.h"
+#include "AI/STrackerBot.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/SHealthComponent.h"
+#include "Subsystems/SHealthRegistrySubsystem.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopTrackerBots"), STATGROUP_CoopTrackerBots, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Build Spatial Hash"), STAT_TrackerBotSpatialHash, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Update Power Levels"), STAT_TrackerBotPowerLevels, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Bot Frame Time"), STAT_TrackerBotFrame, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Update Bots"), STAT_TrackerBotUpdate, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Select Targets"), STAT_TrackerBotSelectTargets, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Compute Steering"), STAT_TrackerBotComputeSteering, STATGROUP_CoopTrackerBots);
+DECLARE_CYCLE_STAT(TEXT("Apply Steering"), STAT_TrackerBotApplySteering, STATGROUP_CoopTrackerBots);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Live Bots"), STAT_TrackerBotsLive, STATGROUP_CoopTrackerBots);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bots Updated"), STAT_TrackerBotsUpdated, STATGROUP_CoopTrackerBots);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budget Overruns"), STAT_TrackerBotBudgetOverruns, STATGROUP_CoopTrackerBots);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bots Deferred"), STAT_TrackerBotsDeferred, STATGROUP_CoopTrackerBots);
+
+static float BotPowerLevelInterval = 1.0f;
+FAutoConsoleVariableRef CVARBotPowerLevelInterval(
+	TEXT("COOP.BotPowerLevelInterval"),
+	BotPowerLevelInterval,
+	TEXT("Seconds between tracker bot power level updates (0 = every frame)"),
+	ECVF_Default);
+
+static float BotUpdateBudgetUs = 2000.0f;
+FAutoConsoleVariableRef CVARBotUpdateBudgetUs(
+	TEXT("COOP.BotUpdateBudgetUs"),
+	BotUpdateBudgetUs,
+	TEXT("Microseconds per frame for tracker bot steering and path refreshes, bots over budget are deferred to the next frame"),
+	ECVF_Default);
+
+static float BotLODNearDistance = 3000.0f;
+FAutoConsoleVariableRef CVARBotLODNearDistance(
+	TEXT("COOP.BotLODNearDistance"),
+	BotLODNearDistance,
+	TEXT("Tracker bots closer than this to a player update their steering every frame"),
+	ECVF_Default);
+
+static float BotLODFarDistance = 8000.0f;
+FAutoConsoleVariableRef CVARBotLODFarDistance(
+	TEXT("COOP.BotLODFarDistance"),
+	BotLODFarDistance,
+	TEXT("Tracker bots further than this from every player use COOP.BotLODFarInterval"),
+	ECVF_Default);
+
+static float BotLODMidInterval = 0.1f;
+FAutoConsoleVariableRef CVARBotLODMidInterval(
+	TEXT("COOP.BotLODMidInterval"),
+	BotLODMidInterval,
+	TEXT("Seconds between steering updates of tracker bots between the near and far distance"),
+	ECVF_Default);
+
+static float BotLODFarInterval = 0.25f;
+FAutoConsoleVariableRef CVARBotLODFarInterval(
+	TEXT("COOP.BotLODFarInterval"),
+	BotLODFarInterval,
+	TEXT("Seconds between steering updates of tracker bots far from every player"),
+	ECVF_Default);
+
+static int32 BotTargetChunks = 0;
+FAutoConsoleVariableRef CVARBotTargetChunks(
+	TEXT("COOP.BotTargetChunks"),
+	BotTargetChunks,
+	TEXT("Parallel chunks for tracker bot target selection (0 = one per worker thread, 1 = game thread only)"),
+	ECVF_Default);
+
+// Below this many bots target selection stays on the game thread, scheduling costs more than it saves
+static const int32 MinBotsForParallelTargets = 128;
+
+static FAutoConsoleCommand BotTargetBenchmarkCmd(
+	TEXT("COOP.BotTargetBenchmark"),
+	TEXT("Logs tracker bot target selection time on the game thread and split over every task graph thread, one line per run. ")
+	TEXT("For thread scaling run it once per launch with -numworkerthreads=1, 2, 4 and 8. Usage: COOP.BotTargetBenchmark [NumBots=2000] [NumTargets=64]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		int32 NumBots = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 2000, 1);
+		int32 NumTargets = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 64, 1);
+		USTrackerBotSubsystem::RunTargetSelectionBenchmark(NumBots, NumTargets);
+	}));
+
+static FAutoConsoleCommand BotSteeringBenchmarkCmd(
+	TEXT("COOP.BotSteeringBenchmark"),
+	TEXT("Logs tracker bot steering throughput of the scalar and vectorized kernels. Usage: COOP.BotSteeringBenchmark [NumBots=10000] [Iterations=100]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		int32 NumBots = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000, 1);
+		int32 Iterations = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100, 1);
+
+		double ScalarBotsPerUs, VectorBotsPerUs;
+		FBotSteeringBatch::RunBenchmark(NumBots, Iterations, ScalarBotsPerUs, VectorBotsPerUs);
+
+		UE_LOG(LogTemp, Log, TEXT("BotSteering benchmark: %d bots x %d, scalar %.1f bots/us, %s %.1f bots/us (%.2fx)"),
+			NumBots, Iterations, ScalarBotsPerUs, FBotSteeringBatch::IsVectorized() ? TEXT("SSE2") : TEXT("scalar fallback"), VectorBotsPerUs,
+			ScalarBotsPerUs > 0.0 ? VectorBotsPerUs / ScalarBotsPerUs : 0.0);
+	}));
+
+static FAutoConsoleCommand BotPowerLevelBenchmarkCmd(
+	TEXT("COOP.BotPowerLevelBenchmark"),
+	TEXT("Logs the cost of computing every bot's power level with the spatial hash and by brute force for 100, 500 and 2000 bots. Usage: COOP.BotPowerLevelBenchmark [BotCount...]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		TArray<int32> BotCounts;
+		for (const FString& Arg : Args)
+		{
+			BotCounts.Add(FMath::Max(FCString::Atoi(*Arg), 1));
+		}
+		if (BotCounts.Num() == 0)
+			BotCounts = { 100, 500, 2000 };
+
+		for (int32 NumBots : BotCounts)
+		{
+			USTrackerBotSubsystem::RunPowerLevelBenchmark(NumBots);
+		}
+	}));
+
+void FSpatialHashGrid::Build(const TArray<FVector>& InPoints, float InCellSize)
+{
+	Points = &InPoints;
+	CellSize = FMath::Max(InCellSize, 1.0f);
+
+	int32 NumPoints = InPoints.Num();
+	uint32 TableSize = FMath::RoundUpToPowerOfTwo(FMath::Max(NumPoints * 2, 16));
+	TableMask = TableSize - 1;
+
+	BucketStarts.Reset();
+	BucketStarts.SetNumZeroed(TableSize + 1);
+	SortedPoints.SetNumUninitialized(NumPoints, false);
+	PointBuckets.SetNumUninitialized(NumPoints, false);
+
+	// Count points per bucket
+	for (int32 i = 0; i < NumPoints; ++i)
+	{
+		uint32 Bucket = HashCell(GetCell(InPoints[i]));
+		PointBuckets[i] = Bucket;
+		++BucketStarts[Bucket + 1];
+	}
+
+	// Prefix sum into bucket start offsets
+	for (uint32 Bucket = 1; Bucket <= TableSize; ++Bucket)
+	{
+		BucketStarts[Bucket] += BucketStarts[Bucket - 1];
+	}
+
+	// Scatter, BucketStarts[B] ends up at the start of bucket B + 1 and is shifted back afterwards
+	for (int32 i = 0; i < NumPoints; ++i)
+	{
+		SortedPoints[BucketStarts[PointBuckets[i]]++] = i;
+	}
+	for (uint32 Bucket = TableSize; Bucket > 0; --Bucket)
+	{
+		BucketStarts[Bucket] = BucketStarts[Bucket - 1];
+	}
+	BucketStarts[0] = 0;
+}
+
+int32 FSpatialHashGrid::CountNeighbours(int32 Index, float Radius) const
+{
+	return CountPointsNear((*Points)[Index], Radius, Index);
+}
+
+int32 FSpatialHashGrid::CountPointsNear(const FVector& Center, float Radius, int32 IgnoreIndex) const
+{
+	if (Points == nullptr || Points->Num() == 0)
+		return 0;
+
+	FIntVector CenterCell = GetCell(Center);
+	float RadiusSq = FMath::Square(Radius);
+
+	// Different cells can share a bucket, only visit each bucket once
+	uint32 VisitedBuckets[27];
+	int32 NumVisited = 0;
+
+	int32 Count = 0;
+	for (int32 Z = -1; Z <= 1; ++Z)
+	{
+		for (int32 Y = -1; Y <= 1; ++Y)
+		{
+			for (int32 X = -1; X <= 1; ++X)
+			{
+				uint32 Bucket = HashCell(CenterCell + FIntVector(X, Y, Z));
+
+				bool bVisited = false;
+				for (int32 i = 0; i < NumVisited && !bVisited; ++i)
+				{
+					bVisited = VisitedBuckets[i] == Bucket;
+				}
+				if (bVisited)
+					continue;
+				VisitedBuckets[NumVisited++] = Bucket;
+
+				for (int32 i = BucketStarts[Bucket]; i < BucketStarts[Bucket + 1]; ++i)
+				{
+					int32 Other = SortedPoints[i];
+					if (Other != IgnoreIndex && FVector::DistSquared(Center, (*Points)[Other]) <= RadiusSq)
+						++Count;
+				}
+			}
+		}
+	}
+
+	return Count;
+}
+
+uint32 FSpatialHashGrid::HashCell(const FIntVector& Cell) const
+{
+	// Large primes, see Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+	return ((uint32)Cell.X * 73856093u ^ (uint32)Cell.Y * 19349663u ^ (uint32)Cell.Z * 83492791u) & TableMask;
+}
+
+FIntVector FSpatialHashGrid::GetCell(const FVector& Point) const
+{
+	return FIntVector(FMath::FloorToInt(Point.X / CellSize), FMath::FloorToInt(Point.Y / CellSize), FMath::FloorToInt(Point.Z / CellSize));
+}
+
+void USTrackerBotSubsystem::Deinitialize()
+{
+	for (ASTrackerBot* Bot : Bots)
+	{
+		if (Bot != nullptr)
+			Bot->BotSubsystemIndex = INDEX_NONE;
+	}
+
+	DEC_DWORD_STAT_BY(STAT_TrackerBotsLive, Bots.Num());
+	Bots.Empty();
+	BotLocations.Empty();
+	NextUpdateTimes.Empty();
+	NextRefreshTimes.Empty();
+	BotTeams.Empty();
+	Targets.Empty();
+	BestTargets.Empty();
+
+	Super::Deinitialize();
+}
+
+void USTrackerBotSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TrackerBotFrame);
+
+	PlayerLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		if (PC != nullptr && PC->GetPawn() != nullptr)
+			PlayerLocations.Add(PC->GetPawn()->GetActorLocation());
+	}
+
+	UpdateTargets();
+
+	float MaxRadius = 0.0f;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TrackerBotSpatialHash);
+
+		for (const ASTrackerBot* Bot : Bots)
+		{
+			MaxRadius = FMath::Max(MaxRadius, Bot->DistanceToCheckNearbyBots);
+		}
+
+		SpatialHash.Build(BotLocations, MaxRadius);
+	}
+
+	float Now = GetWorld()->GetTimeSeconds();
+	if (Now >= NextPowerLevelTime)
+	{
+		NextPowerLevelTime = Now + BotPowerLevelInterval;
+		UpdatePowerLevels();
+	}
+
+	int32 NumUpdated = UpdateBots(Now);
+	INC_DWORD_STAT_BY(STAT_TrackerBotsUpdated, NumUpdated);
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TrackerBotComputeSteering);
+
+		// Locations are from the start of the frame, nothing moved the bots since
+		SteeringBatch.Reset(Bots.Num());
+		for (int32 i = 0; i < Bots.Num(); ++i)
+		{
+			const ASTrackerBot* Bot = Bots[i];
+			SteeringBatch.SetBot(i, &BotLocations[i].X, &Bot->NextPathPoint.X, Bot->MovementForce, Bot->RequiredDistanceToTarget);
+		}
+
+		SteeringBatch.Compute();
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TrackerBotApplySteering);
+
+		for (int32 i = 0; i < Bots.Num(); ++i)
+		{
+			FVector Force(SteeringBatch.ForceX[i], SteeringBatch.ForceY[i], SteeringBatch.ForceZ[i]);
+			Bots[i]->ApplySteering(Force, (SteeringBatch.Flags[i] & BOTSTEERING_WantsToJump) != 0);
+		}
+	}
+}
+
+int32 USTrackerBotSubsystem::UpdateBots(float Now)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TrackerBotUpdate);
+
+	int32 NumBots = Bots.Num();
+	if (NumBots == 0)
+		return 0;
+
+	uint32 StartCycles = FPlatformTime::Cycles();
+	uint32 BudgetCycles = (uint32)(BotUpdateBudgetUs / (FPlatformTime::GetSecondsPerCycle() * 1000000.0));
+
+	UpdateCursor = UpdateCursor % NumBots;
+
+	int32 NumUpdated = 0;
+	for (int32 n = 0; n < NumBots; ++n)
+	{
+		int32 i = (UpdateCursor + n) % NumBots;
+		bool bUpdateDue = Now >= NextUpdateTimes[i];
+		bool bRefreshDue = Now >= NextRefreshTimes[i];
+		if (!bUpdateDue && !bRefreshDue)
+			continue;
+
+		// Always make some progress, the rest waits for the next frame starting where we stopped
+		if (NumUpdated > 0 && FPlatformTime::Cycles() - StartCycles > BudgetCycles)
+		{
+			INC_DWORD_STAT(STAT_TrackerBotBudgetOverruns);
+			INC_DWORD_STAT_BY(STAT_TrackerBotsDeferred, NumBots - n);
+			UpdateCursor = i;
+			return NumUpdated;
+		}
+
+		ASTrackerBot* Bot = Bots[i];
+		if (bRefreshDue)
+		{
+			NextRefreshTimes[i] = Now + Bot->RefreshPathInterval;
+			Bot->RefreshPath();
+		}
+
+		if (bUpdateDue)
+		{
+			NextUpdateTimes[i] = Now + GetUpdateInterval(BotLocations[i]);
+			Bot->UpdateSteering();
+		}
+
+		++NumUpdated;
+	}
+
+	return NumUpdated;
+}
+
+float USTrackerBotSubsystem::GetUpdateInterval(const FVector& Location) const
+{
+	float NearestDistSq = FLT_MAX;
+	for (const FVector& PlayerLocation : PlayerLocations)
+	{
+		NearestDistSq = FMath::Min(NearestDistSq, FVector::DistSquared(Location, PlayerLocation));
+	}
+
+	if (NearestDistSq < FMath::Square(BotLODNearDistance))
+		return 0.0f;
+
+	return NearestDistSq < FMath::Square(BotLODFarDistance) ? BotLODMidInterval : BotLODFarInterval;
+}
+
+bool USTrackerBotSubsystem::IsTickable() const
+{
+	// Bots are only registered on the server
+	return !IsTemplate() && Bots.Num() > 0;
+}
+
+TStatId USTrackerBotSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USTrackerBotSubsystem, STATGROUP_Tickables);
+}
+
+void USTrackerBotSubsystem::RegisterBot(ASTrackerBot* Bot)
+{
+	if (Bot == nullptr || Bot->BotSubsystemIndex != INDEX_NONE)
+		return;
+
+	Bot->BotSubsystemIndex = Bots.Add(Bot);
+	BotLocations.Add(Bot->GetActorLocation());
+	NextUpdateTimes.Add(0.0f);
+
+	// Spread path refreshes of bots spawned together
+	NextRefreshTimes.Add(GetWorld()->GetTimeSeconds() + FMath::FRandRange(0.0f, Bot->RefreshPathInterval));
+
+	BotTeams.Add(Bot->HealthComp != nullptr ? Bot->HealthComp->TeamNum : 255);
+
+	INC_DWORD_STAT(STAT_TrackerBotsLive);
+}
+
+void USTrackerBotSubsystem::UnregisterBot(ASTrackerBot* Bot)
+{
+	if (Bot == nullptr || !Bots.IsValidIndex(Bot->BotSubsystemIndex) || Bots[Bot->BotSubsystemIndex] != Bot)
+		return;
+
+	// Swap the last bot into the hole
+	int32 Index = Bot->BotSubsystemIndex;
+	Bots.RemoveAtSwap(Index, 1, false);
+	BotLocations.RemoveAtSwap(Index, 1, false);
+	NextUpdateTimes.RemoveAtSwap(Index, 1, false);
+	NextRefreshTimes.RemoveAtSwap(Index, 1, false);
+	BotTeams.RemoveAtSwap(Index, 1, false);
+	if (BestTargets.IsValidIndex(Index))
+		BestTargets.RemoveAtSwap(Index, 1, false);
+	if (Bots.IsValidIndex(Index))
+		Bots[Index]->BotSubsystemIndex = Index;
+
+	Bot->BotSubsystemIndex = INDEX_NONE;
+	DEC_DWORD_STAT(STAT_TrackerBotsLive);
+}
+
+void USTrackerBotSubsystem::UpdateTargets()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TrackerBotSelectTargets);
+
+	// Locations of this frame, shared with the spatial hash and steering
+	BotLocations.SetNumUninitialized(Bots.Num(), false);
+	for (int32 i = 0; i < Bots.Num(); ++i)
+	{
+		BotLocations[i] = Bots[i]->GetActorLocation();
+	}
+
+	// Team and alive state come straight from the health registry
+	Targets.Reset();
+	USHealthRegistrySubsystem* Registry = GetWorld()->GetSubsystem<USHealthRegistrySubsystem>();
+	for (int32 Handle = 0; Handle < Registry->GetNum(); ++Handle)
+	{
+		if (!Registry->IsAlive(Handle))
+			continue;
+
+		APawn* TestPawn = Cast<APawn>(Registry->GetOwner(Handle));
+		if (TestPawn != nullptr)
+		{
+			FBotTarget& Target = Targets.AddDefaulted_GetRef();
+			Target.Actor = TestPawn;
+			Target.Location = TestPawn->GetActorLocation();
+			Target.TeamNum = Registry->GetTeam(Handle);
+		}
+	}
+
+	int32 NumChunks = BotTargetChunks > 0 ? BotTargetChunks : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	if (Bots.Num() < MinBotsForParallelTargets)
+		NumChunks = 1;
+
+	SelectNearestTargets(BotLocations, BotTeams, Targets, BestTargets, NumChunks);
+}
+
+bool USTrackerBotSubsystem::GetBestTarget(const ASTrackerBot* Bot, AActor*& OutTarget) const
+{
+	if (Bot == nullptr || !BestTargets.IsValidIndex(Bot->BotSubsystemIndex) || Bots[Bot->BotSubsystemIndex] != Bot)
+		return false;
+
+	int32 TargetIndex = BestTargets[Bot->BotSubsystemIndex];
+	OutTarget = TargetIndex != INDEX_NONE ? Targets[TargetIndex].Actor : nullptr;
+	return true;
+}
+
+void USTrackerBotSubsystem::SelectNearestTargets(const TArray<FVector>& Locations, const TArray<uint8>& Teams, const TArray<FBotTarget>& InTargets, TArray<int32>& OutBestTargets, int32 NumChunks)
+{
+	int32 NumBots = Locations.Num();
+	OutBestTargets.SetNumUninitialized(NumBots, false);
+	if (NumBots == 0)
+		return;
+
+	NumChunks = FMath::Clamp(NumChunks, 1, NumBots);
+	int32 ChunkSize = FMath::DivideAndRoundUp(NumBots, NumChunks);
+
+	// Every chunk writes its own range of OutBestTargets, nothing else is shared
+	ParallelFor(NumChunks, [&](int32 Chunk)
+	{
+		int32 End = FMath::Min((Chunk + 1) * ChunkSize, NumBots);
+		for (int32 i = Chunk * ChunkSize; i < End; ++i)
+		{
+			int32 BestTarget = INDEX_NONE;
+			float NearestDistSq = FLT_MAX;
+			for (int32 t = 0; t < InTargets.Num(); ++t)
+			{
+				const FBotTarget& Target = InTargets[t];
+				if (Target.TeamNum == Teams[i])
+					continue;
+
+				float DistSq = FVector::DistSquared(Target.Location, Locations[i]);
+				if (DistSq < NearestDistSq)
+				{
+					BestTarget = t;
+					NearestDistSq = DistSq;
+				}
+			}
+			OutBestTargets[i] = BestTarget;
+		}
+	}, NumChunks == 1);
+}
+
+void USTrackerBotSubsystem::UpdatePowerLevels()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TrackerBotPowerLevels);
+
+	for (int32 i = 0; i < Bots.Num(); ++i)
+	{
+		ASTrackerBot* Bot = Bots[i];
+		Bot->SetNearbyBots(SpatialHash.CountNeighbours(i, Bot->DistanceToCheckNearbyBots));
+	}
+}
+
+void USTrackerBotSubsystem::RunPowerLevelBenchmark(int32 NumBots)
+{
+	// Same density as 100 bots spread over 50x50 meters
+	float AreaSize = 5000.0f * FMath::Sqrt(NumBots / 100.0f);
+	float Radius = 600.0f;
+
+	FRandomStream Stream(1234);
+	TArray<FVector> Locations;
+	for (int32 i = 0; i < NumBots; ++i)
+	{
+		Locations.Add(FVector(Stream.FRandRange(0.0f, AreaSize), Stream.FRandRange(0.0f, AreaSize), Stream.FRandRange(0.0f, 200.0f)));
+	}
+
+	const int32 NumRuns = 10;
+
+	int64 HashTotal = 0;
+	double StartTime = FPlatformTime::Seconds();
+	FSpatialHashGrid Grid;
+	for (int32 Run = 0; Run < NumRuns; ++Run)
+	{
+		Grid.Build(Locations, Radius);
+		for (int32 i = 0; i < NumBots; ++i)
+		{
+			HashTotal += Grid.CountNeighbours(i, Radius);
+		}
+	}
+	double HashMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+	int64 BruteTotal = 0;
+	float RadiusSq = FMath::Square(Radius);
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Run = 0; Run < NumRuns; ++Run)
+	{
+		for (int32 i = 0; i < NumBots; ++i)
+		{
+			for (int32 j = 0; j < NumBots; ++j)
+			{
+				if (i != j && FVector::DistSquared(Locations[i], Locations[j]) <= RadiusSq)
+					++BruteTotal;
+			}
+		}
+	}
+	double BruteMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+	UE_LOG(LogTemp, Log, TEXT("PowerLevel benchmark: %d bots, spatial hash %.3f ms, brute force %.3f ms, %.1f neighbours per bot%s"),
+		NumBots, HashMs, BruteMs, HashTotal / (double)(NumRuns * NumBots), HashTotal == BruteTotal ? TEXT("") : TEXT(" (MISMATCH)"));
+}
+
+void USTrackerBotSubsystem::RunTargetSelectionBenchmark(int32 NumBots, int32 NumTargets)
+{
+	FRandomStream Stream(1234);
+
+	TArray<FVector> Locations;
+	TArray<uint8> Teams;
+	for (int32 i = 0; i < NumBots; ++i)
+	{
+		Locations.Add(FVector(Stream.FRandRange(-10000.0f, 10000.0f), Stream.FRandRange(-10000.0f, 10000.0f), 0.0f));
+		Teams.Add(1);
+	}
+
+	// Every other target is a bot ally
+	TArray<FBotTarget> BenchmarkTargets;
+	for (int32 i = 0; i < NumTargets; ++i)
+	{
+		FBotTarget& Target = BenchmarkTargets.AddDefaulted_GetRef();
+		Target.Location = FVector(Stream.FRandRange(-10000.0f, 10000.0f), Stream.FRandRange(-10000.0f, 10000.0f), 0.0f);
+		Target.TeamNum = i % 2;
+	}
+
+	// The worker count is fixed at startup, so this compares the game thread alone with one chunk per thread of this launch
+	const int32 NumRuns = 20;
+	const int32 NumWorkerThreads = FTaskGraphInterface::Get().GetNumWorkerThreads();
+	const int32 ChunkCounts[] = { 1, NumWorkerThreads + 1 };
+
+	TArray<int32> Results;
+	double ElapsedMs[2];
+	for (int32 i = 0; i < 2; ++i)
+	{
+		// Warm up the workers
+		SelectNearestTargets(Locations, Teams, BenchmarkTargets, Results, ChunkCounts[i]);
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Run = 0; Run < NumRuns; ++Run)
+		{
+			SelectNearestTargets(Locations, Teams, BenchmarkTargets, Results, ChunkCounts[i]);
+		}
+		ElapsedMs[i] = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("BotTarget benchmark: %d worker threads, %d bots, %d targets, game thread %.3f ms, %d chunks %.3f ms (%.2fx)"),
+		NumWorkerThreads, NumBots, NumTargets, ElapsedMs[0], ChunkCounts[1], ElapsedMs[1], ElapsedMs[1] > 0.0 ? ElapsedMs[0] / ElapsedMs[1] : 0.0);
+}
@@ -0,0 +1,246 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/SWaveDirectorSubsystem.h"
+#include "Engine/World.h"
+#include "AI/STrackerBot.h"
+#include "Subsystems/STrackerBotPoolSubsystem.h"
+#include "Subsystems/SSpawnPointSubsystem.h"
+
+DECLARE_STATS_GROUP(TEXT("CoopWaveDirector"), STATGROUP_CoopWaveDirector, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Spawn Bots"), STAT_WaveDirectorSpawn, STATGROUP_CoopWaveDirector);
+DECLARE_CYCLE_STAT(TEXT("Prewarm"), STAT_WaveDirectorPrewarm, STATGROUP_CoopWaveDirector);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bots Spawned"), STAT_WaveDirectorSpawned, STATGROUP_CoopWaveDirector);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Queued Bots"), STAT_WaveDirectorQueued, STATGROUP_CoopWaveDirector);
+
+static int32 WaveSpawnMaxPerFrame = 16;
+FAutoConsoleVariableRef CVARWaveSpawnMaxPerFrame(
+	TEXT("COOP.WaveSpawnMaxPerFrame"),
+	WaveSpawnMaxPerFrame,
+	TEXT("Max bots spawned or prewarmed per frame, the rest waits for the next frames"),
+	ECVF_Default);
+
+static float WaveSpawnBudgetMs = 2.0f;
+FAutoConsoleVariableRef CVARWaveSpawnBudgetMs(
+	TEXT("COOP.WaveSpawnBudgetMs"),
+	WaveSpawnBudgetMs,
+	TEXT("Milliseconds per frame spent spawning or prewarming bots, at least one bot is spawned per frame"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs WaveDeployBenchmarkCmd(
+	TEXT("COOP.WaveDeployBenchmark"),
+	TEXT("Deploys a wave and logs frame times once all bots are out, uses the bot class of the last wave or prewarm. Usage: COOP.WaveDeployBenchmark [NumBots=500] [BotsPerSecond=250]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		USWaveDirectorSubsystem* Director = World != nullptr ? World->GetSubsystem<USWaveDirectorSubsystem>() : nullptr;
+		if (Director == nullptr)
+			return;
+
+		int32 NumBots = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 500;
+		float BotsPerSecond = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 250.0f;
+		Director->RunDeployBenchmark(FMath::Max(NumBots, 1), FMath::Max(BotsPerSecond, 1.0f));
+	}));
+
+bool USWaveDirectorSubsystem::IsTickable() const
+{
+	return !IsTemplate() && (IsDeploying() || PrewarmCount > 0);
+}
+
+TStatId USWaveDirectorSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USWaveDirectorSubsystem, STATGROUP_Tickables);
+}
+
+bool USWaveDirectorSubsystem::StartDeploy(const USWaveDefinition* InWave)
+{
+	if (InWave == nullptr || InWave->BotClass == nullptr || GetWorld()->GetNetMode() == NM_Client)
+		return false;
+
+	USSpawnPointSubsystem* SpawnPoints = GetWorld()->GetSubsystem<USSpawnPointSubsystem>();
+	if (SpawnPoints->GetNumCandidates() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Wave director: no actors tagged BotSpawnPoint to spawn bots at"));
+		return false;
+	}
+
+	StopDeploy();
+
+	Wave = InWave;
+	LastBotClass = InWave->BotClass;
+	WaveStartTime = GetWorld()->TimeSeconds;
+
+	Bursts = InWave->Bursts;
+	Bursts.Sort([](const FSWaveBurst& A, const FSWaveBurst& B) { return A.Time < B.Time; });
+	NextBurst = 0;
+
+	// The first streamed bot spawns right away
+	NumStreamedLeft = FMath::Max(InWave->NumBots, 0);
+	StreamCredit = 1.0f;
+
+	Stream.Initialize(FMath::TruncToInt(WaveStartTime * 1000.0f));
+
+	DeployFrames = 0;
+	DeployStartTime = FPlatformTime::Seconds();
+	LastFrameTime = DeployStartTime;
+	WorstFrameSeconds = 0.0;
+	WorstSpawnSeconds = 0.0;
+	TotalSpawnSeconds = 0.0;
+
+	return true;
+}
+
+void USWaveDirectorSubsystem::StopDeploy()
+{
+	DEC_DWORD_STAT_BY(STAT_WaveDirectorQueued, NumQueued);
+
+	Wave = nullptr;
+	NumQueued = 0;
+	NumStreamedLeft = 0;
+	Bursts.Reset();
+	bBenchmark = false;
+}
+
+void USWaveDirectorSubsystem::Prewarm(TSubclassOf<ASTrackerBot> BotClass, int32 Count)
+{
+	if (BotClass == nullptr)
+		return;
+
+	PrewarmClass = BotClass;
+	PrewarmCount = Count;
+	LastBotClass = BotClass;
+}
+
+void USWaveDirectorSubsystem::RunDeployBenchmark(int32 NumBots, float BotsPerSecond)
+{
+	if (IsDeploying())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Wave deploy benchmark: a wave is still deploying"));
+		return;
+	}
+
+	if (LastBotClass == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Wave deploy benchmark: no bot class yet, run it once a wave was prewarmed or deployed"));
+		return;
+	}
+
+	USWaveDefinition* BenchmarkWave = NewObject<USWaveDefinition>(this);
+	BenchmarkWave->BotClass = LastBotClass;
+	BenchmarkWave->NumBots = NumBots;
+	BenchmarkWave->SpawnRate = BotsPerSecond;
+
+	if (StartDeploy(BenchmarkWave))
+	{
+		bBenchmark = true;
+		NumBenchmarkBots = NumBots;
+	}
+}
+
+void USWaveDirectorSubsystem::Tick(float DeltaTime)
+{
+	USTrackerBotPoolSubsystem* BotPool = GetWorld()->GetSubsystem<USTrackerBotPoolSubsystem>();
+
+	double FrameStartTime = FPlatformTime::Seconds();
+	double EndTime = FrameStartTime + WaveSpawnBudgetMs / 1000.0;
+
+	if (!IsDeploying())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WaveDirectorPrewarm);
+
+		// A handful of bots per frame, never while a wave is deploying
+		int32 NumFree = BotPool->GetNumFree(PrewarmClass);
+		int32 Target = FMath::Min(PrewarmCount, NumFree + FMath::Max(WaveSpawnMaxPerFrame, 1));
+		while (NumFree < Target && FPlatformTime::Seconds() < EndTime)
+		{
+			BotPool->Prewarm(PrewarmClass, ++NumFree);
+		}
+
+		if (NumFree >= PrewarmCount || !USTrackerBotPoolSubsystem::IsPoolingEnabled())
+			PrewarmCount = 0;
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_WaveDirectorSpawn);
+
+	float WaveTime = GetWorld()->TimeSeconds - WaveStartTime;
+	int32 NumDue = 0;
+
+	if (NumStreamedLeft > 0)
+	{
+		StreamCredit += Wave->GetSpawnRate(WaveTime) * DeltaTime;
+		int32 NumStreamed = FMath::Min(FMath::FloorToInt(StreamCredit), NumStreamedLeft);
+		StreamCredit -= NumStreamed;
+		NumStreamedLeft -= NumStreamed;
+		NumDue += NumStreamed;
+	}
+
+	while (NextBurst < Bursts.Num() && Bursts[NextBurst].Time <= WaveTime)
+	{
+		NumDue += FMath::Max(Bursts[NextBurst].NumBots, 0);
+		++NextBurst;
+	}
+
+	NumQueued += NumDue;
+	INC_DWORD_STAT_BY(STAT_WaveDirectorQueued, NumDue);
+
+	// Amortize bursts over the next frames, spawn points for this frame's bots are picked together
+	int32 NumSpawned = 0;
+	if (NumQueued > 0)
+	{
+		USSpawnPointSubsystem* SpawnPoints = GetWorld()->GetSubsystem<USSpawnPointSubsystem>();
+		int32 NumPoints = SpawnPoints->SelectSpawnPoints(FMath::Min(NumQueued, FMath::Max(WaveSpawnMaxPerFrame, 1)), SpawnTransforms);
+
+		// SelectSpawnPoints falls back to a visible or badly placed point rather than none, only a level without spawn points leaves the bots queued
+		while (NumPoints > 0 && NumQueued > 0 && NumSpawned < WaveSpawnMaxPerFrame && (NumSpawned == 0 || FPlatformTime::Seconds() < EndTime))
+		{
+			SpawnBot(SpawnTransforms[NumSpawned % NumPoints]);
+			--NumQueued;
+			++NumSpawned;
+		}
+	}
+
+	DEC_DWORD_STAT_BY(STAT_WaveDirectorQueued, NumSpawned);
+	INC_DWORD_STAT_BY(STAT_WaveDirectorSpawned, NumSpawned);
+
+	// Frame time is measured from the start of this tick to the start of the next one
+	double Now = FPlatformTime::Seconds();
+	if (DeployFrames > 0)
+		WorstFrameSeconds = FMath::Max(WorstFrameSeconds, FrameStartTime - LastFrameTime);
+	LastFrameTime = FrameStartTime;
+	WorstSpawnSeconds = FMath::Max(WorstSpawnSeconds, Now - FrameStartTime);
+	TotalSpawnSeconds += Now - FrameStartTime;
+	++DeployFrames;
+
+	if (NumQueued == 0 && NumStreamedLeft == 0 && NextBurst == Bursts.Num())
+		FinishDeploy();
+}
+
+void USWaveDirectorSubsystem::SpawnBot(const FTransform& SpawnPoint)
+{
+	// Spread out so bots from the same point don't spawn inside each other
+	float Angle = Stream.FRandRange(0.0f, 2.0f * PI);
+	float Radius = Wave->SpawnRadius * FMath::Sqrt(Stream.FRand());
+	FVector Offset(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, 0.0f);
+
+	USTrackerBotPoolSubsystem* BotPool = GetWorld()->GetSubsystem<USTrackerBotPoolSubsystem>();
+	BotPool->SpawnBotAt(Wave->BotClass, FTransform(SpawnPoint.GetRotation(), SpawnPoint.GetLocation() + Offset));
+}
+
+void USWaveDirectorSubsystem::FinishDeploy()
+{
+	bool bWasBenchmark = bBenchmark;
+	double DeploySeconds = FPlatformTime::Seconds() - DeployStartTime;
+
+	StopDeploy();
+
+	if (bWasBenchmark)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Wave deploy benchmark: %d bots in %.2f s over %d frames, worst frame %.2f ms, spawning %.3f ms avg / %.3f ms worst per frame (budget %.1f ms, %d bots)"),
+			NumBenchmarkBots, DeploySeconds, DeployFrames, WorstFrameSeconds * 1000.0,
+			DeployFrames > 0 ? TotalSpawnSeconds * 1000.0 / DeployFrames : 0.0, WorstSpawnSeconds * 1000.0,
+			WaveSpawnBudgetMs, WaveSpawnMaxPerFrame);
+		return;
+	}
+
+	OnDeployFinished.Broadcast();
+}
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "AI/SBotSteering.h"
+#include "../AI/SBotSteeringChecks.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Same checks as Tools/BotSteering, which runs them without the engine
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBotSteeringChecksTest, "CoopGame.BotSteering.Checks", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBotSteeringChecksTest::RunTest(const FString& Parameters)
+{
+	AddInfo(FString::Printf(TEXT("Vectorized: %s"), FBotSteeringBatch::IsVectorized() ? TEXT("yes") : TEXT("no")));
+
+	std::vector<std::string> Failures;
+	FBotSteeringChecks::Run(Failures);
+
+	for (const std::string& Failure : Failures)
+	{
+		AddError(UTF8_TO_TCHAR(Failure.c_str()));
+	}
+
+	return Failures.empty();
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
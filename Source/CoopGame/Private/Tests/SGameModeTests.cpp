@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "TimerManager.h"
+#include "SGameMode.h"
+#include "SGameState.h"
+#include "Components/SHealthComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Game world with a game mode, one player and one bot, nothing ticks
+struct FSGameModeTestWorld
+{
+	UWorld* World;
+	ASGameMode* GameMode;
+	USHealthComponent* PlayerHealth;
+	USHealthComponent* BotHealth;
+
+	FSGameModeTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		World->InitializeActorsForPlay(FURL());
+
+		// Spawns the game state too
+		GameMode = World->SpawnActor<ASGameMode>();
+
+		APawn* PlayerPawn = World->SpawnActor<APawn>();
+		APlayerController* PC = World->SpawnActor<APlayerController>();
+		PC->Possess(PlayerPawn);
+		PlayerHealth = NewObject<USHealthComponent>(PlayerPawn);
+
+		APawn* BotPawn = World->SpawnActor<APawn>();
+		BotHealth = NewObject<USHealthComponent>(BotPawn);
+	}
+
+	~FSGameModeTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	EWaveState GetWaveState() const
+	{
+		return GameMode->GetGameState<ASGameState>()->GetWaveState();
+	}
+
+	// Start the wave now instead of waiting for the timer
+	void StartWave()
+	{
+		GameMode->GetWorldTimerManager().ClearTimer(GameMode->TimerHandle_NextWaveStart);
+		GameMode->StartWave();
+	}
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSGameModeWaveTest, "CoopGame.GameMode.WaveTransitions", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSGameModeWaveTest::RunTest(const FString& Parameters)
+{
+	FSGameModeTestWorld Test;
+	ASGameMode* GameMode = Test.GameMode;
+
+	GameMode->PrepareForNextWave();
+	TestTrue(TEXT("Waiting for the first wave"), Test.GetWaveState() == EWaveState::WaitingToStart);
+
+	GameMode->OnAliveChanged(Test.PlayerHealth, true);
+	GameMode->OnAliveChanged(Test.BotHealth, true);
+	TestEqual(TEXT("Possessed pawn is a player"), GameMode->AlivePlayers.Num(), 1);
+	TestEqual(TEXT("Unpossessed pawn is a bot"), GameMode->AliveBots.Num(), 1);
+
+	// Bots dying before the wave starts don't complete it
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestTrue(TEXT("Still waiting for the first wave"), Test.GetWaveState() == EWaveState::WaitingToStart);
+
+	Test.StartWave();
+	TestTrue(TEXT("Wave started"), Test.GetWaveState() == EWaveState::WaveInProgress);
+	TestEqual(TEXT("First wave"), GameMode->WaveCount, 1);
+
+	// Every bot dead while more are still to spawn
+	GameMode->OnAliveChanged(Test.BotHealth, true);
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestTrue(TEXT("Spawning wave isn't complete"), Test.GetWaveState() == EWaveState::WaveInProgress);
+
+	GameMode->OnAliveChanged(Test.BotHealth, true);
+	GameMode->OnWaveDeployed();
+	TestTrue(TEXT("Deployed wave waits for the last bot"), Test.GetWaveState() == EWaveState::WaitingToComplete);
+
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestEqual(TEXT("No bots alive"), GameMode->AliveBots.Num(), 0);
+	TestTrue(TEXT("Last bot completes the wave and prepares the next"), Test.GetWaveState() == EWaveState::WaitingToStart);
+	TestTrue(TEXT("Next wave timer set"), GameMode->GetWorldTimerManager().IsTimerActive(GameMode->TimerHandle_NextWaveStart));
+
+	// Dying twice only counts once
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestTrue(TEXT("Still waiting for the next wave"), Test.GetWaveState() == EWaveState::WaitingToStart);
+
+	// Deploy finishing with every bot already dead completes right away
+	Test.StartWave();
+	TestEqual(TEXT("Second wave"), GameMode->WaveCount, 2);
+	GameMode->OnWaveDeployed();
+	TestTrue(TEXT("Empty deployed wave completes"), Test.GetWaveState() == EWaveState::WaitingToStart);
+
+	TestEqual(TEXT("Player never died"), GameMode->AlivePlayers.Num(), 1);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSGameModeGameOverTest, "CoopGame.GameMode.GameOver", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSGameModeGameOverTest::RunTest(const FString& Parameters)
+{
+	FSGameModeTestWorld Test;
+	ASGameMode* GameMode = Test.GameMode;
+
+	GameMode->PrepareForNextWave();
+	GameMode->OnAliveChanged(Test.PlayerHealth, true);
+	GameMode->OnAliveChanged(Test.BotHealth, true);
+	Test.StartWave();
+
+	// Bots dying doesn't end the game
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestTrue(TEXT("Wave still running"), Test.GetWaveState() == EWaveState::WaveInProgress);
+
+	GameMode->OnAliveChanged(Test.PlayerHealth, false);
+	TestEqual(TEXT("No players alive"), GameMode->AlivePlayers.Num(), 0);
+	TestTrue(TEXT("Last player ends the game"), Test.GetWaveState() == EWaveState::GameOver);
+
+	// Nothing leaves game over
+	GameMode->OnAliveChanged(Test.BotHealth, true);
+	GameMode->OnAliveChanged(Test.BotHealth, false);
+	TestTrue(TEXT("Wave can't complete after game over"), Test.GetWaveState() == EWaveState::GameOver);
+
+	GameMode->OnAliveChanged(Test.PlayerHealth, true);
+	GameMode->OnAliveChanged(Test.PlayerHealth, false);
+	TestTrue(TEXT("Still game over"), Test.GetWaveState() == EWaveState::GameOver);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Subsystems/SSpawnPointSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpawnPointScoringTest, "CoopGame.SpawnPoints.Scoring", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSpawnPointScoringTest::RunTest(const FString& Parameters)
+{
+	FSpawnPointScoreParams Params;
+
+	TArray<FVector> Candidates;
+	Candidates.Add(FVector(500.0f, 0.0f, 0.0f));	// Too close
+	Candidates.Add(FVector(2000.0f, 0.0f, 0.0f));
+	Candidates.Add(FVector(3000.0f, 0.0f, 0.0f));	// Preferred distance
+	Candidates.Add(FVector(0.0f, 6000.0f, 0.0f));	// Twice the preferred distance
+	Candidates.Add(FVector(0.0f, -9000.0f, 0.0f));	// Too far
+
+	TArray<FVector> Players;
+	Players.Add(FVector::ZeroVector);
+
+	// Two bots crowd the candidate at the preferred distance
+	TArray<FVector> Bots;
+	Bots.Add(FVector(3100.0f, 0.0f, 0.0f));
+	Bots.Add(FVector(2900.0f, 100.0f, 0.0f));
+	FSpatialHashGrid Crowd;
+	Crowd.Build(Bots, Params.CrowdRadius);
+
+	TArray<float> Scores;
+	USSpawnPointSubsystem::ScoreCandidates(Candidates, Players, Crowd, Params, Scores, 1);
+
+	TestEqual(TEXT("Score count"), Scores.Num(), Candidates.Num());
+	TestEqual(TEXT("Closer than MinPlayerDistance is rejected"), Scores[0], -FLT_MAX);
+	TestEqual(TEXT("Score falls off before the preferred distance"), Scores[1], 1.0f - 1000.0f / 3000.0f, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Preferred distance scores 1 minus the crowd penalty"), Scores[2], 1.0f - 2.0f * Params.CrowdPenalty, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Twice the preferred distance scores 0"), Scores[3], 0.0f, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Further than MaxPlayerDistance is rejected"), Scores[4], -FLT_MAX);
+
+	// Chunks only split the work
+	TArray<float> ChunkedScores;
+	USSpawnPointSubsystem::ScoreCandidates(Candidates, Players, Crowd, Params, ChunkedScores, 3);
+	TestTrue(TEXT("Chunked scores match"), ChunkedScores == Scores);
+
+	// Without players only crowding counts
+	TArray<float> NoPlayerScores;
+	USSpawnPointSubsystem::ScoreCandidates(Candidates, TArray<FVector>(), Crowd, Params, NoPlayerScores, 1);
+	TestEqual(TEXT("No players, uncrowded"), NoPlayerScores[0], 0.0f);
+	TestEqual(TEXT("No players, crowded"), NoPlayerScores[2], -2.0f * Params.CrowdPenalty, KINDA_SMALL_NUMBER);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpawnPointSortingTest, "CoopGame.SpawnPoints.Sorting", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSpawnPointSortingTest::RunTest(const FString& Parameters)
+{
+	TArray<float> Scores = { 0.5f, -FLT_MAX, 0.9f, 0.1f, -FLT_MAX };
+
+	TArray<int32> Order;
+	USSpawnPointSubsystem::SortCandidates(Scores, Order);
+
+	TArray<int32> Expected = { 2, 0, 3 };
+	TestTrue(TEXT("Rejected candidates are dropped and the rest sorted best first"), Order == Expected);
+
+	USSpawnPointSubsystem::SortCandidates(TArray<float>(), Order);
+	TestEqual(TEXT("No candidates"), Order.Num(), 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpawnPointSpacingTest, "CoopGame.SpawnPoints.Spacing", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSpawnPointSpacingTest::RunTest(const FString& Parameters)
+{
+	TArray<FVector> Candidates;
+	Candidates.Add(FVector(0.0f, 0.0f, 0.0f));
+	Candidates.Add(FVector(100.0f, 0.0f, 0.0f));	// Too close to 0
+	Candidates.Add(FVector(1000.0f, 0.0f, 0.0f));
+	Candidates.Add(FVector(2000.0f, 0.0f, 0.0f));	// Rejected by the callback
+	Candidates.Add(FVector(3000.0f, 0.0f, 0.0f));
+	Candidates.Add(FVector(4000.0f, 0.0f, 0.0f));
+
+	TArray<int32> Order = { 0, 1, 2, 3, 4, 5 };
+	auto RejectSecondThousand = [](const FVector& Candidate) { return Candidate.X == 2000.0f; };
+
+	TArray<int32> Picked;
+	USSpawnPointSubsystem::PickSpacedCandidates(Order, Candidates, 3, 400.0f, RejectSecondThousand, Picked);
+
+	TArray<int32> Expected = { 0, 2, 4 };
+	TestTrue(TEXT("Picks in order, skipping close and rejected candidates"), Picked == Expected);
+
+	USSpawnPointSubsystem::PickSpacedCandidates(Order, Candidates, 10, 400.0f, RejectSecondThousand, Picked);
+	TestEqual(TEXT("Fewer points than requested when candidates run out"), Picked.Num(), 4);
+
+	// A small arena where the player sees every spawn point
+	TArray<int32> VisibleOrder = { 3, 1, 2 };
+	auto RejectAll = [](const FVector& Candidate) { return true; };
+	USSpawnPointSubsystem::PickSpacedCandidates(VisibleOrder, Candidates, 3, 400.0f, RejectAll, Picked);
+
+	Expected = { 3 };
+	TestTrue(TEXT("Every candidate rejected falls back to the best one"), Picked == Expected);
+
+	TArray<int32> NoOrder;
+	USSpawnPointSubsystem::PickSpacedCandidates(NoOrder, Candidates, 3, 400.0f, RejectAll, Picked);
+	TestEqual(TEXT("Nothing to fall back to without candidates"), Picked.Num(), 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpawnPointFallbackTest, "CoopGame.SpawnPoints.Fallback", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSpawnPointFallbackTest::RunTest(const FString& Parameters)
+{
+	FSpawnPointScoreParams Params;
+
+	TArray<FVector> Players;
+	Players.Add(FVector::ZeroVector);
+
+	// The player stands next to all spawn points, the farthest one wins
+	TArray<FVector> Near = { FVector(200.0f, 0.0f, 0.0f), FVector(1200.0f, 0.0f, 0.0f), FVector(0.0f, 800.0f, 0.0f) };
+	TestEqual(TEXT("Farthest candidate while the player is too close to all"), USSpawnPointSubsystem::FindFallbackCandidate(Near, Players, Params), 1);
+
+	// All spawn points are too far, the nearest one wins
+	TArray<FVector> Far = { FVector(20000.0f, 0.0f, 0.0f), FVector(9000.0f, 0.0f, 0.0f), FVector(0.0f, 12000.0f, 0.0f) };
+	TestEqual(TEXT("Nearest candidate while all are too far"), USSpawnPointSubsystem::FindFallbackCandidate(Far, Players, Params), 1);
+
+	TestEqual(TEXT("No candidates"), USSpawnPointSubsystem::FindFallbackCandidate(TArray<FVector>(), Players, Params), (int32)INDEX_NONE);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
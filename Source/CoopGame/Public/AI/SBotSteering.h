@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// Plain C++ on purpose, no engine headers so the steering core builds and benchmarks outside the editor
+#include <cstdint>
+#include <vector>
+
+enum EBotSteeringFlags : uint8_t
+{
+	BOTSTEERING_Arrived = 1 << 0,
+	BOTSTEERING_WantsToJump = 1 << 1,
+};
+
+/**
+ * Structure of arrays steering state for a batch of tracker bots. Inputs are positions, path targets and force
+ * parameters, Compute fills in the force and flags of every bot at once, four bots per SSE2 instruction where
+ * available. Arrays are padded to a multiple of four, Compute leaves padding bots arrived with no force.
+ */
+class FBotSteeringBatch
+{
+public:
+	void Reset(int32_t NumBots);
+
+	int32_t Num() const { return NumBots; }
+
+	void SetBot(int32_t Index, const float Position[3], const float Target[3], float InMovementForce, float ArriveDistance);
+
+	// Steering for every bot, vectorized if the target supports it
+	void Compute();
+
+	// Reference implementation, same results as Compute
+	void ComputeScalar();
+
+	static bool IsVectorized();
+
+	// Steering of a single bot, used for bots outside of any batch
+	static uint8_t ComputeSingle(const float Position[3], const float Target[3], float InMovementForce, float ArriveDistance, float OutForce[3]);
+
+	// Fills NumBots random bots and runs the scalar and vectorized kernels Iterations times, returns bots per microsecond
+	static void RunBenchmark(int32_t InNumBots, int32_t Iterations, double& OutScalarBotsPerUs, double& OutVectorBotsPerUs);
+
+	// Inputs
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> TargetX, TargetY, TargetZ;
+	std::vector<float> MovementForce;
+	std::vector<float> ArriveDistanceSq;
+
+	// Outputs
+	std::vector<float> ForceX, ForceY, ForceZ;
+	std::vector<uint8_t> Flags;
+
+private:
+	int32_t NumBots = 0;
+};
@@ -11,12 +11,33 @@ class UMaterialInstanceDynamic;
 class USphereComponent;
 class USoundCue;
 class URadialForceComponent;
+class USReplicationPolicyComponent;
+
+// Pool state of a tracker bot. Activations changes on every reuse, so clients also reset a bot
+// that was parked and reused again between two of its net updates
+USTRUCT()
+struct FSBotPoolState
+{
+	GENERATED_BODY()
+
+public:
+	// Parked in the bot pool, hidden without collision or physics
+	UPROPERTY()
+	bool bInPool = false;
+
+	// Times the bot was taken from the pool, wraps around
+	UPROPERTY()
+	uint8 Activations = 0;
+};
 
 UCLASS()
 class COOPGAME_API ASTrackerBot : public APawn
 {
 	GENERATED_BODY()
 
+	friend class USTrackerBotSubsystem;
+	friend class USTrackerBotPoolSubsystem;
+
 public:
 	// Sets default values for this pawn's properties
 	ASTrackerBot();
@@ -25,15 +46,53 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-	FVector GetNextPathPoint();
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Registers with the bot subsystems and starts chasing targets
+	void StartTracking();
+
+	// Undoes StartTracking and stops all timers
+	void StopTracking();
 
+	// Hides a pooled bot or restores a reactivated one, on server and clients
+	void ApplyPoolState();
+
+	// Hands an exploded bot back to the bot pool
+	void ReturnToPool();
+
+	UFUNCTION()
+	void OnRep_PoolState();
+
+	// Nearest living enemy pawn
+	AActor* FindBestTarget();
+
+	// Asks for a new path to the nearest target, the bot keeps following its old path until it arrives
+	void RequestPath();
+
+	// RequestActivations is PoolState.Activations when the path was requested, results for an earlier life are dropped
+	void OnPathFound(bool bSuccess, const TArray<FVector>& NewPathPoints, uint8 RequestActivations);
+
+	// Repaths if the target changed or moved away from the end of the path
 	void RefreshPath();
 
+	// Moves to the next path point, requests a new path past the end of the current one
+	void AdvancePath();
+
+	// Steers along the flow field of PathTarget, returns false if the bot has to fall back to its path
+	bool FollowFlowField();
+
+	// Picks the next path point once the bot arrived at the current one
+	void UpdateSteering();
+
+	// Pushes the bot towards NextPathPoint, forces only last a frame so this is needed every frame
+	void ApplySteering(const FVector& Force, bool bJump);
+
 	void SelfDestruct();
 
 	void DamageSelf();
 
-	void OnCheckNearbyBots();
+	// Power level from the number of bots within DistanceToCheckNearbyBots
+	void SetNearbyBots(int32 NumOfBots);
 
 	UFUNCTION()
 	void HandleTakeDamage(USHealthComponent* OwningHealthComp, float Health, float HealthDelta, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser);
@@ -53,9 +112,34 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	URadialForceComponent* RadialForceComp = nullptr;
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USReplicationPolicyComponent* ReplicationPolicyComp = nullptr;
+
 	// Next point in navigation path
 	FVector NextPathPoint;
 
+	// Current navigation path and the index of NextPathPoint in it
+	TArray<FVector> PathPoints;
+
+	int32 PathPointIndex;
+
+	// Target the path leads to and where it was when the path was requested
+	TWeakObjectPtr<AActor> PathTarget;
+
+	FVector PathTargetLocation;
+
+	bool bPathRequestPending;
+
+	// Earliest time to ask again after a failed path query
+	float NextPathRetryTime;
+
+	// Repath once the target moved this far from where the path was requested
+	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
+	float RepathDistance;
+
+	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
+	float RefreshPathInterval;
+
 	UPROPERTY(EditDefaultsOnly, Category = "TrackerBot")
 	float MovementForce;
 
@@ -106,7 +190,19 @@ protected:
 
 	FTimerHandle TimerHandle_RefreshPath;
 
+	// Index in the tracker bot subsystem, INDEX_NONE if not registered
+	int32 BotSubsystemIndex;
+
+	UPROPERTY(ReplicatedUsing=OnRep_PoolState)
+	FSBotPoolState PoolState;
+
+	FTimerHandle TimerHandle_ReturnToPool;
+
 public:	
+	// Pool hooks, reset the bot to a freshly spawned state at Transform or park it
+	void ActivateFromPool(const FTransform& Transform);
+	void DeactivateToPool();
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
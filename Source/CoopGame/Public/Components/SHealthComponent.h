@@ -14,6 +14,8 @@ class COOPGAME_API USHealthComponent : public UActorComponent
 {
 	GENERATED_BODY()
 
+	friend class USHealthRegistrySubsystem;
+
 public:	
 	// Sets default values for this component's properties
 	USHealthComponent();
@@ -22,6 +24,11 @@ protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Tells the health registry our alive state might have changed
+	void UpdateRegistry();
+
 	UFUNCTION()
 	void HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser);
 
@@ -36,12 +43,23 @@ protected:
 
 	bool bIsDead;
 
+	// Index in the health registry, INDEX_NONE while unregistered
+	int32 RegistryHandle;
+
 public:
 	float GetHealth() const;
 
+	int32 GetRegistryHandle() const { return RegistryHandle; }
+
 	UFUNCTION(BlueprintCallable, Category = "HealthComponent")
 	void Heal(float HealAmount);
 
+	// Back to DefaultHealth and alive, for reused actors
+	void ResetHealth();
+
+	// Adds or removes us from the health registry, done in BeginPlay and EndPlay
+	void SetRegistered(bool bRegistered);
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "HealthComponent")
 	static bool IsFriendly(AActor* ActorA, AActor* ActorB);
 
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SReplicationPolicyComponent.generated.h"
+
+class USReplicationGraph;
+
+/**
+ * Server side replication settings of the owner that follow the closest player. Net update frequency goes from
+ * NearNetUpdateFrequency at NearDistance down to FarNetUpdateFrequency at FarDistance and the owner's net
+ * priority is scaled up close to players. Owners that allow it go dormant once they have been idle for
+ * IdleDelay seconds. All policies are updated together by USReplicationPolicySubsystem. While the replication graph
+ * drives replication the rates are also written to the graph's per actor settings.
+ */
+UCLASS( ClassGroup=(COOP), meta=(BlueprintSpawnableComponent) )
+class COOPGAME_API USReplicationPolicyComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+	friend class USReplicationPolicySubsystem;
+
+public:
+	// Sets default values for this component's properties
+	USReplicationPolicyComponent();
+
+	// Tells the policy whether the owner has state to replicate. Waking flushes dormancy right away,
+	// so call it before changing replicated properties
+	void SetIdle(bool bInIdle);
+
+	bool IsDormant() const { return bDormant; }
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Applies the policy for the distance to the closest player, Now is world time. Graph is null without the replication graph
+	void UpdatePolicy(float PlayerDistance, float Now, USReplicationGraph* Graph);
+
+	// Back to the owner's own settings and awake
+	void RestoreDefaults(USReplicationGraph* Graph);
+
+	// Idle and, for simulated roots, with the body asleep
+	bool IsIdle() const;
+
+	void SetDormant(bool bInDormant);
+
+public:
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	float NearDistance;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	float FarDistance;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	float NearNetUpdateFrequency;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	float FarNetUpdateFrequency;
+
+	// Net priority multiplier at NearDistance, 1 at FarDistance
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy", meta = (ClampMin = 1.0f))
+	float NearPriorityScale;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	bool bDormantWhenIdle;
+
+	// Seconds idle before going dormant, leaves time to send the last changes
+	UPROPERTY(EditDefaultsOnly, Category = "Replication Policy")
+	float IdleDelay;
+
+protected:
+	bool bIdle;
+
+	bool bDormant;
+
+	// World time the owner became idle, negative while active
+	float IdleSince;
+
+	// Owner settings before the policy changed them
+	float DefaultNetUpdateFrequency;
+	float DefaultMinNetUpdateFrequency;
+	float DefaultNetPriority;
+
+	// Index in the policy subsystem, INDEX_NONE while unregistered
+	int32 PolicyIndex;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/NetSerialization.h"
 #include "SCharacter.generated.h"
 
 class UCameraComponent;
@@ -12,17 +13,78 @@ class ASWeapon;
 class USHealthComponent;
 class ASpectatorPawn;
 
+// Weapon in one inventory slot
 USTRUCT()
-struct FWeaponStruct
+struct FSInventorySlot : public FFastArraySerializerItem
 {
 	GENERATED_BODY()
 
+public:
+	UPROPERTY()
+	ASWeapon* Weapon = nullptr;
+
+	// Clients can receive slots in a different order than the server added them
 	UPROPERTY()
-	uint8 Index;		// Index of the weapon on player weapons list
+	uint8 Slot = 0;
+};
+
+// Weapons of a character. Slots are delta replicated, adding a weapon only sends the new slot
+USTRUCT()
+struct FSWeaponInventory : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+public:
+	// Server only, the weapon gets the next slot
+	void Add(ASWeapon* Weapon);
+
+	ASWeapon* GetWeapon(int32 Slot) const;
+
+	int32 Num() const { return Slots.Num(); }
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FSInventorySlot, FSWeaponInventory>(Slots, DeltaParms, *this);
+	}
 
 	UPROPERTY()
-	ASWeapon* Weapon = nullptr;	// Pointer to the weapon
+	TArray<FSInventorySlot> Slots;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSWeaponInventory> : public TStructOpsTypeTraitsBase2<FSWeaponInventory>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+// Ammo of the weapons in the inventory, replicated to the owner so holstered weapons can stay dormant
+USTRUCT()
+struct FSInventoryAmmo
+{
+	GENERATED_BODY()
+
+public:
+	enum { MaxWeapons = 16 };
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FSInventoryAmmo& Other) const { return Ammo == Other.Ammo; }
 
+	// Indexed by inventory slot. The drawn weapon keeps the value it had when it was drawn
+	TArray<uint8> Ammo;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSInventoryAmmo> : public TStructOpsTypeTraitsBase2<FSInventoryAmmo>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
 };
 
 UCLASS()
@@ -38,6 +100,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "Player")
 	void OnCharacterStart();
 
@@ -67,6 +131,15 @@ protected:
 
 	void EndEquipWeapon();
 
+	// Holsters the current weapon and draws the one in Slot. The owning client tells the server
+	void SetCurrentWeapon(uint8 Slot);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetCurrentWeapon(uint8 Slot);
+
+	// Spawns a weapon attached to the character into the next inventory slot, holstered unless it's the equipped slot
+	ASWeapon* AddWeapon(TSubclassOf<ASWeapon> WeaponClass);
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "Event")
 	void OnWeaponChange();
 
@@ -90,6 +163,10 @@ protected:
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 	bool GetIsReloading();
 
+	// Ammo of any weapon in the inventory, from InventoryAmmo for holstered weapons
+	UFUNCTION(BlueprintCallable, Category = "Weapon")
+	int32 GetWeaponAmmo(int32 Slot) const;
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	UCameraComponent* CameraComp = nullptr;
 
@@ -110,17 +187,21 @@ protected:
 	// Default FOV set during begin play
 	float DefaultFOV;
 
-	UPROPERTY(Replicated)
-	FWeaponStruct CurrentWeapon;
-
 	UPROPERTY(EditDefaultsOnly, Category = "Player")
 	TSubclassOf<ASpectatorPawn> SpectatorPawnClass;
 
 	UPROPERTY(EditDefaultsOnly, Category = "Player")
 	TArray<TSubclassOf<ASWeapon>> StarterWeaponClasses;
 
-	UPROPERTY(Replicated, VisibleDefaultsOnly, Category = "Player")
-	TArray<ASWeapon*> PlayerWeapons;
+	UPROPERTY(Replicated)
+	FSWeaponInventory Inventory;
+
+	// Inventory slot of the drawn weapon
+	UPROPERTY(Replicated)
+	uint8 EquippedSlot;
+
+	UPROPERTY(Replicated)
+	FSInventoryAmmo InventoryAmmo;
 
 	UPROPERTY(VisibleDefaultsOnly, Category = "Player")
 	FName WeaponAttachSocketName;
@@ -161,6 +242,13 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 	void SetExplosiveBullets(bool bExplosive);
 
+	const FSWeaponInventory& GetInventory() const { return Inventory; }
+
+	// Adds weapons from StarterWeaponClasses, repeating them, until the character has NumWeapons
+	void FillWeapons(int32 NumWeapons);
+
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
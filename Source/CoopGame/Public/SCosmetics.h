@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Server only builds never play cosmetics, wrap cosmetic only code in #if WITH_COOP_COSMETICS
+#define WITH_COOP_COSMETICS (!UE_SERVER)
+
+/**
+ * Gate for purely cosmetic work (particles, sounds, camera shakes, material pulses).
+ * Dedicated servers have nobody to show them to.
+ */
+struct COOPGAME_API FSCosmetics
+{
+	// True if WorldContextObject lives in a world that renders or plays audio
+	static bool ShouldPlay(const UObject* WorldContextObject);
+};
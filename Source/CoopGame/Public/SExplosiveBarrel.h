@@ -9,6 +9,7 @@
 class USHealthComponent;
 class UMaterial;
 class URadialForceComponent;
+class USReplicationPolicyComponent;
 class USoundCue;
 
 UCLASS()
@@ -39,6 +40,9 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	URadialForceComponent* RadialForceComp = nullptr;
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USReplicationPolicyComponent* ReplicationPolicyComp = nullptr;
+
 	UPROPERTY(EditAnywhere, Category = "FX")
 	UMaterial* ExplodedMaterial = nullptr;
 
@@ -7,6 +7,9 @@
 #include "SGameMode.generated.h"
 
 enum class EWaveState : uint8;
+class USHealthComponent;
+class ASTrackerBot;
+class USWaveDefinition;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnActorKilled, AActor*, VictimActor, AActor*, KillerActor, AController*, KillerController);
 
@@ -17,13 +20,16 @@ UCLASS()
 class COOPGAME_API ASGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
+
+	friend class FSGameModeWaveTest;
+	friend class FSGameModeGameOverTest;
 	
 public:
 	ASGameMode();
 
 	virtual void StartPlay() override;
 
-	virtual void Tick(float DeltaSeconds) override;
+	virtual void FinishRestartPlayer(AController* NewPlayer, const FRotator& StartRotation) override;
 
 protected:
 
@@ -36,13 +42,29 @@ protected:
 	// Set timer for next wave
 	void PrepareForNextWave();
 
+	// Definition of wave number Wave, null if waves aren't data driven
+	const USWaveDefinition* GetWaveDefinition(int32 Wave) const;
+
+	int32 GetNrOfBotsInWave(int32 Wave) const;
+
+	// Wave director spawned every bot of the wave
+	void OnWaveDeployed();
 
-	// Hook for BP to spawn a simple bot
+
+	// Hook for BP to spawn a simple bot, spawn it with USTrackerBotPoolSubsystem::SpawnBotAt to use the prewarmed bots
 	UFUNCTION(BlueprintImplementableEvent, Category = "GameMode")
 	void SpawnNewBot();
 
 	void SpawnBotTimerElapsed();
 
+	// Health registry event, keeps the alive player and bot sets up to date
+	void OnAliveChanged(USHealthComponent* HealthComp, bool bAlive);
+
+	// Moves Actor into the alive player or bot set, or out of both
+	void UpdateAliveActor(AActor* Actor, bool bAlive);
+
+	bool IsGameOver();
+
 	void CheckWaveState();
 
 	void CheckAnyPlayerAlive();
@@ -68,6 +90,18 @@ protected:
 
 	int32 WaveCount;
 
+	// Living pawns by who controls them, updated on spawn, death and possession so checks never scan
+	TSet<AActor*> AlivePlayers;
+	TSet<AActor*> AliveBots;
+
 	UPROPERTY(EditDefaultsOnly, Category = "GameMode")
 	float TimeBetweenWaves;
+
+	// Bots of this class are prewarmed in the bot pool while waiting for a wave without a definition
+	UPROPERTY(EditDefaultsOnly, Category = "GameMode")
+	TSubclassOf<ASTrackerBot> PooledBotClass;
+
+	// One definition per wave, the last one repeats. Empty keeps the blueprint spawning 2 bots per wave number
+	UPROPERTY(EditDefaultsOnly, Category = "GameMode")
+	TArray<USWaveDefinition*> WaveDefinitions;
 };
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SGrenadeDefinition.generated.h"
+
+class UStaticMesh;
+class UParticleSystem;
+class USoundCue;
+
+/**
+ * Ballistics, fuse and explosion of a grenade simulated by USProjectileSubsystem. Cluster grenades release
+ * NumSubmunitions grenades of SubmunitionDefinition when they explode.
+ */
+UCLASS(BlueprintType)
+class COOPGAME_API USGrenadeDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	USGrenadeDefinition();
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	float LaunchSpeed;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	float GravityScale;
+
+	// Radius of the sphere swept through the world
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	float CollisionRadius;
+
+	// Seconds from launch to explosion
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	float FuseTime;
+
+	// Explodes on the first thing it hits instead of waiting for the fuse
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	bool bExplodeOnImpact;
+
+	// Sticks to the first thing it hits and follows it until the fuse runs out
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	bool bSticky;
+
+	// Bounces after which the grenade stops where it lands
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight")
+	int32 MaxBounces;
+
+	// Share of the speed into the surface kept when bouncing
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float Restitution;
+
+	// Share of the speed along the surface lost when bouncing
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flight", meta = (ClampMin = 0.0f, ClampMax = 1.0f))
+	float Friction;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Explosion")
+	float ExplosionDamage;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Explosion")
+	float ExplosionRadius;
+
+	// Radial impulse over ExplosionRadius, 0 for none
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Explosion")
+	float ImpulseStrength;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Cluster")
+	USGrenadeDefinition* SubmunitionDefinition;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Cluster")
+	int32 NumSubmunitions;
+
+	// Launch speed of the submunitions, scattered upwards from the explosion
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Cluster")
+	float SubmunitionSpeed;
+
+	// Drawn as an instance, grenades are never actors
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FX")
+	UStaticMesh* Mesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FX")
+	float MeshScale;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FX")
+	UParticleSystem* ExplosionEffect;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FX")
+	USoundCue* ExplosionSound;
+};
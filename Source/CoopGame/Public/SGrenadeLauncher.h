@@ -6,6 +6,60 @@
 #include "SWeapon.h"
 #include "SGrenadeLauncher.generated.h"
 
+class USGrenadeDefinition;
+
+// Everything needed to replay a grenade launch on another machine, the grenade itself never replicates
+USTRUCT()
+struct FSGrenadeLaunch
+{
+	GENERATED_BODY()
+
+public:
+	void SetOrigin(const FVector& Location);
+	FVector GetOrigin() const { return FVector(OriginX, OriginY, OriginZ); }
+
+	void SetVelocity(const FVector& Velocity);
+	FVector GetVelocity() const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	// Matches the grenade the firing client predicted with the server's, wraps around and skips 0
+	uint16 ShotId = 0;
+
+	uint8 FireType = 0;
+
+	// Launch location in cm
+	int32 OriginX = 0;
+	int32 OriginY = 0;
+	int32 OriginZ = 0;
+
+	// Launch direction as compressed rotator axes and speed in cm/s
+	uint16 Pitch = 0;
+	uint16 Yaw = 0;
+	uint16 Speed = 0;
+
+	// Server world time of the launch, lets late receivers catch up on the flight
+	float ServerTime = 0.0f;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSGrenadeLaunch> : public TStructOpsTypeTraitsBase2<FSGrenadeLaunch>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+// A grenade launched on the firing client, waiting for the server's launch
+struct FSPredictedGrenade
+{
+	FSGrenadeLaunch Launch;
+
+	// Platform time the client fired it
+	double FireTime = 0.0;
+};
+
 /**
  * 
  */
@@ -23,12 +77,50 @@ public:
 	void ToggleFireType() override;
 
 	FText GetCurrentFireTypeName() override;
+
+	// Simulated grenade of InFireType, nullptr if it fires a projectile actor
+	const USGrenadeDefinition* GetGrenadeDefinition(int32 InFireType) const;
+
+	// Server only, fires the current fire type with a full magazine for COOP.GrenadeNetBenchmark
+	void FireBenchmarkGrenade();
 	
 protected:
 
 	virtual void Fire() override;
 
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFireProjectile();
+
+	// Keeps the server's fire type in step with the owning client, ServerFireGrenade launches the server's one
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetFireType(uint8 NewFireType);
+
+	// Launches the grenade a client already predicted, corrected where the server disagrees
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFireGrenade(FSGrenadeLaunch Launch);
+
+	// Shows a grenade launched on the server to the other clients and confirms it to the one that fired it
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastGrenadeLaunched(FSGrenadeLaunch Launch);
+
+	// Launches the simulated grenade of Launch on this machine
+	void LaunchGrenade(const FSGrenadeLaunch& Launch, float FastForwardSeconds);
+
+	// Checks the server's launch against the predicted one and replaces the prediction if they differ
+	void ReconcileGrenade(const FSGrenadeLaunch& Launch);
+
+	float GetServerWorldTime() const;
+
 	/* Projectile class to spawn */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Projectile Weapon")
 	TArray<TSubclassOf<AActor>> ProjectileClasses;
+
+	/* Simulated grenade per fire type, fire types without one spawn their projectile class */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Projectile Weapon")
+	TArray<USGrenadeDefinition*> GrenadeDefinitions;
+
+	uint16 NextShotId;
+
+	// Grenades this client predicted that the server didn't confirm yet
+	TMap<uint16, FSPredictedGrenade> PredictedGrenades;
 };
@@ -8,6 +8,7 @@
 
 class USphereComponent;
 class ASPowerupActor;
+class USReplicationPolicyComponent;
 
 UCLASS()
 class COOPGAME_API ASPickupActor : public AActor
@@ -30,6 +31,9 @@ protected:
 	UPROPERTY(VisibleAnywhere, Category = "Components")
 	UDecalComponent* DecalComp = nullptr;
 
+	UPROPERTY(VisibleAnywhere, Category = "Components")
+	USReplicationPolicyComponent* ReplicationPolicyComp = nullptr;
+
 	UPROPERTY(EditInstanceOnly, Category = "PickupActor")
 	TSubclassOf<ASPowerupActor> PowerUpClass;
 
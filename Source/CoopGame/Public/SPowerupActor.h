@@ -6,6 +6,8 @@
 #include "GameFramework/Actor.h"
 #include "SPowerupActor.generated.h"
 
+class USReplicationPolicyComponent;
+
 UCLASS()
 class COOPGAME_API ASPowerupActor : public AActor
 {
@@ -42,6 +44,9 @@ protected:
 	UPROPERTY(ReplicatedUsing=OnRep_PowerupActive)
 	bool bIsPowerupActive;
 
+	UPROPERTY(VisibleAnywhere, Category = "Components")
+	USReplicationPolicyComponent* ReplicationPolicyComp = nullptr;
+
 public:
 
 	void ActivatePowerup(AActor* OtherActor);
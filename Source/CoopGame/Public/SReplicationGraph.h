@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "SReplicationGraph.generated.h"
+
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+
+// Which node replicates the actors of a class
+UENUM()
+enum class ESClassRepNodeMapping : uint8
+{
+	// Not routed to a global node, like player controllers that the connection node replicates
+	NotRouted,
+
+	// Replicated to every connection
+	RelevantAllConnections,
+
+	// Grid node, never moves
+	Spatialize_Static,
+
+	// Grid node, moves every frame
+	Spatialize_Dynamic,
+
+	// Grid node, moves while awake and goes dormant when it settles
+	Spatialize_Dormancy,
+};
+
+/**
+ * Replicates the connection's own player controller, view target, pawn and all weapons in the pawn's
+ * inventory. Holstered weapons are skipped by the graph while they are dormant.
+ */
+UCLASS()
+class COOPGAME_API USReplicationGraphNode_Player : public UReplicationGraphNode_AlwaysRelevant_ForConnection
+{
+	GENERATED_BODY()
+
+public:
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+};
+
+/**
+ * Replication graph of the wave mode, set as the replication driver in DefaultEngine.ini. Instead of checking
+ * every actor against every connection, actors are routed once to nodes by class:
+ * - bots, characters and weapons go to a 2D grid as dynamic actors, barrels and powerups as dormancy actors
+ *   and pickups as static actors, each connection only gathers the cells around its viewer,
+ * - the game state and player states are relevant to all connections,
+ * - every connection has a node for its own controller, pawn and weapons.
+ */
+UCLASS(transient, config=Engine)
+class COOPGAME_API USReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	/**
+	 * Adds simulated client connections that absorb all traffic and times replication for SecondsPerPhase at every
+	 * count in NumConnections, then removes them again. Works on a dedicated server without real clients.
+	 */
+	void RunBenchmark(const TArray<int32>& NumConnections, float SecondsPerPhase);
+
+	/**
+	 * Overrides the replication period and distance priority the actor got from its class, for the graph's own
+	 * settings and every connection. Used by the replication policies, PriorityScale > 1 replicates the actor earlier.
+	 */
+	void SetActorReplicationRate(AActor* Actor, float NetUpdateFrequency, float PriorityScale);
+
+	// Time spent in ServerReplicateActors since the graph was created
+	double GetTotalReplicateSeconds() const { return TotalReplicateSeconds; }
+
+protected:
+	ESClassRepNodeMapping GetMappingPolicy(UClass* Class);
+
+	// Frames between updates at the server tick rate
+	uint32 GetReplicationPeriodFrame(float NetUpdateFrequency) const;
+
+	// Adds or removes simulated connections until there are NumConnections
+	void SetNumSimulatedConnections(int32 NumConnections);
+
+	void StartBenchmarkPhase(int32 Phase);
+
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* GridNode = nullptr;
+
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* AlwaysRelevantNode = nullptr;
+
+	// Mapping per class, filled for blueprint classes from their closest native parent on first use
+	TMap<UClass*, ESClassRepNodeMapping> ClassRepNodePolicies;
+
+	UPROPERTY()
+	TArray<UNetConnection*> SimulatedConnections;
+
+	double TotalReplicateSeconds = 0.0;
+
+	// Benchmark measurements, Phase is INDEX_NONE while not running
+	TArray<int32> BenchmarkConnectionCounts;
+	int32 BenchmarkPhase = INDEX_NONE;
+	float BenchmarkPhaseSeconds = 0.0f;
+	double BenchmarkPhaseStartTime = 0.0;
+	int32 BenchmarkFrames = 0;
+	double BenchmarkSeconds = 0.0;
+	double BenchmarkWorstSeconds = 0.0;
+};
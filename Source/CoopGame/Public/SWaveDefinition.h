@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SWaveDefinition.generated.h"
+
+class ASTrackerBot;
+class UCurveFloat;
+
+// Group of bots deployed at once
+USTRUCT(BlueprintType)
+struct FSWaveBurst
+{
+	GENERATED_BODY()
+
+	// Seconds after the wave started
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	float Time = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	int32 NumBots = 0;
+};
+
+/**
+ * Composition of a wave: bots streamed in at a rate that can follow a curve, plus bursts at fixed times.
+ */
+UCLASS(BlueprintType)
+class COOPGAME_API USWaveDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	USWaveDefinition();
+
+	int32 GetTotalBots() const;
+
+	// Bots per second WaveTime seconds after the wave started
+	float GetSpawnRate(float WaveTime) const;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	TSubclassOf<ASTrackerBot> BotClass;
+
+	// Bots streamed in at SpawnRate, on top of the bursts
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	int32 NumBots;
+
+	// Bots per second
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	float SpawnRate;
+
+	// Multiplier of SpawnRate over seconds since the wave started, constant rate if not set
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	UCurveFloat* SpawnRateCurve;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	TArray<FSWaveBurst> Bursts;
+
+	// Bots are scattered this far around their spawn point
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Wave")
+	float SpawnRadius;
+};
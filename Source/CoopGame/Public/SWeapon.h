@@ -4,25 +4,78 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Subsystems/SAudioPoolSubsystem.h"
 #include "SWeapon.generated.h"
 
 class USkeletalMeshComponent;
 class UAudioComponent;
 class UDamageType;
 class USoundCue;
+class USReplicationPolicyComponent;
 
-// Contains information of a single hitscan weapon linetrace
-USTRUCT()
+// Contains information of a single hitscan weapon linetrace, end point quantized relative to the muzzle
 struct FHitScanTrace
+{
+	// Trace end relative to the muzzle in cm
+	int16 OffsetX = 0;
+	int16 OffsetY = 0;
+	int16 OffsetZ = 0;
+
+	uint8 SurfaceType = 0;
+
+	bool bBlockingHit = false;
+
+	void SetTraceTo(const FVector& MuzzleLocation, const FVector& TraceTo);
+	FVector GetTraceTo(const FVector& MuzzleLocation) const;
+};
+
+// Last shots fired by a hitscan weapon. The shot counter makes every shot replicate, including repeated
+// shots on the same spot. Every update resends the shots of the last NetUpdateWindow net updates, so a
+// connection that skipped up to NetUpdateWindow - 1 updates (saturated or low priority) still replays every
+// shot from its last received counter. Shots older than that, or more than MaxShots behind, are lost for it
+USTRUCT()
+struct FHitScanTraceBurst
 {
 	GENERATED_BODY()
 
 public:
-	UPROPERTY()
-	TEnumAsByte<EPhysicalSurface> SurfaceType;
+	enum { MaxShots = 8 };
+	enum { NetUpdateWindow = 4 };
+
+	void AddShot(const FVector& MuzzleLocation, const FVector& TraceTo, EPhysicalSurface SurfaceType, bool bBlockingHit);
+
+	// Called before the owner replicates, marks the shots fired during the last NetUpdateWindow net updates for sending
+	void BeginNetUpdate();
+
+	// Shot by age, 0 is the newest shot
+	const FHitScanTrace& GetShot(int32 Age) const { return Shots[(uint16)(ShotCounter - 1 - Age) % MaxShots]; }
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FHitScanTraceBurst& Other) const { return ShotCounter == Other.ShotCounter; }
+
+	// Total shots fired, wraps around
+	uint16 ShotCounter = 0;
+
+	// Shots sent with the current net update, newest first
+	uint8 NumShots = 0;
+
+private:
+	FHitScanTrace Shots[MaxShots];
+
+	// Shot counter at each of the last NetUpdateWindow net updates, NextNetUpdate is the oldest
+	uint16 NetUpdateCounters[NetUpdateWindow] = {};
+	uint8 NextNetUpdate = 0;
+};
 
-	UPROPERTY()
-	FVector_NetQuantize TraceTo;
+template<>
+struct TStructOpsTypeTraits<FHitScanTraceBurst> : public TStructOpsTypeTraitsBase2<FHitScanTraceBurst>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
 };
 
 UCLASS()
@@ -51,6 +104,24 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 	virtual FText GetCurrentFireTypeName();
 
+	// Applies damage and effects of a traced shot. Hit is null when the trace didn't block
+	// RewindTime is the client fire time for lag compensated shots, negative otherwise
+	void ProcessHitScan(const FVector& TraceStart, const FVector& TraceEnd, const FVector& ShotDirection, const FHitResult* Hit, float RewindTime);
+
+	// Ignores the shooter and the weapon, returns physical materials for surface effects
+	FCollisionQueryParams GetShotQueryParams() const;
+
+	// Hides a holstered weapon and lets it go dormant on the server, a drawn weapon wakes up right away
+	void SetHolstered(bool bHolstered);
+
+	// False on a client while the weapon is dormant, its server RPCs would be dropped until the server wakes it
+	bool IsNetReady();
+
+	uint8 GetCurrentAmmo() const { return CurrentAmmo; }
+
+	// Used by the owning client to show the inventory ammo of a drawn weapon until the woken weapon replicates
+	void SetCurrentAmmo(uint8 Ammo) { CurrentAmmo = FMath::Min(Ammo, MaxAmmo); }
+
 public:
 	UPROPERTY(Replicated, VisibleDefaultsOnly, Category = "Weapon")
 	bool bIsReloading;
@@ -63,12 +134,17 @@ public:
 protected:
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	//////////////////////////////////////////////////////////////////////////
 	// Weapon Input
 	virtual void Fire();
 
+	// Traces a single shot, batched on the server
+	void FireShot(const FVector& TraceStart, const FVector& ShotDirection, float RewindTime);
+
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerFire();
+	void ServerFire(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal ShotDirection, float ClientFireTime);
 
 	void Reload();
 
@@ -76,7 +152,7 @@ protected:
 	// Replication & effects
 
 	/** Helper for playing sounds */
-	UAudioComponent* PlayWeaponSound(USoundCue* Sound);
+	FSAudioHandle PlayWeaponSound(USoundCue* Sound);
 
 	void PlayReloadSound();
 
@@ -89,6 +165,8 @@ protected:
 	UFUNCTION()
 	void OnRep_HitScanTrace();
 
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
 
 protected:
 	float LastFireTime;
@@ -123,6 +201,9 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 	USkeletalMeshComponent* MeshComp = nullptr;
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+	USReplicationPolicyComponent* ReplicationPolicyComp = nullptr;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
 	TSubclassOf<UDamageType> DamageType;
 
@@ -147,6 +228,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Powerup")
 	UParticleSystem* ExplosionEffect = nullptr;
 
+	// Particle components allocated per effect when the weapon spawns
+	UPROPERTY(EditDefaultsOnly, Category = "Weapon")
+	int32 FXPoolPrewarmCount;
+
 	/** Explosion sound (when explosive power up is active)*/
 	UPROPERTY(EditDefaultsOnly, Category = "Sound")
 	USoundCue* ExplosionSound = nullptr;
@@ -207,9 +292,18 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Weapon")
 	float ReloadTime;
 
+	// Max distance between the client shot origin and the server view of the shooter
+	UPROPERTY(EditDefaultsOnly, Category = "Weapon")
+	float MaxShotOriginError;
+
 	UPROPERTY(ReplicatedUsing=OnRep_HitScanTrace)
-	FHitScanTrace HitScanTrace;
+	FHitScanTraceBurst HitScanTrace;
+
+	// Shot counter of the last shot replayed from HitScanTrace
+	uint16 LastReplayedShotCounter;
+
+	bool bReplayedHitScanTrace;
 
-	UPROPERTY(Transient)
-	UAudioComponent* FireAC;
+	// Looped fire sound, stale once the audio pool took its component back
+	FSAudioHandle FireAC;
 };
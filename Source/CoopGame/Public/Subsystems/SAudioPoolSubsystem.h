@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SAudioPoolSubsystem.generated.h"
+
+class UAudioComponent;
+class USoundBase;
+class USceneComponent;
+
+/**
+ * Sound played on a pooled audio component. Goes stale once the sound finishes and the pool takes the component
+ * back, so holding on to it can never stop a sound somebody else plays on the same component later.
+ */
+struct COOPGAME_API FSAudioHandle
+{
+	// The pooled component while it still plays the sound this handle was returned for
+	UAudioComponent* Get() const;
+
+	bool IsPlaying() const { return Get() != nullptr; }
+
+	// Stop or fade out the sound if it's still playing, the handle is cleared either way
+	void Stop();
+	void FadeOut(float FadeOutDuration);
+
+	void Reset();
+
+private:
+	friend class USAudioPoolSubsystem;
+
+	TWeakObjectPtr<UAudioComponent> Component;
+
+	// Play id the pool handed out with the component, 0 for no sound
+	uint32 PlayId = 0;
+};
+
+/**
+ * Audio dispatch for weapons. Plays sounds on pooled audio components with a voice budget per cue and drops
+ * duplicates of the same cue at the same spot within a frame. Does nothing on worlds that can't hear anything.
+ */
+UCLASS()
+class COOPGAME_API USAudioPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Pooled replacements for UGameplayStatics::SpawnSoundAttached / PlaySoundAtLocation, return an empty handle when the sound is skipped
+	static FSAudioHandle PlaySoundAttached(UWorld* World, USoundBase* Sound, USceneComponent* AttachToComponent);
+	static FSAudioHandle PlaySoundAtLocation(UWorld* World, USoundBase* Sound, const FVector& Location);
+
+	// False where cosmetics are skipped, on -nullrhi and worlds without an audio device
+	static bool CanPlayAudio(UWorld* World);
+
+protected:
+	friend struct FSAudioHandle;
+
+	FSAudioHandle Play(USoundBase* Sound, USceneComponent* AttachToComponent, const FVector& Location);
+
+	bool IsDuplicate(USoundBase* Sound, USceneComponent* AttachToComponent, const FVector& Location);
+
+	void OnAudioFinished(UAudioComponent* AudioComponent);
+
+	UPROPERTY()
+	TArray<UAudioComponent*> FreeComponents;
+
+	UPROPERTY()
+	TArray<UAudioComponent*> ActiveComponents;
+
+	// Play id of the sound every active component is playing, removed when the component goes back to the pool
+	TMap<UAudioComponent*, uint32> PlayIds;
+
+	uint32 LastPlayId;
+
+	// Voices playing per cue
+	TMap<TWeakObjectPtr<USoundBase>, int32> ActiveVoices;
+
+	struct FPlayedSound
+	{
+		TWeakObjectPtr<USoundBase> Sound;
+		TWeakObjectPtr<USceneComponent> AttachParent;
+		FVector Location;
+	};
+
+	// Sounds played during DedupFrame
+	TArray<FPlayedSound> PlayedThisFrame;
+
+	uint64 DedupFrame;
+};
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "SExplosionSubsystem.generated.h"
+
+class URadialForceComponent;
+class UDamageType;
+
+// A single detonation waiting to be resolved, same parameters as ApplyRadialDamage plus FireImpulse
+struct FSExplosion
+{
+	TWeakObjectPtr<AActor> DamageCauser;
+
+	TWeakObjectPtr<AController> InstigatedBy;
+
+	TSubclassOf<UDamageType> DamageTypeClass;
+
+	FVector Origin = FVector::ZeroVector;
+
+	// Damage is only applied with authority, impulses everywhere
+	bool bApplyDamage = false;
+
+	float BaseDamage = 0.0f;
+
+	float DamageRadius = 0.0f;
+
+	bool bDoFullDamage = true;
+
+	// Copied from the radial force component when detonating, no impulse if ImpulseRadius is 0
+	FVector ImpulseOrigin = FVector::ZeroVector;
+
+	float ImpulseRadius = 0.0f;
+
+	float ImpulseStrength = 0.0f;
+
+	TEnumAsByte<ERadialImpulseFalloff> ImpulseFalloff = RIF_Constant;
+
+	bool bImpulseVelChange = false;
+
+	// Owner of the force component if it ignores its owning actor
+	TWeakObjectPtr<AActor> ImpulseIgnoredActor;
+
+	// Scheduling, explosions are resolved by due time, then chain depth, distance to the explosion that set them off and causer id
+	float DueTime = 0.0f;
+
+	int32 ChainDepth = 0;
+
+	float TriggerDistance = 0.0f;
+
+	uint32 CauserId = 0;
+};
+
+/**
+ * Schedules and resolves explosions in batches. Detonations are queued and resolved at the end of the frame in a
+ * deterministic order, in batches sharing one overlap query per cluster of nearby blasts, with the visibility traces of
+ * every blast run in parallel. Damage and impulses are delivered with the same falloff as ApplyRadialDamage and
+ * FireImpulse. Explosions set off while resolving (chain reactions) wait for their fuse and at least the next frame,
+ * and no more explosions are resolved per frame than the count and time budget allow, so a chain is spread over
+ * frames instead of recursing within one.
+ */
+UCLASS()
+class COOPGAME_API USExplosionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	// True if explosions are queued and batched instead of resolved right away
+	static bool IsBatchingEnabled();
+
+	// Explodes DamageCauser at its location. Replaces ApplyRadialDamage (full damage, DamageCauser ignored) and ForceComp->FireImpulse
+	void Detonate(AActor* DamageCauser, float BaseDamage, float DamageRadius, URadialForceComponent* ForceComp);
+
+	// Explodes at Explosion.Origin, ForceComp fires the impulse on the old per explosion path if set
+	void DetonateExplosion(FSExplosion Explosion, URadialForceComponent* ForceComp = nullptr);
+
+	int32 GetNumPending() const { return Pending.Num(); }
+
+	int32 GetNumDetonations() const { return NumDetonations; }
+
+	// Worst time spent resolving explosions in a single frame since the last reset
+	float GetWorstResolveMs() const { return WorstResolveMs; }
+
+	// Lays out a grid of NumBarrels copies of the first barrel in the level, detonates them all in one frame and logs the
+	// worst frame and resolve time until every explosion is resolved. Run with COOP.ExplosionBatching 0 and 1 to compare
+	void RunChainReactionBenchmark(int32 NumBarrels, float Spacing);
+
+protected:
+	void QueueExplosion(const FSExplosion& Explosion);
+
+	// Old path, one overlap query and a visibility trace per component for every explosion
+	void ResolveImmediate(const FSExplosion& Explosion, URadialForceComponent* ForceComp);
+
+	// Resolves the explosions due this frame, best first, within the per frame budget
+	void ResolveDue();
+
+	void ResolveBatch(const TArray<FSExplosion>& Explosions);
+
+	void DeliverImpulse(const FSExplosion& Explosion, UPrimitiveComponent* Component) const;
+
+	void TickBenchmark();
+
+	TArray<FSExplosion> Pending;
+
+	// Explosions being resolved, explosions they set off go to Pending
+	TArray<FSExplosion> Resolving;
+
+	// Explosion delivering its damage right now, the one that set off any detonation in the meantime
+	const FSExplosion* CurrentExplosion = nullptr;
+
+	int32 NumDetonations = 0;
+
+	float WorstResolveMs = 0.0f;
+
+	// Chain reaction benchmark
+	bool bBenchmark = false;
+	int32 BenchmarkNumBarrels = 0;
+	int32 BenchmarkStartDetonations = 0;
+	int32 BenchmarkFrames = 0;
+	int32 BenchmarkIdleFrames = 0;
+	double BenchmarkStartTime = 0.0;
+	double BenchmarkFirstFrameSeconds = 0.0;
+	double BenchmarkLastFrameTime = 0.0;
+	double BenchmarkWorstFrameSeconds = 0.0;
+};
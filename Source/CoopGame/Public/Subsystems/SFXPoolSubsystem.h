@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SFXPoolSubsystem.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+class USceneComponent;
+
+// Components of a single particle template
+USTRUCT()
+struct FFXPool
+{
+	GENERATED_BODY()
+
+	// Playing components, oldest first
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> Active;
+
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> Free;
+};
+
+/**
+ * Per world pool of particle system components. Components are preallocated per template and recycled once
+ * they finish, when a template reaches its cap the oldest playing component is stolen.
+ */
+UCLASS()
+class COOPGAME_API USFXPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Makes sure Template has at least Count components allocated
+	void Prewarm(UParticleSystem* Template, int32 Count);
+
+	// Pooled replacements for UGameplayStatics::SpawnEmitterAtLocation / SpawnEmitterAttached
+	static UParticleSystemComponent* SpawnEmitterAtLocation(UWorld* World, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation = FRotator::ZeroRotator);
+	static UParticleSystemComponent* SpawnEmitterAttached(UWorld* World, UParticleSystem* Template, USceneComponent* AttachToComponent, FName AttachPointName);
+
+	static bool IsPoolingEnabled();
+
+	int32 GetNumLiveComponents() const { return NumLiveComponents; }
+
+protected:
+	UParticleSystemComponent* Acquire(UParticleSystem* Template);
+
+	UParticleSystemComponent* CreateComponent(UParticleSystem* Template);
+
+	UFUNCTION()
+	void OnEmitterFinished(UParticleSystemComponent* PSystem);
+
+	UPROPERTY()
+	TMap<UParticleSystem*, FFXPool> Pools;
+
+	int32 NumLiveComponents;
+};
@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "SFlowFieldSubsystem.generated.h"
+
+/**
+ * Coarse 2D grid sampled from the navmesh. Every cell stores the navmesh height at its center and which of its
+ * 8 neighbours can be reached by a straight navmesh raycast. Built once per world, over several frames.
+ */
+class COOPGAME_API FFlowFieldGrid
+{
+public:
+	// Starts sampling the navmesh of World, returns false if there is no navmesh
+	bool BeginBuild(UWorld* World, float InCellSize, int32 MaxCells);
+
+	// Samples cells until the grid is finished or EndTime (FPlatformTime::Seconds) passes, returns true once finished
+	bool StepBuild(UWorld* World, double EndTime);
+
+	bool IsBuilding() const { return bBuilding; }
+
+	bool IsValid() const { return SizeX > 0 && SizeY > 0 && !bBuilding; }
+
+	// Index of the walkable cell containing Location, INDEX_NONE if outside the grid or blocked
+	int32 FindCell(const FVector& Location) const;
+
+	// Navmesh point at the center of Cell
+	FVector GetCellLocation(int32 Cell) const;
+
+	// Neighbour of Cell in Direction (0-7, counter clockwise from +X), INDEX_NONE if not connected
+	int32 GetNeighbour(int32 Cell, int32 Direction) const;
+
+	int32 GetNumCells() const { return Heights.Num(); }
+
+	float GetCellSize() const { return CellSize; }
+
+	static const FIntPoint DirectionOffsets[8];
+
+private:
+	FVector Origin = FVector::ZeroVector;
+
+	float CellSize = 0.0f;
+
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+
+	// Navmesh height per cell
+	TArray<float> Heights;
+
+	// One bit per connected direction, 0 for blocked cells
+	TArray<uint8> Links;
+
+	bool bBuilding = false;
+
+	// Cells are projected first, then linked, BuildStep counts through both passes
+	int32 BuildStep = 0;
+
+	FVector ProjectExtent = FVector::ZeroVector;
+	float ProjectZ = 0.0f;
+	float MinZ = 0.0f;
+
+	TBitArray<> Walkable;
+};
+
+/**
+ * Dijkstra distance field towards a single goal cell. Every cell stores the direction of its next step towards
+ * the goal, the field can be built over several frames while the previous one is still being sampled.
+ */
+class COOPGAME_API FFlowField
+{
+public:
+	// Starts a new build towards GoalCell, the last finished field stays valid until the build completes
+	void BeginBuild(const FFlowFieldGrid& Grid, int32 GoalCell);
+
+	// Expands the build until it finishes or EndTime (FPlatformTime::Seconds) passes, returns true once finished
+	bool StepBuild(const FFlowFieldGrid& Grid, double EndTime);
+
+	bool IsBuilding() const { return bBuilding; }
+
+	bool IsValid() const { return GoalCell != INDEX_NONE; }
+
+	int32 GetGoalCell() const { return GoalCell; }
+
+	int32 GetBuildGoalCell() const { return BuildGoalCell; }
+
+	// Follows the field up to LookAhead cells from Cell, returns false if Cell can't reach the goal
+	bool Sample(const FFlowFieldGrid& Grid, int32 Cell, int32 LookAhead, int32& OutCell) const;
+
+private:
+	struct FOpenCell
+	{
+		float Distance;
+		int32 Cell;
+
+		bool operator<(const FOpenCell& Other) const { return Distance < Other.Distance; }
+	};
+
+	int32 GoalCell = INDEX_NONE;
+
+	// Direction of the next step per cell, 0xFF if the goal can't be reached
+	TArray<uint8> Directions;
+
+	bool bBuilding = false;
+
+	int32 BuildGoalCell = INDEX_NONE;
+
+	TArray<float> BuildDistances;
+	TArray<uint8> BuildDirections;
+	TArray<FOpenCell> OpenCells;
+};
+
+/**
+ * Flow field navigation for tracker bot swarms. Keeps one flow field per chased target, rebuilt over several
+ * frames whenever the target enters a new cell, so any number of bots chasing the same player share one search
+ * and look up their next move in constant time.
+ */
+UCLASS()
+class COOPGAME_API USFlowFieldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	// Next point to steer to from Location when chasing Target. Returns false while the grid or the field is
+	// being built or if Target can't be reached from Location over the grid
+	bool SampleNextPoint(AActor* Target, const FVector& Location, FVector& OutPoint);
+
+	// Compares one synchronous path query per bot against a single flow field build plus one sample per bot
+	void RunBenchmark(const TArray<int32>& BotCounts);
+
+protected:
+	struct FTargetField
+	{
+		FFlowField Field;
+
+		// Last time a bot sampled this field, unused fields are dropped
+		float LastSampleTime = 0.0f;
+	};
+
+	// Goal cell for Target, the nearest walkable cell around it if it stands on a blocked one
+	int32 FindTargetCell(AActor* Target) const;
+
+	// Grid build is started on the first tick after the world begins play, within the build budget
+	void StepGridBuild(double EndTime);
+
+	FFlowFieldGrid Grid;
+
+	bool bGridBuildStarted;
+
+	// Game thread time and frames the grid build took
+	double GridBuildSeconds;
+	int32 GridBuildFrames;
+
+	TMap<TWeakObjectPtr<AActor>, FTargetField> Fields;
+};
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SHealthRegistrySubsystem.generated.h"
+
+class USHealthComponent;
+
+// Fired when a component starts or stops counting as alive, including registering alive and unregistering while alive
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnHealthRegistryAliveChanged, USHealthComponent*, bool);
+
+/**
+ * Registry of every health component in the world. Components register in BeginPlay and keep a handle into
+ * dense arrays of owner, team and alive state, so team and health lookups don't have to search an actor's
+ * components. Alive counts are kept per team.
+ */
+UCLASS()
+class COOPGAME_API USHealthRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Returns the handle of the component
+	int32 Register(USHealthComponent* HealthComp);
+	void Unregister(USHealthComponent* HealthComp);
+
+	// Call whenever the health of a registered component changed
+	void UpdateAlive(USHealthComponent* HealthComp);
+
+	// Handle of the health component of Actor, INDEX_NONE if it has none
+	int32 FindHandle(const AActor* Actor) const;
+
+	USHealthComponent* FindHealthComponent(const AActor* Actor) const;
+
+	bool IsFriendly(int32 HandleA, int32 HandleB) const { return Teams[HandleA] == Teams[HandleB]; }
+
+	int32 GetNum() const { return Owners.Num(); }
+
+	AActor* GetOwner(int32 Handle) const { return Owners[Handle]; }
+
+	USHealthComponent* GetHealthComponent(int32 Handle) const { return Components[Handle]; }
+
+	uint8 GetTeam(int32 Handle) const { return Teams[Handle]; }
+
+	bool IsAlive(int32 Handle) const { return Alive[Handle] != 0; }
+
+	int32 GetNumAlive(uint8 TeamNum) const { return AliveCounts[TeamNum]; }
+
+	FOnHealthRegistryAliveChanged OnAliveChanged;
+
+	// Times IsFriendly through component lookups, owner lookups and handles over NumChecks random pairs
+	void RunIsFriendlyBenchmark(int32 NumChecks) const;
+
+protected:
+	UPROPERTY()
+	TArray<USHealthComponent*> Components;
+
+	UPROPERTY()
+	TArray<AActor*> Owners;
+
+	TArray<uint8> Teams;
+
+	TArray<uint8> Alive;
+
+	TMap<const AActor*, int32> OwnerHandles;
+
+	int32 AliveCounts[256];
+};
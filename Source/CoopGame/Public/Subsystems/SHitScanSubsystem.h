@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "SHitScanSubsystem.generated.h"
+
+class ASWeapon;
+
+DECLARE_STATS_GROUP(TEXT("CoopHitScan"), STATGROUP_CoopHitScan, STATCAT_Advanced);
+
+// A single hitscan shot waiting for its trace result
+struct FHitScanRequest
+{
+	TWeakObjectPtr<ASWeapon> Weapon;
+
+	FVector TraceStart = FVector::ZeroVector;
+
+	FVector TraceEnd = FVector::ZeroVector;
+
+	FVector ShotDirection = FVector::ForwardVector;
+
+	// Client fire time for lag compensated shots, negative if the shot isn't rewound
+	float RewindTime = -1.0f;
+
+	// Ignore list (owner and weapon) and trace flags
+	FCollisionQueryParams QueryParams;
+
+	// Benchmark shots are only counted, never routed back to a weapon
+	bool bBenchmark = false;
+};
+
+/**
+ * Server side hitscan batcher. Weapons queue their shots here instead of tracing synchronously,
+ * all shots of a frame are resolved together by the async trace pass at the start of the next frame
+ * and the results are sent back to the weapon damage path.
+ */
+UCLASS()
+class COOPGAME_API USHitScanSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// True if weapons should queue their shots instead of tracing synchronously
+	static bool IsBatchingEnabled();
+
+	void QueueShot(const FHitScanRequest& Request);
+
+	int32 GetNumShotsInFlight() const { return ShotsInFlight.Num(); }
+
+	// Compares synchronous per-shot traces against the batched path, timed from dispatch until every result is
+	// delivered, and logs traces per millisecond along with the game thread cost of each
+	void RunBenchmark(const FVector& Origin, const FVector& Direction, int32 NumShots, float SpreadDegrees);
+
+protected:
+	void OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Datum);
+
+	FTraceDelegate TraceDelegate;
+
+	// Shots waiting for their async trace, keyed by the trace user data
+	TMap<uint32, FHitScanRequest> ShotsInFlight;
+
+	uint32 NextShotId;
+
+	// Benchmark bookkeeping
+	int32 BenchmarkShotsPending;
+	int32 BenchmarkShotsTotal;
+	double BenchmarkDispatchSeconds;
+	double BenchmarkStartTime;
+	uint64 BenchmarkStartFrame;
+
+	// Game thread time spent handing results back, measured between consecutive callbacks of one frame
+	double BenchmarkDeliverySeconds;
+	double BenchmarkLastResultTime;
+	uint64 BenchmarkLastResultFrame;
+};
@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "SLagCompensationSubsystem.generated.h"
+
+struct FCollisionQueryParams;
+
+/**
+ * Fixed size hitbox history. Every tracked entry owns a ring of HistoryLength transforms, all rings share the same
+ * frame timestamps so a rewind only has to look up the frame once per shot. Everything is allocated in Init.
+ */
+class COOPGAME_API FHitboxHistory
+{
+public:
+	void Init(int32 InMaxEntries, int32 InHistoryLength);
+
+	// Returns the slot of the new entry or INDEX_NONE if the history is full
+	int32 AddEntry(const FVector& BoxExtent);
+
+	void RemoveEntry(int32 Slot);
+
+	// Starts a new history frame, call once per tick before recording the entries
+	void BeginFrame(float Time);
+
+	void Record(int32 Slot, const FVector& Location, const FQuat& Rotation);
+
+	// Nearest entry hit by the segment with the hitboxes rewound to Time. Returns INDEX_NONE on miss
+	int32 Raycast(const FVector& Start, const FVector& End, float Time, int32 IgnoredSlot, float& OutDistance) const;
+
+	int32 GetNumEntries() const { return ActiveSlots.Num(); }
+
+	int32 GetMaxEntries() const { return MaxEntries; }
+
+private:
+	struct FHitboxFrame
+	{
+		FVector Location;
+		FQuat Rotation;
+	};
+
+	struct FHitboxEntry
+	{
+		FVector BoxExtent;
+
+		// First history frame recorded for this entry, older frames belong to a previous owner of the slot
+		uint32 FirstFrame;
+
+		int32 ActiveIndex;
+	};
+
+	// Finds the two recorded frames around Time, returns false if nothing is recorded yet
+	bool FindFrames(float Time, uint32& OutOlder, uint32& OutNewer, float& OutAlpha) const;
+
+	bool RaycastBox(const FVector& Start, const FVector& Dir, float Length, const FVector& Center, const FQuat& Rotation, const FVector& Extent, float& OutDistance) const;
+
+	int32 MaxEntries = 0;
+	int32 HistoryLength = 0;
+
+	// Number of frames recorded so far, the ring index of a frame is FrameNumber % HistoryLength
+	uint32 NumFrames = 0;
+
+	TArray<float> FrameTimes;
+	TArray<FHitboxFrame> Frames;
+	TArray<FHitboxEntry> Entries;
+	TArray<int32> ActiveSlots;
+	TArray<int32> FreeSlots;
+};
+
+/**
+ * Server side lag compensation. Keeps a hitbox history of every tracked pawn so shots fired by remote clients
+ * are resolved against the world as the client saw it at its fire timestamp.
+ */
+UCLASS()
+class COOPGAME_API USLagCompensationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	void RegisterActor(AActor* Actor);
+	void UnregisterActor(AActor* Actor);
+
+	/**
+	 * Re-evaluates a server trace against the hitboxes at RewindTime (server world time).
+	 * Hits on tracked actors at their current location are dropped and the world is traced again past them with
+	 * QueryParams. InOutHit is replaced when a rewound hitbox is closer than the first untracked world hit, or by
+	 * that world hit when the rewound hitboxes miss. Returns true if the shot blocks.
+	 */
+	bool RewindHitScan(const FVector& TraceStart, const FVector& TraceEnd, float RewindTime, const AActor* Shooter, const FCollisionQueryParams& QueryParams,
+		FHitResult& InOutHit, bool bBlockingHit) const;
+
+protected:
+	// First blocking hit on the weapon channel that is not a tracked actor
+	bool TraceUntracked(const FVector& TraceStart, const FVector& TraceEnd, const FCollisionQueryParams& QueryParams, FHitResult& OutHit) const;
+
+	FHitboxHistory History;
+
+	TArray<TWeakObjectPtr<AActor>> SlotActors;
+
+	TMap<TWeakObjectPtr<AActor>, int32> ActorSlots;
+};
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AI/Navigation/NavigationTypes.h"
+#include "SPathQuerySubsystem.generated.h"
+
+// Called on the game thread once a path query finished, PathPoints is empty if no path was found
+DECLARE_DELEGATE_TwoParams(FSPathQueryDelegate, bool /*bSuccess*/, const TArray<FVector>& /*PathPoints*/);
+
+/**
+ * Shared asynchronous path queries. Requests from the same start cell to the same goal actor are merged into
+ * a single FindPathAsync query and its result is reused for a short time, so a wave of bots spawning together
+ * costs a handful of queries instead of one synchronous query per bot.
+ */
+UCLASS()
+class COOPGAME_API USPathQuerySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Requests a path from Start to Goal, Callback may run right away when a cached path is reused. Callbacks run
+	// even if the requester was reused meanwhile, pooled requesters bind their activation as payload and drop stale results
+	void RequestPath(const FVector& Start, AActor* Goal, const FSPathQueryDelegate& Callback);
+
+	// Queries issued / requests served since the last COOP.PathQueryReport, and the latency of each query
+	void ConsumeReport(int32& OutQueries, int32& OutRequests, TArray<float>& OutLatenciesMs);
+
+protected:
+	struct FQueryKey
+	{
+		TWeakObjectPtr<AActor> Goal;
+		FIntVector StartCell;
+
+		bool operator==(const FQueryKey& Other) const { return Goal == Other.Goal && StartCell == Other.StartCell; }
+		friend uint32 GetTypeHash(const FQueryKey& Key) { return HashCombine(GetTypeHash(Key.Goal), GetTypeHash(Key.StartCell)); }
+	};
+
+	struct FPendingQuery
+	{
+		FQueryKey Key;
+		double StartTime;
+		TArray<FSPathQueryDelegate> Callbacks;
+	};
+
+	struct FCachedPath
+	{
+		double Time;
+		bool bSuccess;
+		TArray<FVector> PathPoints;
+	};
+
+	void OnPathFound(uint32 QueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path);
+
+	// In flight queries keyed by the navigation system query id
+	TMap<uint32, FPendingQuery> PendingQueries;
+
+	TMap<FQueryKey, uint32> PendingQueryIds;
+
+	// Recently finished queries
+	TMap<FQueryKey, FCachedPath> CachedPaths;
+
+	double LastCachePruneTime;
+
+	int32 NumQueries;
+	int32 NumRequests;
+	TArray<float> LatenciesMs;
+};
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "SProjectileSubsystem.generated.h"
+
+class USGrenadeDefinition;
+class UStaticMesh;
+class UInstancedStaticMeshComponent;
+
+// A grenade in flight, plain data stepped by USProjectileSubsystem
+struct FSProjectile
+{
+	const USGrenadeDefinition* Definition = nullptr;
+
+	FVector Location = FVector::ZeroVector;
+
+	FVector Velocity = FVector::ZeroVector;
+
+	// Seconds until it explodes
+	float FuseLeft = 0.0f;
+
+	// Shot of Launcher it was fired with, matches predicted and authoritative grenades. 0 for submunitions
+	uint16 ShotId = 0;
+
+	uint8 NumBounces = 0;
+
+	// Lying still, no more sweeps until it explodes
+	bool bAtRest = false;
+
+	// Sticky grenades follow the component they stuck to, StuckOffset is in its space
+	bool bStuck = false;
+	TWeakObjectPtr<UPrimitiveComponent> StuckTo;
+	FVector StuckOffset = FVector::ZeroVector;
+
+	// Seeds the submunition scatter so every machine releases them the same way
+	uint16 Seed = 0;
+
+	// Damage causer, ignored by the sweeps together with its owner
+	TWeakObjectPtr<AActor> Launcher;
+	TWeakObjectPtr<AActor> LauncherOwner;
+	TWeakObjectPtr<AController> InstigatedBy;
+
+	// Only the server's grenades deal damage, the others are visuals
+	bool bApplyDamage = false;
+
+	// Benchmark grenades never explode, clusters still split
+	bool bBenchmark = false;
+};
+
+/**
+ * Grenades as plain data instead of actors. All grenades are stepped together every frame: gravity, one sphere
+ * sweep each run in parallel, then bounces, sticking and fuses are resolved on the game thread. Explosions go
+ * through USExplosionSubsystem and cluster submunitions are just more entries. Grenades are drawn as instances of
+ * one instanced static mesh per mesh, never on dedicated servers.
+ */
+UCLASS()
+class COOPGAME_API USProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	// True if grenade launchers fire simulated grenades instead of projectile actors
+	static bool IsSimulationEnabled();
+
+	/**
+	 * Adds a grenade fired by Launcher. It deals damage only if Launcher has authority. Grenades launched in the
+	 * past, like ones replicated from the server, are stepped FastForwardSeconds ahead right away.
+	 */
+	void Launch(const USGrenadeDefinition* Definition, AActor* Launcher, const FVector& Location, const FVector& Velocity,
+		uint16 ShotId, float FastForwardSeconds = 0.0f);
+
+	// Replaces the predicted grenade of ShotId with the authoritative launch. False if it already exploded
+	bool CorrectLaunch(AActor* Launcher, uint16 ShotId, const USGrenadeDefinition* Definition, const FVector& Location,
+		const FVector& Velocity, float FastForwardSeconds);
+
+	int32 GetNumProjectiles() const { return Projectiles.Num(); }
+
+	// Launches NumGrenades grenades of Definition at once from Origin and logs step times until they are all gone
+	void RunBenchmark(const USGrenadeDefinition* Definition, const FVector& Origin, int32 NumGrenades);
+
+protected:
+	void Launch(const FSProjectile& Projectile);
+
+	void StepProjectiles(float DeltaTime);
+
+	// Burns the fuse and applies gravity. False if the grenade does not move on its own this step
+	static bool Integrate(FSProjectile& Projectile, float GravityZ, float DeltaTime, FVector& OutEnd);
+
+	// Moves the grenade to End or bounces, sticks or detonates it on Hit
+	static void ResolveSweep(FSProjectile& Projectile, const FVector& End, bool bBlocked, const FHitResult& Hit);
+
+	// Steps a single grenade Seconds ahead in fixed steps
+	void FastForward(FSProjectile& Projectile, float Seconds);
+
+	// Deals the damage and releases the submunitions of a grenade whose fuse ran out
+	void Explode(const FSProjectile& Projectile);
+
+	void UpdateVisuals();
+
+	TArray<FSProjectile> Projectiles;
+
+	// Definitions of grenades in flight, kept loaded
+	UPROPERTY()
+	TArray<const USGrenadeDefinition*> Definitions;
+
+	// Sweep scratch, indexed like Projectiles
+	TArray<int32> SweepIndices;
+	TArray<FVector> SweepEnds;
+	TArray<FHitResult> SweepHits;
+	TArray<uint8> SweepBlocked;
+	TArray<const AActor*> SweepIgnored;
+
+	// Holds one instanced mesh component per grenade mesh
+	UPROPERTY()
+	AActor* VisualActor = nullptr;
+
+	UPROPERTY()
+	TMap<UStaticMesh*, UInstancedStaticMeshComponent*> Visuals;
+
+	TMap<UStaticMesh*, TArray<FTransform>> VisualTransforms;
+
+	int32 NumVisibleInstances = 0;
+
+	// Benchmark measurements
+	bool bBenchmark = false;
+	int32 NumBenchmarkGrenades = 0;
+	int32 BenchmarkTotalGrenades = 0;
+	int32 BenchmarkPeakGrenades = 0;
+	int32 BenchmarkFrames = 0;
+	double BenchmarkStartTime = 0.0;
+	double BenchmarkStepSeconds = 0.0;
+	double BenchmarkWorstStepSeconds = 0.0;
+};
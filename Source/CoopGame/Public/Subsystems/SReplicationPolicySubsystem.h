@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "SReplicationPolicySubsystem.generated.h"
+
+class USReplicationPolicyComponent;
+
+/**
+ * Server side registry of replication policy components. A few times per second the distance from every
+ * policy owner to the closest player is measured in one pass and each policy updates the net update
+ * frequency, priority and dormancy of its owner.
+ */
+UCLASS()
+class COOPGAME_API USReplicationPolicySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	void Register(USReplicationPolicyComponent* Policy);
+	void Unregister(USReplicationPolicyComponent* Policy);
+
+	int32 GetNumPolicies() const { return Policies.Num(); }
+
+	/**
+	 * Measures bytes sent and frame times for Seconds with the policies off, then for Seconds with them on,
+	 * and logs both. Meant for a server with clients connected and a wave of bots out.
+	 */
+	void RunBenchmark(float Seconds);
+
+protected:
+	void UpdatePolicies();
+
+	// Closest player to each policy owner, FLT_MAX without players
+	void UpdatePlayerDistances();
+
+	void LogBenchmarkPhase(const TCHAR* Name) const;
+
+	UPROPERTY()
+	TArray<USReplicationPolicyComponent*> Policies;
+
+	TArray<FVector> PlayerLocations;
+	TArray<float> PlayerDistances;
+
+	float TimeToUpdate = 0.0f;
+
+	// Owners currently use the policy settings
+	bool bPoliciesApplied = false;
+
+	// Benchmark measurements, phase 1 runs with the policies off and phase 2 with them on
+	int32 BenchmarkPhase = 0;
+	float BenchmarkPhaseSeconds = 0.0f;
+	double BenchmarkPhaseStartTime = 0.0;
+	double BenchmarkLastFrameTime = 0.0;
+	int32 BenchmarkFrames = 0;
+	double BenchmarkFrameSeconds = 0.0;
+	double BenchmarkWorstFrameSeconds = 0.0;
+	double BenchmarkUpdateSeconds = 0.0;
+	uint64 BenchmarkStartBytes = 0;
+
+	// Negative without the replication graph
+	double BenchmarkStartReplicateSeconds = -1.0;
+};
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Subsystems/STrackerBotSubsystem.h"
+#include "SSpawnPointSubsystem.generated.h"
+
+// Tuning of spawn point scoring, filled from the COOP.SpawnPoint* console variables
+struct FSpawnPointScoreParams
+{
+	// Candidates closer than this to a player are rejected
+	float MinPlayerDistance = 1500.0f;
+
+	// Candidates at this distance from the nearest player score best
+	float PreferredPlayerDistance = 3000.0f;
+
+	// Candidates further than this from every player are rejected
+	float MaxPlayerDistance = 8000.0f;
+
+	// Bots within this radius of a candidate make it crowded
+	float CrowdRadius = 400.0f;
+
+	// Score lost per bot within CrowdRadius
+	float CrowdPenalty = 0.1f;
+};
+
+/**
+ * Native bot spawn point selection. Candidate points are generated once around every actor tagged BotSpawnPoint
+ * and projected onto the navmesh. Selection scores all candidates in parallel by distance to the nearest player and
+ * by how many bots crowd them, then walks the best ones rejecting points a player can see or that are too close to
+ * a point already picked. When players stand where every candidate is rejected, bots spawn at the candidate closest
+ * to the allowed distances instead of waiting.
+ */
+UCLASS()
+class COOPGAME_API USSpawnPointSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	int32 GetNumCandidates();
+
+	// Best NumPoints spawn transforms right now, fewer if there aren't enough valid candidates. Returns the number found
+	int32 SelectSpawnPoints(int32 NumPoints, TArray<FTransform>& OutTransforms);
+
+	// Score of every candidate, -FLT_MAX for rejected ones. Candidates are split into NumChunks ranges processed in parallel
+	static void ScoreCandidates(const TArray<FVector>& InCandidates, const TArray<FVector>& PlayerLocations, const FSpatialHashGrid& Crowd,
+		const FSpawnPointScoreParams& Params, TArray<float>& OutScores, int32 NumChunks);
+
+	// Candidate indices that scored, best first
+	static void SortCandidates(const TArray<float>& InScores, TArray<int32>& OutOrder);
+
+	// Candidate closest to the allowed player distances, for when every candidate was rejected. INDEX_NONE without candidates
+	static int32 FindFallbackCandidate(const TArray<FVector>& InCandidates, const TArray<FVector>& PlayerLocations, const FSpawnPointScoreParams& Params);
+
+	// Walks InOrder and picks up to NumPoints candidates at least MinSpacing apart that IsRejected lets through.
+	// Falls back to the first candidate of InOrder if IsRejected rejects all of them
+	static void PickSpacedCandidates(const TArray<int32>& InOrder, const TArray<FVector>& InCandidates, int32 NumPoints, float MinSpacing,
+		TFunctionRef<bool(const FVector&)> IsRejected, TArray<int32>& OutPicked);
+
+	// Logs selection latency for NumCandidates random candidates and NumBots random bots, scoring on one and on all threads
+	static void RunSelectionBenchmark(int32 NumCandidates, int32 NumBots);
+
+protected:
+	// Generates the candidates around the actors tagged BotSpawnPoint
+	void BuildCandidates();
+
+	static FSpawnPointScoreParams GetScoreParams();
+
+	bool IsVisibleToPlayers(const FVector& Location, const TArray<FVector>& PlayerViewLocations, const FCollisionQueryParams& QueryParams) const;
+
+	bool bCandidatesBuilt = false;
+
+	TArray<FVector> Candidates;
+	TArray<FRotator> CandidateRotations;
+
+	// Scratch of the last selection
+	TArray<FVector> BotLocations;
+	FSpatialHashGrid Crowd;
+	TArray<float> Scores;
+	TArray<int32> Order;
+	TArray<int32> Picked;
+};
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "STrackerBotPoolSubsystem.generated.h"
+
+class ASTrackerBot;
+
+// Inactive bots of a single class
+USTRUCT()
+struct FTrackerBotPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<ASTrackerBot*> Free;
+};
+
+/**
+ * Server side pool of tracker bots. Bots are spawned ahead of time while waiting for a wave, parked hidden
+ * without collision or physics and reactivated in place of a SpawnActor. Exploded bots return to the pool instead
+ * of being destroyed.
+ */
+UCLASS()
+class COOPGAME_API USTrackerBotPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Pooled replacement for SpawnActor, falls back to spawning a new bot if the pool is empty or disabled
+	UFUNCTION(BlueprintCallable, Category = "TrackerBot")
+	ASTrackerBot* SpawnBotAt(TSubclassOf<ASTrackerBot> BotClass, const FTransform& Transform);
+
+	// Makes sure BotClass has at least Count inactive bots
+	void Prewarm(TSubclassOf<ASTrackerBot> BotClass, int32 Count);
+
+	// Deactivates Bot and keeps it for the next spawn, destroys it if pooling is disabled
+	void ReleaseBot(ASTrackerBot* Bot);
+
+	static bool IsPoolingEnabled();
+
+	int32 GetNumFree() const;
+
+	int32 GetNumFree(TSubclassOf<ASTrackerBot> BotClass) const;
+
+protected:
+	ASTrackerBot* SpawnNewBot(TSubclassOf<ASTrackerBot> BotClass, const FTransform& Transform, bool bInPool);
+
+	UPROPERTY()
+	TMap<UClass*, FTrackerBotPool> Pools;
+};
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "AI/SBotSteering.h"
+#include "STrackerBotSubsystem.generated.h"
+
+class ASTrackerBot;
+
+/**
+ * Uniform grid over a set of points, rebuilt from scratch with a counting sort. Cells are hashed into a table of
+ * about twice the point count, so building and querying never allocate once the arrays have grown.
+ */
+class COOPGAME_API FSpatialHashGrid
+{
+public:
+	void Build(const TArray<FVector>& InPoints, float InCellSize);
+
+	// Number of points within Radius of Points[Index], not counting Index itself. Radius must not exceed the cell size
+	int32 CountNeighbours(int32 Index, float Radius) const;
+
+	// Number of points within Radius of Center, not counting IgnoreIndex. Radius must not exceed the cell size
+	int32 CountPointsNear(const FVector& Center, float Radius, int32 IgnoreIndex = INDEX_NONE) const;
+
+private:
+	uint32 HashCell(const FIntVector& Cell) const;
+
+	FIntVector GetCell(const FVector& Point) const;
+
+	const TArray<FVector>* Points = nullptr;
+
+	float CellSize = 1.0f;
+
+	uint32 TableMask = 0;
+
+	// Points sorted by bucket, bucket B holds SortedPoints[BucketStarts[B] .. BucketStarts[B + 1])
+	TArray<int32> BucketStarts;
+	TArray<int32> SortedPoints;
+	TArray<uint32> PointBuckets;
+};
+
+// Flat copy of a living pawn bots can chase, taken once per frame
+struct FBotTarget
+{
+	AActor* Actor = nullptr;
+
+	FVector Location = FVector::ZeroVector;
+
+	uint8 TeamNum = 0;
+};
+
+/**
+ * Server side registry and update manager of live tracker bots. Bots don't tick themselves, every frame the
+ * subsystem walks its contiguous bot arrays and:
+ * - snapshots all living targets and picks the nearest enemy of every bot on the worker threads,
+ * - rebuilds a spatial hash of all bots and updates every bot's power level in one pass,
+ * - refreshes paths and path points for the bots that are due, round robin within a time budget, with bots far
+ *   from every player updated less often,
+ * - computes the steering force of every bot in one vectorized batch and applies them to the physics bodies.
+ */
+UCLASS()
+class COOPGAME_API USTrackerBotSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	void RegisterBot(ASTrackerBot* Bot);
+	void UnregisterBot(ASTrackerBot* Bot);
+
+	int32 GetNumBots() const { return Bots.Num(); }
+
+	// Bot locations as of the last target update, same order as the registered bots
+	const TArray<FVector>& GetBotLocations() const { return BotLocations; }
+
+	// Nearest living enemy of Bot as of this frame, returns false if Bot wasn't part of this frame's selection
+	bool GetBestTarget(const ASTrackerBot* Bot, AActor*& OutTarget) const;
+
+	// Index in Targets of the nearest target of another team for every bot, INDEX_NONE if there is none.
+	// Bots are split into NumChunks ranges processed in parallel
+	static void SelectNearestTargets(const TArray<FVector>& Locations, const TArray<uint8>& Teams, const TArray<FBotTarget>& InTargets, TArray<int32>& OutBestTargets, int32 NumChunks);
+
+	// Counts neighbours of NumBots random bots with the spatial hash and brute force and logs both
+	static void RunPowerLevelBenchmark(int32 NumBots);
+
+	// Logs target selection time for NumBots random bots and NumTargets targets on the game thread and over every
+	// task graph thread. Thread scaling needs one launch per -numworkerthreads value
+	static void RunTargetSelectionBenchmark(int32 NumBots, int32 NumTargets);
+
+protected:
+	void UpdatePowerLevels();
+
+	// Snapshots the living pawns and selects every bot's target
+	void UpdateTargets();
+
+	// Runs the steering and path refreshes that are due, returns the number of bots updated
+	int32 UpdateBots(float Now);
+
+	// Seconds between steering updates for a bot at Location, from its distance to the nearest player
+	float GetUpdateInterval(const FVector& Location) const;
+
+	UPROPERTY()
+	TArray<ASTrackerBot*> Bots;
+
+	// Per bot state, same order as Bots
+	TArray<FVector> BotLocations;
+	TArray<float> NextUpdateTimes;
+	TArray<float> NextRefreshTimes;
+	TArray<uint8> BotTeams;
+
+	// Targets of this frame and the index of every bot's nearest one
+	TArray<FBotTarget> Targets;
+	TArray<int32> BestTargets;
+
+	// Player pawn locations of this frame
+	TArray<FVector> PlayerLocations;
+
+	// First bot looked at by the next budgeted update
+	int32 UpdateCursor;
+
+	FSpatialHashGrid SpatialHash;
+
+	FBotSteeringBatch SteeringBatch;
+
+	float NextPowerLevelTime;
+};
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "SWaveDefinition.h"
+#include "SWaveDirectorSubsystem.generated.h"
+
+class ASTrackerBot;
+
+/**
+ * Server side deployment of waves from a USWaveDefinition. Bots that are due, streamed or from a burst, are
+ * queued and spawned through the bot pool over as many frames as it takes to stay within a per frame count and
+ * time budget. Spawn points come from USSpawnPointSubsystem, picked once per frame for all bots spawned in it.
+ * Prewarming the bot pool between waves is spread over frames the same way.
+ */
+UCLASS()
+class COOPGAME_API USWaveDirectorSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// Begin FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	// End FTickableGameObject interface
+
+	// Starts deploying Wave, returns false if there is no bot class or no spawn point. Finishes on a later frame
+	bool StartDeploy(const USWaveDefinition* Wave);
+
+	// Drops all bots that weren't spawned yet
+	void StopDeploy();
+
+	bool IsDeploying() const { return Wave != nullptr; }
+
+	// Fills the bot pool up to Count bots of BotClass over the next frames
+	void Prewarm(TSubclassOf<ASTrackerBot> BotClass, int32 Count);
+
+	// Deploys NumBots bots at BotsPerSecond and logs frame times once they are all out
+	void RunDeployBenchmark(int32 NumBots, float BotsPerSecond);
+
+	// Broadcast once every bot of a deploy started with StartDeploy was spawned
+	FSimpleMulticastDelegate OnDeployFinished;
+
+protected:
+	void SpawnBot(const FTransform& SpawnPoint);
+
+	void FinishDeploy();
+
+	UPROPERTY()
+	const USWaveDefinition* Wave = nullptr;
+
+	// Bursts of Wave sorted by time and the next one due
+	TArray<FSWaveBurst> Bursts;
+	int32 NextBurst = 0;
+
+	float WaveStartTime = 0.0f;
+
+	// Streamed bots not due yet and the fraction of a bot due so far
+	int32 NumStreamedLeft = 0;
+	float StreamCredit = 0.0f;
+
+	// Bots due but not spawned yet
+	int32 NumQueued = 0;
+
+	// Spawn points of this frame
+	TArray<FTransform> SpawnTransforms;
+
+	FRandomStream Stream;
+
+	UPROPERTY()
+	TSubclassOf<ASTrackerBot> PrewarmClass;
+
+	int32 PrewarmCount = 0;
+
+	// Bot class of the last deploy or prewarm, used by the benchmark
+	UPROPERTY()
+	TSubclassOf<ASTrackerBot> LastBotClass;
+
+	// Frame measurements of the running deploy
+	bool bBenchmark = false;
+	int32 NumBenchmarkBots = 0;
+	int32 DeployFrames = 0;
+	double DeployStartTime = 0.0;
+	double LastFrameTime = 0.0;
+	double WorstFrameSeconds = 0.0;
+	double WorstSpawnSeconds = 0.0;
+	double TotalSpawnSeconds = 0.0;
+};
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/SBotSteering.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Usage: BotSteeringBenchmark [NumBots...] (default 100 1000 10000)
+int main(int argc, char** argv)
+{
+	std::vector<int> BotCounts;
+	for (int i = 1; i < argc; ++i)
+	{
+		BotCounts.push_back(std::atoi(argv[i]) > 0 ? std::atoi(argv[i]) : 1);
+	}
+	if (BotCounts.empty())
+		BotCounts = { 100, 1000, 10000 };
+
+	if (!FBotSteeringBatch::IsVectorized())
+		std::printf("SSE2 isn't available, both columns run the scalar kernel\n");
+
+	for (int NumBots : BotCounts)
+	{
+		// About ten million bot updates per kernel
+		int Iterations = 10000000 / NumBots > 1 ? 10000000 / NumBots : 1;
+
+		double ScalarBotsPerUs = 0.0;
+		double VectorBotsPerUs = 0.0;
+		FBotSteeringBatch::RunBenchmark(NumBots, Iterations, ScalarBotsPerUs, VectorBotsPerUs);
+
+		std::printf("%6d bots x %7d: scalar %8.1f bots/us, SSE2 %8.1f bots/us (%.2fx)\n", NumBots, Iterations,
+			ScalarBotsPerUs, VectorBotsPerUs, ScalarBotsPerUs > 0.0 ? VectorBotsPerUs / ScalarBotsPerUs : 0.0);
+	}
+
+	return 0;
+}
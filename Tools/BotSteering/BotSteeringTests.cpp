@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/SBotSteering.h"
+#include "SBotSteeringChecks.h"
+#include <cstdio>
+
+int main()
+{
+	std::vector<std::string> Failures;
+	FBotSteeringChecks::Run(Failures);
+
+	for (const std::string& Failure : Failures)
+	{
+		std::printf("FAILED: %s\n", Failure.c_str());
+	}
+
+	std::printf("Bot steering checks (%s): %s, %d failures\n", FBotSteeringBatch::IsVectorized() ? "SSE2" : "scalar",
+		Failures.empty() ? "passed" : "failed", (int)Failures.size());
+
+	return Failures.empty() ? 0 : 1;
+}